@@ -1,3 +1,5 @@
-"C:/Program Files/Vulkan/Bin/glslc.exe" shader.vert -o vert.spv
-"C:/Program Files/Vulkan/Bin/glslc.exe" shader.frag -o frag.spv
+"C:/Program Files/Vulkan/Bin/glslc.exe" shader.vert -o shader.vert.spv
+"C:/Program Files/Vulkan/Bin/glslc.exe" shader_compact.vert -o shader_compact.vert.spv
+"C:/Program Files/Vulkan/Bin/glslc.exe" shader.frag -o shader.frag.spv
+"C:/Program Files/Vulkan/Bin/glslc.exe" shader_packed.frag -o shader_packed.frag.spv
 pause
\ No newline at end of file
@@ -0,0 +1,56 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject
+{
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+
+	vec3 lightPos;
+	vec3 viewPos;
+	vec3 lightColor;
+
+	vec4 positionTransform;
+	vec4 texCoordTransform;
+} ubo;
+
+// CompactVertex, the attribute formats turn every component back into a float
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragPos;
+
+layout(location = 1) out vec3 normal;
+layout(location = 2) out vec3 fragColor;
+layout(location = 3) out vec2 fragTexCoord;
+
+layout(location = 4) out vec3 lightPos;
+layout(location = 5) out vec3 viewPos;
+layout(location = 6) out vec3 lightColor;
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+	vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main()
+{
+	vec3 position = ubo.positionTransform.xyz + ubo.positionTransform.w * inPosition.xyz;
+
+	fragPos = vec3(ubo.model * vec4(position, 1.0));
+
+	gl_Position = ubo.proj * ubo.view * vec4(fragPos, 1.0);
+
+	normal = mat3(transpose(inverse(ubo.model))) * decodeOctahedral(inNormal);
+	fragColor = vec3(1.0);
+	fragTexCoord = ubo.texCoordTransform.zw + ubo.texCoordTransform.xy * inTexCoord;
+
+	lightPos = ubo.lightPos;
+	viewPos = ubo.viewPos;
+	lightColor = ubo.lightColor;
+}
@@ -0,0 +1,289 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+struct ArenaStats
+{
+    uint64_t allocations = 0; // bump allocations served from the arena
+    uint64_t bytesAllocated = 0;
+    uint64_t blockAllocations = 0; // trips to the system allocator, should stay at zero once warmed up
+    uint64_t blockBytes = 0;
+};
+
+// bump allocator for memory that dies all at once. space is carved out of large blocks and only handed back
+// by reset(), which keeps the blocks around for the next round instead of returning them to the system
+class Arena
+{
+public:
+    Arena(size_t blockSize, bool hugePages = false);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    void reset();
+
+    template<typename T>
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    const ArenaStats& getStats() const { return stats; }
+    void resetStats() { stats = ArenaStats{}; }
+
+private:
+    struct Block
+    {
+        char* data = nullptr;
+        size_t size = 0;
+        bool hugePages = false;
+    };
+
+    Block allocateBlock(size_t minimumSize);
+    void freeBlock(Block& block);
+
+    std::vector<Block> blocks;
+    size_t currentBlock = 0;
+    size_t head = 0;
+
+    size_t blockSize = 0;
+    bool hugePages = false;
+
+    ArenaStats stats;
+};
+
+// large pages are 2MB on every platform we run on
+const size_t ARENA_HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+Arena::Arena(size_t blockSize, bool hugePages)
+{
+    this->blockSize = blockSize;
+    this->hugePages = hugePages;
+}
+
+Arena::~Arena()
+{
+    for (Block& block : blocks)
+    {
+        freeBlock(block);
+    }
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+    while (currentBlock < blocks.size())
+    {
+        Block& block = blocks[currentBlock];
+
+        size_t offset = (head + alignment - 1) & ~(alignment - 1);
+
+        if (offset + size <= block.size)
+        {
+            head = offset + size;
+
+            stats.allocations++;
+            stats.bytesAllocated += size;
+
+            return block.data + offset;
+        }
+
+        // does not fit, move on to the next retained block
+        currentBlock++;
+        head = 0;
+    }
+
+    // alignment of a fresh block is at least a page, so only the size has to fit
+    blocks.push_back(allocateBlock(size));
+    currentBlock = blocks.size() - 1;
+    head = size;
+
+    stats.allocations++;
+    stats.bytesAllocated += size;
+
+    return blocks.back().data;
+}
+
+// everything allocated so far is invalid afterwards, the blocks are kept for reuse
+void Arena::reset()
+{
+    currentBlock = 0;
+    head = 0;
+}
+
+Arena::Block Arena::allocateBlock(size_t minimumSize)
+{
+    Block block{};
+    block.size = minimumSize > blockSize ? minimumSize : blockSize;
+
+    if (hugePages)
+    {
+        block.size = (block.size + ARENA_HUGE_PAGE_SIZE - 1) & ~(ARENA_HUGE_PAGE_SIZE - 1);
+    }
+
+#ifdef _WIN32
+    if (hugePages)
+    {
+        // needs the lock pages in memory privilege, without it we quietly fall back to normal pages
+        size_t largePageSize = GetLargePageMinimum();
+
+        if (largePageSize != 0 && block.size % largePageSize == 0)
+        {
+            block.data = static_cast<char*>(VirtualAlloc(nullptr, block.size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+        }
+    }
+
+    if (block.data == nullptr)
+    {
+        block.data = static_cast<char*>(VirtualAlloc(nullptr, block.size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    }
+#else
+    void* data = mmap(nullptr, block.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    block.data = data == MAP_FAILED ? nullptr : static_cast<char*>(data);
+
+#ifdef MADV_HUGEPAGE
+    if (block.data != nullptr && hugePages)
+    {
+        madvise(block.data, block.size, MADV_HUGEPAGE);
+    }
+#endif
+#endif
+
+    if (block.data == nullptr)
+    {
+        throw std::runtime_error("failed to allocate arena block");
+    }
+
+    block.hugePages = hugePages;
+
+    stats.blockAllocations++;
+    stats.blockBytes += block.size;
+
+    return block;
+}
+
+void Arena::freeBlock(Block& block)
+{
+#ifdef _WIN32
+    VirtualFree(block.data, 0, MEM_RELEASE);
+#else
+    munmap(block.data, block.size);
+#endif
+
+    block = Block{};
+}
+
+// lets standard containers draw from an arena, deallocate is a no-op since the arena frees in bulk
+template<typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    ArenaAllocator(Arena& arena) : pArena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : pArena(other.pArena) {}
+
+    T* allocate(size_t count)
+    {
+        return pArena->allocate<T>(count);
+    }
+
+    void deallocate(T*, size_t) {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return pArena == other.pArena; }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return pArena != other.pArena; }
+
+    Arena* pArena = nullptr;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// one arena per frame in flight for cpu data that only lives while a frame is being built,
+// an arena is rewound the next time its frame slot comes around
+class FrameAllocator
+{
+public:
+    FrameAllocator(size_t blockSize, uint32_t frameCount);
+
+    void beginFrame(uint32_t frameIndex);
+    Arena& get();
+
+    ArenaStats getStats() const;
+    void resetStats();
+
+private:
+    std::vector<std::unique_ptr<Arena>> arenas;
+    uint32_t currentFrame = 0;
+};
+
+FrameAllocator::FrameAllocator(size_t blockSize, uint32_t frameCount)
+{
+    for (uint32_t i = 0; i < frameCount; i++)
+    {
+        arenas.push_back(std::make_unique<Arena>(blockSize));
+    }
+}
+
+void FrameAllocator::beginFrame(uint32_t frameIndex)
+{
+    currentFrame = frameIndex;
+    arenas[currentFrame]->reset();
+}
+
+Arena& FrameAllocator::get()
+{
+    return *arenas[currentFrame];
+}
+
+ArenaStats FrameAllocator::getStats() const
+{
+    ArenaStats total{};
+
+    for (const auto& arena : arenas)
+    {
+        const ArenaStats& stats = arena->getStats();
+
+        total.allocations += stats.allocations;
+        total.bytesAllocated += stats.bytesAllocated;
+        total.blockAllocations += stats.blockAllocations;
+        total.blockBytes += stats.blockBytes;
+    }
+
+    return total;
+}
+
+void FrameAllocator::resetStats()
+{
+    for (auto& arena : arenas)
+    {
+        arena->resetStats();
+    }
+}
+
+#endif // ARENA_H
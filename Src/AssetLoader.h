@@ -0,0 +1,248 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "UploadContext.h"
+
+// how far the loads handed to an AssetLoader have got, passed to the progress callback whenever it changes
+struct AssetLoadProgress
+{
+    size_t requested = 0;
+    size_t completed = 0;
+    size_t failed = 0;
+};
+
+// loads assets in the background while frames keep being presented. every load has three stages:
+// prepare runs on the thread pool and does the parsing and decoding, finalize runs in update() on the thread
+// that owns the upload context and records the gpu copies, and complete runs in update() once those copies
+// have finished, which is when the result can be swapped in for its placeholder.
+// all loads prepare at the same time and each one is finalized as soon as it is ready, so a large texture
+// does not hold back the uploads of the small ones requested after it.
+// all vulkan work stays on the thread calling update(), so the queues need no locking
+class AssetLoader
+{
+public:
+    AssetLoader(ThreadPool& threadPool, UploadContext& uploadContext);
+
+    void load(const std::string& name, std::function<void()> prepare, std::function<void()> finalize, std::function<void(bool)> complete);
+
+    // called once per frame, before the frame's own submission
+    void update();
+
+    // blocks until nothing is pending any more, used before tearing down
+    void waitIdle();
+
+    bool isIdle() const;
+
+    void setProgressCallback(std::function<void(const AssetLoadProgress&)> callback);
+
+    // prints how long every asset took to prepare, record and upload once it completes
+    void setVerbose(bool verbose);
+
+    const AssetLoadProgress& getProgress() const;
+
+private:
+    struct Job
+    {
+        std::string name;
+        std::future<void> prepared;
+        std::function<void()> finalize;
+        std::function<void(bool)> complete;
+        uint64_t ticket = 0;
+
+        // written by the worker, read once the future is ready
+        std::shared_ptr<double> prepareMilliseconds;
+        double finalizeMilliseconds = 0.0;
+        std::chrono::steady_clock::time_point uploadStart;
+    };
+
+    static double getMilliseconds(std::chrono::steady_clock::time_point start);
+
+    void fail(Job& job, const std::exception& e);
+    void notifyProgress();
+
+    std::deque<Job> preparing;
+    std::deque<Job> uploading;
+
+    AssetLoadProgress progress;
+    std::function<void(const AssetLoadProgress&)> progressCallback;
+
+    bool verbose = false;
+
+    ThreadPool* pThreadPool = nullptr;
+    UploadContext* pUploadContext = nullptr;
+};
+
+// how many prepared assets are finalized per update, so a burst of finished loads does not stall one frame
+const size_t ASSET_FINALIZES_PER_UPDATE = 4;
+
+AssetLoader::AssetLoader(ThreadPool& threadPool, UploadContext& uploadContext)
+{
+    pThreadPool = &threadPool;
+    pUploadContext = &uploadContext;
+}
+
+void AssetLoader::load(const std::string& name, std::function<void()> prepare, std::function<void()> finalize, std::function<void(bool)> complete)
+{
+    Job job;
+    job.name = name;
+    job.prepareMilliseconds = std::make_shared<double>(0.0);
+
+    job.prepared = pThreadPool->submit([prepare = std::move(prepare), prepareMilliseconds = job.prepareMilliseconds]()
+    {
+        auto start = std::chrono::steady_clock::now();
+        prepare();
+        *prepareMilliseconds = getMilliseconds(start);
+    });
+
+    job.finalize = std::move(finalize);
+    job.complete = std::move(complete);
+
+    preparing.push_back(std::move(job));
+
+    progress.requested++;
+    notifyProgress();
+}
+
+void AssetLoader::update()
+{
+    size_t finalized = 0;
+    bool recorded = false;
+
+    // whichever loads have finished preparing, oldest first
+    for (auto it = preparing.begin(); it != preparing.end() && finalized < ASSET_FINALIZES_PER_UPDATE;)
+    {
+        Job& job = *it;
+
+        if (job.prepared.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++it;
+            continue;
+        }
+
+        try
+        {
+            job.prepared.get();
+
+            auto start = std::chrono::steady_clock::now();
+            job.finalize();
+            job.finalizeMilliseconds = getMilliseconds(start);
+            job.uploadStart = std::chrono::steady_clock::now();
+
+            uploading.push_back(std::move(job));
+            recorded = true;
+        }
+        catch (const std::exception& e)
+        {
+            fail(job, e);
+        }
+
+        it = preparing.erase(it);
+        finalized++;
+    }
+
+    if (recorded)
+    {
+        uint64_t ticket = pUploadContext->submit();
+
+        for (Job& job : uploading)
+        {
+            if (job.ticket == 0)
+            {
+                job.ticket = ticket;
+            }
+        }
+    }
+
+    while (!uploading.empty() && pUploadContext->isComplete(uploading.front().ticket))
+    {
+        Job& job = uploading.front();
+
+        // upload time runs until the copies were seen to be done, so it is rounded up to whole frames
+        if (verbose)
+        {
+            std::cout << "loaded " << job.name << ": prepared in " << *job.prepareMilliseconds << " ms, recorded in " << job.finalizeMilliseconds
+                << " ms, uploaded after " << getMilliseconds(job.uploadStart) << " ms" << std::endl;
+        }
+
+        job.complete(true);
+        progress.completed++;
+
+        uploading.pop_front();
+        notifyProgress();
+    }
+}
+
+void AssetLoader::waitIdle()
+{
+    while (!isIdle())
+    {
+        if (!preparing.empty())
+        {
+            preparing.front().prepared.wait();
+        }
+
+        update();
+
+        if (preparing.empty() && !uploading.empty())
+        {
+            pUploadContext->wait(uploading.back().ticket);
+        }
+    }
+}
+
+bool AssetLoader::isIdle() const
+{
+    return preparing.empty() && uploading.empty();
+}
+
+void AssetLoader::setProgressCallback(std::function<void(const AssetLoadProgress&)> callback)
+{
+    progressCallback = std::move(callback);
+}
+
+void AssetLoader::setVerbose(bool verbose)
+{
+    this->verbose = verbose;
+}
+
+const AssetLoadProgress& AssetLoader::getProgress() const
+{
+    return progress;
+}
+
+double AssetLoader::getMilliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// a failed asset keeps its placeholder, the rest of the scene still loads
+void AssetLoader::fail(Job& job, const std::exception& e)
+{
+    std::cerr << "failed to load " << job.name << ": " << e.what() << std::endl;
+
+    progress.failed++;
+    job.complete(false);
+
+    notifyProgress();
+}
+
+void AssetLoader::notifyProgress()
+{
+    if (progressCallback)
+    {
+        progressCallback(progress);
+    }
+}
+
+#endif // ASSET_LOADER_H
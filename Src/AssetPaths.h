@@ -0,0 +1,91 @@
+#ifndef ASSET_PATHS_H
+#define ASSET_PATHS_H
+
+#include <filesystem>
+#include <string>
+
+#include "MaterialPacking.h"
+
+// where assetbake puts the runtime version of a source asset. the baked tree mirrors the source tree,
+// only the extensions change
+namespace AssetPaths
+{
+    const char* const SOURCE_ASSET_ROOT = "Resources";
+    const char* const BAKED_ASSET_ROOT = "Baked";
+
+    // shaders live outside the asset tree and are baked by a run of their own into here
+    const char* const SOURCE_SHADER_ROOT = "Shaders";
+    const char* const BAKED_SHADER_ROOT = "Baked/Shaders";
+
+    // extension of the baked file for a source extension, empty when the baker leaves the file alone
+    static std::string getBakedExtension(std::string extension)
+    {
+        extension = MaterialPacking::toLower(extension);
+
+        if (extension == ".obj")
+        {
+            return ".mesh";
+        }
+
+        if (extension == ".png" || extension == ".jpg" || extension == ".jpeg")
+        {
+            return ".ktx2";
+        }
+
+        if (extension == ".vert" || extension == ".frag" || extension == ".comp")
+        {
+            return extension + ".spv";
+        }
+
+        return "";
+    }
+
+    static std::filesystem::path getBakedPath(const std::filesystem::path& sourceRoot, const std::filesystem::path& bakedRoot, const std::filesystem::path& sourcePath)
+    {
+        std::filesystem::path baked = bakedRoot / sourcePath.lexically_relative(sourceRoot);
+        std::string extension = getBakedExtension(sourcePath.extension().string());
+
+        // shaders keep their stage in the name, shader.vert becomes shader.vert.spv
+        if (extension.size() > 4 && extension.compare(extension.size() - 4, 4, ".spv") == 0)
+        {
+            baked += ".spv";
+        }
+        else
+        {
+            baked.replace_extension(extension);
+        }
+
+        return baked;
+    }
+
+    // the baked file when one has been built for a path under sourceRoot, otherwise the path itself
+    static std::string resolve(const std::string& sourcePath, const std::filesystem::path& sourceRoot, const std::filesystem::path& bakedRoot)
+    {
+        std::filesystem::path source(sourcePath);
+        std::filesystem::path relative = source.lexically_relative(sourceRoot);
+
+        if (relative.empty() || relative.begin()->string() == ".." || getBakedExtension(source.extension().string()).empty())
+        {
+            return sourcePath;
+        }
+
+        std::filesystem::path baked = getBakedPath(sourceRoot, bakedRoot, source);
+
+        std::error_code error;
+        return std::filesystem::exists(baked, error) ? baked.generic_string() : sourcePath;
+    }
+
+    static std::string resolve(const std::string& sourcePath)
+    {
+        return resolve(sourcePath, SOURCE_ASSET_ROOT, BAKED_ASSET_ROOT);
+    }
+
+    // the spir-v for a glsl source, baked when assetbake has built it, otherwise the one compile.bat puts next to it
+    static std::string resolveShader(const std::string& sourcePath)
+    {
+        std::string resolved = resolve(sourcePath, SOURCE_SHADER_ROOT, BAKED_SHADER_ROOT);
+        return resolved != sourcePath ? resolved : sourcePath + ".spv";
+    }
+};
+
+#endif // ASSET_PATHS_H
@@ -5,44 +5,35 @@
 #include <GLFW/glfw3.h>
 
 #include <array>
+#include <cstdint>
 
 #include "QueueFamily.h"
+#include "GeometryArena.h"
 
-namespace CommandBuffer
+// one indexed draw, built into the frame allocator each frame. draws are sorted by sortKey before recording
+// so everything that shares a pipeline and then a material is recorded together
+struct DrawItem
 {
-    static VkCommandBuffer beginSingleTimeCommands(VkCommandPool& commandPool, VkDevice& device)
-    {
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = commandPool;
-        allocInfo.commandBufferCount = 1;
-
-        VkCommandBuffer commandBuffer;
-        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-        vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-        return commandBuffer;
-    }
+    VkPipeline pipeline;
+    VkDescriptorSet descriptorSet;
+    uint32_t uniformOffset;
+
+    VkBuffer vertexBuffer; // the geometry arena block the mesh lives in
+    VkBuffer indexBuffer;
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    VkIndexType indexType;
+
+    uint64_t sortKey;
+};
 
-    static void endSingleTimeCommands(VkCommandBuffer commandBuffer, VkQueue& graphicsQueue, VkCommandPool& commandPool, VkDevice& device)
+namespace CommandBuffer
+{
+    // the pipeline is the most expensive state to change, so it takes the high bits
+    static uint64_t getDrawSortKey(uint32_t pipelineIndex, uint32_t materialIndex)
     {
-        vkEndCommandBuffer(commandBuffer);
-
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-
-        vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue);
-
-        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+        return (static_cast<uint64_t>(pipelineIndex) << 32) | materialIndex;
     }
 
     static void createCommandPool(VkPhysicalDevice& physicalDevice, VkDevice& device, VkSurfaceKHR& surface, VkCommandPool& commandPool)
@@ -76,7 +67,7 @@ namespace CommandBuffer
     }
 
     void recordCommandBuffer(VkCommandBuffer commandBuffer, unsigned int imageIndex, VkRenderPass& renderPass, std::vector<VkFramebuffer>& swapChainFramebuffers, VkExtent2D& swapChainExtent, 
-        VkPipeline& graphicsPipeline, VkBuffer& vertexBuffer, VkBuffer& indexBuffer, VkPipelineLayout& pipelineLayout, std::vector<VkDescriptorSet>& descriptorSets, unsigned int& currentFrame, std::vector<uint32_t>& indices)
+        VkPipelineLayout& pipelineLayout, const DrawItem* drawItems, size_t drawCount)
     {
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -106,8 +97,6 @@ namespace CommandBuffer
         //render pass
         vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
         VkViewport viewport{};
         viewport.x = 0.0f;
         viewport.y = 0.0f;
@@ -122,13 +111,49 @@ namespace CommandBuffer
         scissor.extent = swapChainExtent;
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-        VkBuffer vertexBuffers[] = { vertexBuffer };
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
-
-        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+        // state is only bound when it differs from the previous draw, which the sort makes the rare case.
+        // meshes pick 16 or 32 bit indices on their own, so the index buffer is rebound when the type changes
+        // as well as when the mesh lives in another block of the geometry arena
+        VkPipeline boundPipeline = VK_NULL_HANDLE;
+        VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+        uint32_t boundUniformOffset = UINT32_MAX;
+        VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+        VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+        VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+        for (size_t i = 0; i < drawCount; i++)
+        {
+            const DrawItem& draw = drawItems[i];
+
+            if (draw.pipeline != boundPipeline)
+            {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipeline);
+                boundPipeline = draw.pipeline;
+            }
+
+            if (draw.vertexBuffer != boundVertexBuffer)
+            {
+                VkDeviceSize offset = 0;
+                vkCmdBindVertexBuffers(commandBuffer, 0, 1, &draw.vertexBuffer, &offset);
+                boundVertexBuffer = draw.vertexBuffer;
+            }
+
+            if (draw.indexBuffer != boundIndexBuffer || draw.indexType != boundIndexType)
+            {
+                vkCmdBindIndexBuffer(commandBuffer, draw.indexBuffer, 0, draw.indexType);
+                boundIndexBuffer = draw.indexBuffer;
+                boundIndexType = draw.indexType;
+            }
+
+            if (draw.descriptorSet != boundDescriptorSet || draw.uniformOffset != boundUniformOffset)
+            {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &draw.descriptorSet, 1, &draw.uniformOffset);
+                boundDescriptorSet = draw.descriptorSet;
+                boundUniformOffset = draw.uniformOffset;
+            }
+
+            vkCmdDrawIndexed(commandBuffer, draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, 0);
+        }
 
         vkCmdEndRenderPass(commandBuffer);
 
@@ -0,0 +1,59 @@
+#ifndef COMPACT_VERTEX_H
+#define COMPACT_VERTEX_H
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <cstdint>
+
+// layout of the vertices in the geometry arena. every model shares the arena's layout, the pipeline is built for it
+enum class VertexFormat
+{
+    Full,      // Vertex as loaded, 44 bytes
+    Quantized, // CompactVertex with positions as snorm16 inside the mesh bounds and uvs as unorm16 inside the uv bounds
+    Half       // CompactVertex with half float positions and uvs, no per mesh transform needed
+};
+
+// 16 bytes instead of 44. the constant colour is gone, normals are octahedral encoded and everything else is 16 bit.
+// the hardware converts every attribute to float, so both compact formats share shader_compact.vert
+struct CompactVertex
+{
+    uint16_t position[4]; // w is padding, vertex attributes of three 16 bit components are not widely supported
+    int16_t normal[2];
+    uint16_t texCoord[2];
+
+    static VkVertexInputBindingDescription getBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(CompactVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions(VertexFormat format)
+    {
+        std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = format == VertexFormat::Quantized ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R16G16B16A16_SFLOAT;
+        attributeDescriptions[0].offset = offsetof(CompactVertex, position);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+        attributeDescriptions[1].offset = offsetof(CompactVertex, normal);
+
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = format == VertexFormat::Quantized ? VK_FORMAT_R16G16_UNORM : VK_FORMAT_R16G16_SFLOAT;
+        attributeDescriptions[2].offset = offsetof(CompactVertex, texCoord);
+
+        return attributeDescriptions;
+    }
+};
+
+#endif // COMPACT_VERTEX_H
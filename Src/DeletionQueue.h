@@ -0,0 +1,67 @@
+#ifndef DELETION_QUEUE_H
+#define DELETION_QUEUE_H
+
+#include <functional>
+#include <vector>
+
+// destruction of gpu objects is deferred until the frame that could still be using them has finished.
+// work pushed while recording frame N runs the next time frame slot N is reused, right after its fence was waited on
+class DeletionQueue
+{
+public:
+    DeletionQueue(uint32_t framesInFlight);
+
+    void push(std::function<void()>&& deleter);
+    void collect(uint32_t frameIndex);
+    void flush();
+
+private:
+    std::vector<std::vector<std::function<void()>>> frames;
+    uint32_t currentFrame = 0;
+};
+
+DeletionQueue::DeletionQueue(uint32_t framesInFlight)
+{
+    frames.resize(framesInFlight);
+}
+
+void DeletionQueue::push(std::function<void()>&& deleter)
+{
+    frames[currentFrame].push_back(std::move(deleter));
+}
+
+// called once the fence of frameIndex has signaled, everything queued the last time that slot was recorded is now unused
+void DeletionQueue::collect(uint32_t frameIndex)
+{
+    currentFrame = frameIndex;
+
+    std::vector<std::function<void()>> deleters;
+    deleters.swap(frames[frameIndex]);
+
+    for (auto& deleter : deleters)
+    {
+        deleter();
+    }
+}
+
+// only valid once the device is idle
+void DeletionQueue::flush()
+{
+    bool pending = true;
+
+    while (pending)
+    {
+        pending = false;
+
+        for (uint32_t i = 0; i < frames.size(); i++)
+        {
+            if (!frames[i].empty())
+            {
+                pending = true;
+                collect(i);
+            }
+        }
+    }
+}
+
+#endif // DELETION_QUEUE_H
@@ -0,0 +1,278 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "MemoryAllocator.h"
+#include "VertexEncoding.h"
+
+// where a mesh lives inside the arena, vertexOffset and firstIndex go straight into vkCmdDrawIndexed with the
+// buffers of block bound. firstIndex counts elements of indexType, meshes with few enough vertices use 16 bit indices
+struct GeometryRange
+{
+    VmaVirtualAllocation vertexAllocation = VK_NULL_HANDLE;
+    VmaVirtualAllocation indexAllocation = VK_NULL_HANDLE;
+
+    uint32_t block = 0;
+    int32_t vertexOffset = 0;
+    uint32_t firstIndex = 0;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+};
+
+// packs the vertices and indices of every model into device local vertex and index buffers, ranges are handed out
+// by VMA virtual blocks so freed space is reused by later models. a mesh that fits none of the blocks gets a new
+// one, at least as large as the first and larger when the mesh needs it. blocks other than the first go away again
+// once their last mesh is freed. all vertices are stored in the arena's format
+class GeometryArena
+{
+public:
+    GeometryArena(VertexFormat vertexFormat, uint32_t vertexCapacity, uint32_t indexCapacity, MemoryAllocator& allocator);
+    void destroyGeometryArena();
+
+    GeometryRange allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType);
+    void free(GeometryRange& range);
+
+    VkBuffer getVertexBuffer(const GeometryRange& range);
+    VkBuffer getIndexBuffer(const GeometryRange& range);
+
+    VkDeviceSize getVertexByteOffset(const GeometryRange& range);
+    VkDeviceSize getIndexByteOffset(const GeometryRange& range);
+
+    VertexFormat vertexFormat = VertexFormat::Full;
+    uint32_t vertexStride = 0;
+
+private:
+    // both virtual blocks are measured in elements (vertices and 32 bit index slots) rather than bytes
+    struct Block
+    {
+        VkBuffer vertexBuffer = NULL;
+        VkBuffer indexBuffer = NULL;
+
+        VmaAllocation vertexBufferAllocation = NULL;
+        VmaAllocation indexBufferAllocation = NULL;
+
+        VmaVirtualBlock vertexBlock = VK_NULL_HANDLE;
+        VmaVirtualBlock indexBlock = VK_NULL_HANDLE;
+    };
+
+    uint32_t createBlock(uint32_t vertexCapacity, uint32_t indexCapacity);
+    void destroyBlock(Block& block);
+    bool allocateInBlock(uint32_t blockIndex, uint32_t vertexCount, uint32_t indexSlots, GeometryRange& range);
+
+    std::vector<Block> blocks; // a destroyed block leaves its slot empty so the indices of the others stay valid
+
+    uint32_t blockVertexCapacity = 0;
+    uint32_t blockIndexCapacity = 0;
+
+    MemoryAllocator* pAllocator = nullptr;
+};
+
+GeometryArena::GeometryArena(VertexFormat vertexFormat, uint32_t vertexCapacity, uint32_t indexCapacity, MemoryAllocator& allocator)
+{
+    this->vertexFormat = vertexFormat;
+    vertexStride = VertexEncoding::getVertexStride(vertexFormat);
+
+    blockVertexCapacity = vertexCapacity;
+    blockIndexCapacity = indexCapacity;
+    pAllocator = &allocator;
+
+    createBlock(vertexCapacity, indexCapacity);
+}
+
+void GeometryArena::destroyGeometryArena()
+{
+    for (Block& block : blocks)
+    {
+        destroyBlock(block);
+    }
+
+    blocks.clear();
+}
+
+uint32_t GeometryArena::createBlock(uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+    Block block;
+
+    pAllocator->createBuffer(static_cast<VkDeviceSize>(vertexCapacity) * vertexStride, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        MemoryUsage::Geometry, block.vertexBuffer, block.vertexBufferAllocation);
+
+    try
+    {
+        pAllocator->createBuffer(static_cast<VkDeviceSize>(indexCapacity) * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            MemoryUsage::Geometry, block.indexBuffer, block.indexBufferAllocation);
+
+        VmaVirtualBlockCreateInfo blockInfo{};
+
+        blockInfo.size = vertexCapacity;
+        if (vmaCreateVirtualBlock(&blockInfo, &block.vertexBlock) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create vertex arena");
+        }
+
+        blockInfo.size = indexCapacity;
+        if (vmaCreateVirtualBlock(&blockInfo, &block.indexBlock) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create index arena");
+        }
+    }
+    catch (const std::exception&)
+    {
+        destroyBlock(block);
+        throw;
+    }
+
+    for (uint32_t i = 0; i < blocks.size(); i++)
+    {
+        if (blocks[i].vertexBuffer == NULL)
+        {
+            blocks[i] = block;
+            return i;
+        }
+    }
+
+    blocks.push_back(block);
+
+    return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+// any range still allocated is dropped together with the block
+void GeometryArena::destroyBlock(Block& block)
+{
+    if (block.vertexBlock != VK_NULL_HANDLE)
+    {
+        vmaClearVirtualBlock(block.vertexBlock);
+        vmaDestroyVirtualBlock(block.vertexBlock);
+    }
+
+    if (block.indexBlock != VK_NULL_HANDLE)
+    {
+        vmaClearVirtualBlock(block.indexBlock);
+        vmaDestroyVirtualBlock(block.indexBlock);
+    }
+
+    if (block.indexBuffer != NULL)
+    {
+        pAllocator->destroyBuffer(block.indexBuffer, block.indexBufferAllocation);
+    }
+
+    if (block.vertexBuffer != NULL)
+    {
+        pAllocator->destroyBuffer(block.vertexBuffer, block.vertexBufferAllocation);
+    }
+
+    block = Block{};
+}
+
+bool GeometryArena::allocateInBlock(uint32_t blockIndex, uint32_t vertexCount, uint32_t indexSlots, GeometryRange& range)
+{
+    Block& block = blocks[blockIndex];
+
+    if (block.vertexBuffer == NULL)
+    {
+        return false;
+    }
+
+    VmaVirtualAllocationCreateInfo allocInfo{};
+    VkDeviceSize offset;
+
+    allocInfo.size = vertexCount;
+    if (vmaVirtualAllocate(block.vertexBlock, &allocInfo, &range.vertexAllocation, &offset) != VK_SUCCESS)
+    {
+        return false;
+    }
+    range.vertexOffset = static_cast<int32_t>(offset);
+
+    allocInfo.size = indexSlots;
+    if (vmaVirtualAllocate(block.indexBlock, &allocInfo, &range.indexAllocation, &offset) != VK_SUCCESS)
+    {
+        vmaVirtualFree(block.vertexBlock, range.vertexAllocation);
+        range.vertexAllocation = VK_NULL_HANDLE;
+        return false;
+    }
+    range.firstIndex = static_cast<uint32_t>(offset) * (sizeof(uint32_t) / VertexEncoding::getIndexSize(range.indexType));
+
+    range.block = blockIndex;
+
+    return true;
+}
+
+GeometryRange GeometryArena::allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType)
+{
+    GeometryRange range{};
+    range.vertexCount = vertexCount;
+    range.indexCount = indexCount;
+    range.indexType = indexType;
+
+    // two 16 bit indices share a slot
+    uint32_t indexSlots = indexType == VK_INDEX_TYPE_UINT16 ? (indexCount + 1) / 2 : indexCount;
+
+    for (uint32_t i = 0; i < blocks.size(); i++)
+    {
+        if (allocateInBlock(i, vertexCount, indexSlots, range))
+        {
+            return range;
+        }
+    }
+
+    uint32_t block = createBlock(std::max(blockVertexCapacity, vertexCount), std::max(blockIndexCapacity, indexSlots));
+
+    if (!allocateInBlock(block, vertexCount, indexSlots, range))
+    {
+        throw std::runtime_error("failed to allocate geometry");
+    }
+
+    return range;
+}
+
+void GeometryArena::free(GeometryRange& range)
+{
+    Block& block = blocks[range.block];
+
+    if (range.vertexAllocation != VK_NULL_HANDLE)
+    {
+        vmaVirtualFree(block.vertexBlock, range.vertexAllocation);
+    }
+
+    if (range.indexAllocation != VK_NULL_HANDLE)
+    {
+        vmaVirtualFree(block.indexBlock, range.indexAllocation);
+    }
+
+    // ranges are freed through the deletion queue, so no frame in flight still reads the buffers
+    if (range.block != 0 && block.vertexBuffer != NULL && vmaIsVirtualBlockEmpty(block.vertexBlock) && vmaIsVirtualBlockEmpty(block.indexBlock))
+    {
+        destroyBlock(block);
+    }
+
+    range = GeometryRange{};
+}
+
+VkBuffer GeometryArena::getVertexBuffer(const GeometryRange& range)
+{
+    return blocks[range.block].vertexBuffer;
+}
+
+VkBuffer GeometryArena::getIndexBuffer(const GeometryRange& range)
+{
+    return blocks[range.block].indexBuffer;
+}
+
+VkDeviceSize GeometryArena::getVertexByteOffset(const GeometryRange& range)
+{
+    return static_cast<VkDeviceSize>(range.vertexOffset) * vertexStride;
+}
+
+VkDeviceSize GeometryArena::getIndexByteOffset(const GeometryRange& range)
+{
+    return static_cast<VkDeviceSize>(range.firstIndex) * VertexEncoding::getIndexSize(range.indexType);
+}
+
+#endif // GEOMETRY_ARENA_H
@@ -9,30 +9,35 @@
 #include <cmath>
 
 #include "Buffer.h"
-#include "CommandBuffer.h"
 #include "ImageView.h"
+#include "MemoryAllocator.h"
+#include "DeletionQueue.h"
 
 class Image
 {
 public:
-    Image(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkDevice& device, VkPhysicalDevice& physicalDevice);
+    Image(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, MemoryUsage memoryUsage, VkDevice& device, MemoryAllocator& allocator, DeletionQueue& deletionQueue, uint32_t arrayLayers = 1, VkImageCreateFlags flags = 0);
     void destroyImage();
-    void transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels, VkCommandPool& commandPool, VkDevice& device, VkQueue& graphicsQueue);
-    void copyBufferToImage(VkBuffer buffer, uint32_t width, uint32_t height, VkCommandPool& commandPool, VkDevice& device, VkQueue& graphicsQueue);
-    void generateMipMaps(VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels, VkPhysicalDevice& physicalDevice, VkDevice& device, VkCommandPool& commandPool, VkQueue& graphicsQueue);
-    void createImageView(VkImageAspectFlags aspectFlags, int mipLevels);
+    void transitionImageLayout(VkCommandBuffer commandBuffer, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+    void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, uint32_t width, uint32_t height, int32_t yOffset = 0, uint32_t mipLevel = 0, uint32_t arrayLayer = 0);
+    void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, const VkBufferImageCopy* regions, uint32_t regionCount);
+    void generateMipMaps(VkCommandBuffer commandBuffer, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels, VkPhysicalDevice& physicalDevice);
+    void createImageView(VkImageAspectFlags aspectFlags, int mipLevels, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D);
     VkImageView getImageView();
 
     VkImageView imageView = NULL;
     VkFormat imageFormat;
+    uint32_t arrayLayers = 1; // cubemaps count each face as a layer
 
     VkImage image = NULL;
-    VkDeviceMemory imageMemory = NULL;
+    VmaAllocation imageAllocation = NULL;
 
     VkDevice* pDevice = nullptr;
+    MemoryAllocator* pAllocator = nullptr;
+    DeletionQueue* pDeletionQueue = nullptr;
 };
 
-Image::Image(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkDevice& device, VkPhysicalDevice& physicalDevice)
+Image::Image(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, MemoryUsage memoryUsage, VkDevice& device, MemoryAllocator& allocator, DeletionQueue& deletionQueue, uint32_t arrayLayers, VkImageCreateFlags flags)
 {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -41,7 +46,8 @@ Image::Image(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountF
     imageInfo.extent.height = height;
     imageInfo.extent.depth = 1;
     imageInfo.mipLevels = mipLevels;
-    imageInfo.arrayLayers = 1;
+    imageInfo.arrayLayers = arrayLayers;
+    imageInfo.flags = flags;
     imageInfo.format = format;
     imageInfo.tiling = tiling;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -49,44 +55,40 @@ Image::Image(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountF
     imageInfo.samples = numSamples;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to create image!");
-    }
-
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(device, image, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = Buffer::findMemoryType(memRequirements.memoryTypeBits, properties, physicalDevice);
-
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to allocate image memory");
-    }
-
-    vkBindImageMemory(device, image, imageMemory, 0);
+    allocator.createImage(imageInfo, memoryUsage, image, imageAllocation);
 
     imageFormat = format;
+    this->arrayLayers = arrayLayers;
     pDevice = &device;
+    pAllocator = &allocator;
+    pDeletionQueue = &deletionQueue;
 }
 
+// the image may still be read by frames in flight, it is destroyed once they have finished
 void Image::destroyImage()
 {
-    if (imageView != NULL)
+    VkDevice device = *pDevice;
+    MemoryAllocator* allocator = pAllocator;
+    VkImage image = this->image;
+    VkImageView imageView = this->imageView;
+    VmaAllocation imageAllocation = this->imageAllocation;
+
+    pDeletionQueue->push([=]()
     {
-        vkDestroyImageView(*pDevice, imageView, nullptr);
-    }
-    vkDestroyImage(*pDevice, image, nullptr);
-    vkFreeMemory(*pDevice, imageMemory, nullptr);
+        if (imageView != NULL)
+        {
+            vkDestroyImageView(device, imageView, nullptr);
+        }
+        allocator->destroyImage(image, imageAllocation);
+    });
+
+    this->image = NULL;
+    this->imageView = NULL;
+    this->imageAllocation = NULL;
 }
 
-void Image::transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels, VkCommandPool& commandPool, VkDevice& device, VkQueue& graphicsQueue)
+void Image::transitionImageLayout(VkCommandBuffer commandBuffer, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
 {
-    VkCommandBuffer commandBuffer = CommandBuffer::beginSingleTimeCommands(commandPool, device);
-
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.oldLayout = oldLayout;
@@ -100,7 +102,7 @@ void Image::transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkIm
     barrier.subresourceRange.baseMipLevel = 0;
     barrier.subresourceRange.levelCount = mipLevels;
     barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange.layerCount = arrayLayers;
 
     VkPipelineStageFlags sourceStage;
     VkPipelineStageFlags destinationStage;
@@ -134,44 +136,43 @@ void Image::transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkIm
         0, nullptr,
         1, &barrier
     );
-
-
-    CommandBuffer::endSingleTimeCommands(commandBuffer, graphicsQueue, commandPool, device);
 }
 
-void Image::copyBufferToImage(VkBuffer buffer, uint32_t width, uint32_t height, VkCommandPool& commandPool, VkDevice& device, VkQueue& graphicsQueue) {
-    VkCommandBuffer commandBuffer = CommandBuffer::beginSingleTimeCommands(commandPool, device);
-
+void Image::copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, uint32_t width, uint32_t height, int32_t yOffset, uint32_t mipLevel, uint32_t arrayLayer) {
     VkBufferImageCopy region{};
-    region.bufferOffset = 0;
+    region.bufferOffset = bufferOffset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
 
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.mipLevel = mipLevel;
+    region.imageSubresource.baseArrayLayer = arrayLayer;
     region.imageSubresource.layerCount = 1;
 
-    region.imageOffset = { 0, 0, 0 };
+    region.imageOffset = { 0, yOffset, 0 };
     region.imageExtent = {
         width,
         height,
         1
     };
 
+    copyBufferToImage(commandBuffer, buffer, &region, 1);
+}
+
+// any number of levels and layers from one staging buffer in a single copy
+void Image::copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, const VkBufferImageCopy* regions, uint32_t regionCount)
+{
     vkCmdCopyBufferToImage(
         commandBuffer,
         buffer,
         image,
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &region
+        regionCount,
+        regions
     );
-
-    CommandBuffer::endSingleTimeCommands(commandBuffer, graphicsQueue, commandPool, device);
 }
 
-void Image::generateMipMaps(VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels, VkPhysicalDevice& physicalDevice, VkDevice& device, VkCommandPool& commandPool, VkQueue& graphicsQueue)
+void Image::generateMipMaps(VkCommandBuffer commandBuffer, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels, VkPhysicalDevice& physicalDevice)
 {
     VkFormatProperties formatProperties;
     vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
@@ -181,8 +182,6 @@ void Image::generateMipMaps(VkFormat imageFormat, int32_t texWidth, int32_t texH
         throw std::runtime_error("texture image format does not support linear bitting");
     }
 
-    VkCommandBuffer commandBuffer = CommandBuffer::beginSingleTimeCommands(commandPool, device);
-
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.image = image;
@@ -255,13 +254,11 @@ void Image::generateMipMaps(VkFormat imageFormat, int32_t texWidth, int32_t texH
         0, nullptr,
         0, nullptr,
         1, &barrier);
-
-    CommandBuffer::endSingleTimeCommands(commandBuffer, graphicsQueue, commandPool, device);
 }
 
-void Image::createImageView(VkImageAspectFlags aspectFlags, int mipLevels)
+void Image::createImageView(VkImageAspectFlags aspectFlags, int mipLevels, VkImageViewType viewType)
 {
-    imageView = ImageView::createImageView(image, imageFormat, aspectFlags, mipLevels, *pDevice);
+    imageView = ImageView::createImageView(image, imageFormat, aspectFlags, mipLevels, *pDevice, viewType, arrayLayers);
 }
 
 VkImageView Image::getImageView()
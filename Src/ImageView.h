@@ -8,19 +8,26 @@
 
 namespace ImageView
 {
-    static VkImageView createImageView(VkImage imageObject, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, VkDevice device)
+    // array and cube views cover every layer from the first, a cube's faces count as six layers
+    static VkImageView createImageView(VkImage imageObject, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, VkDevice device, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D, uint32_t layerCount = 1)
     {
 
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         viewInfo.image = imageObject;
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.viewType = viewType;
         viewInfo.format = format;
         viewInfo.subresourceRange.aspectMask = aspectFlags;
         viewInfo.subresourceRange.baseMipLevel = 0;
         viewInfo.subresourceRange.levelCount = mipLevels;
         viewInfo.subresourceRange.baseArrayLayer = 0;
-        viewInfo.subresourceRange.layerCount = 1;
+        viewInfo.subresourceRange.layerCount = layerCount;
+
+        // one channel textures read as grey, like the RGBA8 maps they replace
+        if (format == VK_FORMAT_BC4_UNORM_BLOCK || format == VK_FORMAT_R8_UNORM)
+        {
+            viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+        }
 
         VkImageView imageView;
 
@@ -0,0 +1,363 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+struct Ktx2Header
+{
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+struct Ktx2Level
+{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// a mapped .ktx2 file, level data points straight into the mapping. a level holds one image per array layer and
+// cube face, layer by layer with the faces of a layer next to each other, every image getImageSize bytes
+struct Ktx2Texture
+{
+    std::unique_ptr<MappedFile> file;
+
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t levelCount = 0;
+    uint32_t layerCount = 1;
+    uint32_t faceCount = 1;
+    bool isArray = false; // a file with one layer may still be an array texture
+
+    std::vector<const char*> levelData;
+    std::vector<uint64_t> levelSizes;
+};
+
+// the Khronos texture container, written by assetbake and read at startup instead of decoding pngs.
+// 2D textures, arrays and cubemaps in RGBA8 or one of the block compressed formats the baker writes
+namespace Ktx2
+{
+    const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    static bool isBlockCompressed(VkFormat format)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    static bool isSupportedFormat(VkFormat format)
+    {
+        return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM || isBlockCompressed(format);
+    }
+
+    // texels across one block, 1 for the uncompressed formats
+    static uint32_t getBlockDimension(VkFormat format)
+    {
+        return isBlockCompressed(format) ? 4 : 1;
+    }
+
+    static uint32_t getBlockBytes(VkFormat format)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            return 8;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return 16;
+        default:
+            return 4;
+        }
+    }
+
+    // bytes of one layer or face of a level
+    static uint64_t getImageSize(VkFormat format, uint32_t width, uint32_t height)
+    {
+        uint32_t blockDimension = getBlockDimension(format);
+        uint64_t blocksWide = (width + blockDimension - 1) / blockDimension;
+        uint64_t blocksHigh = (height + blockDimension - 1) / blockDimension;
+
+        return blocksWide * blocksHigh * getBlockBytes(format);
+    }
+
+    // floor(log2(max(width, height))) + 1, the levels down to 1x1
+    static uint32_t getFullLevelCount(uint32_t width, uint32_t height)
+    {
+        uint32_t levelCount = 1;
+
+        for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+        {
+            levelCount++;
+        }
+
+        return levelCount;
+    }
+
+    static bool isSrgb(VkFormat format)
+    {
+        return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK;
+    }
+
+    static bool isKtx2Path(const std::string& path)
+    {
+        return path.size() > 5 && path.compare(path.size() - 5, 5, ".ktx2") == 0;
+    }
+
+    static void open(const std::string& path, Ktx2Texture& texture)
+    {
+        texture.file = std::make_unique<MappedFile>(path);
+
+        const MappedFile& file = *texture.file;
+        const Ktx2Header* header = reinterpret_cast<const Ktx2Header*>(file.data);
+
+        if (file.size < sizeof(Ktx2Header) || memcmp(header->identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+        {
+            throw std::runtime_error("not a ktx2 file " + path);
+        }
+
+        bool cubemap = header->faceCount == 6 && header->pixelWidth == header->pixelHeight;
+
+        // basis universal (BasisLZ or UASTC) and zstd payloads would need a transcoder this tree does not have
+        if (header->supercompressionScheme != 0)
+        {
+            throw std::runtime_error("supercompressed ktx2 files are not supported " + path);
+        }
+
+        if (header->pixelDepth > 1 || header->pixelHeight == 0 || (header->faceCount != 1 && !cubemap))
+        {
+            throw std::runtime_error("unsupported ktx2 layout in " + path);
+        }
+
+        if (!isSupportedFormat(static_cast<VkFormat>(header->vkFormat)))
+        {
+            throw std::runtime_error("unsupported ktx2 format in " + path);
+        }
+
+        texture.format = static_cast<VkFormat>(header->vkFormat);
+        texture.width = header->pixelWidth;
+        texture.height = header->pixelHeight;
+        texture.levelCount = header->levelCount > 0 ? header->levelCount : 1;
+        texture.layerCount = header->layerCount > 0 ? header->layerCount : 1;
+        texture.faceCount = header->faceCount;
+        texture.isArray = header->layerCount > 0;
+
+        // every level past the full chain would be 1x1 again, and the sizes are taken with width >> level
+        if (texture.levelCount > getFullLevelCount(texture.width, texture.height))
+        {
+            throw std::runtime_error("too many ktx2 levels in " + path);
+        }
+
+        const Ktx2Level* levels = reinterpret_cast<const Ktx2Level*>(file.data + sizeof(Ktx2Header));
+
+        if (!file.contains(sizeof(Ktx2Header), texture.levelCount, sizeof(Ktx2Level)))
+        {
+            throw std::runtime_error("truncated ktx2 file " + path);
+        }
+
+        for (uint32_t level = 0; level < texture.levelCount; level++)
+        {
+            if (!file.contains(levels[level].byteOffset, levels[level].byteLength, 1))
+            {
+                throw std::runtime_error("truncated ktx2 file " + path);
+            }
+
+            uint64_t imageSize = getImageSize(texture.format, std::max(1u, texture.width >> level), std::max(1u, texture.height >> level));
+
+            if (levels[level].byteLength != imageSize * texture.layerCount * texture.faceCount)
+            {
+                throw std::runtime_error("unexpected ktx2 level size in " + path);
+            }
+
+            texture.levelData.push_back(file.data + levels[level].byteOffset);
+            texture.levelSizes.push_back(levels[level].byteLength);
+        }
+    }
+
+    // basic data format descriptor, required by the spec even though the vkFormat says it all. RGBA8 has a sample
+    // per channel, the block formats one per compressed plane: BC5's red and green halves, the whole block otherwise
+    static std::vector<uint32_t> createDescriptor(VkFormat format)
+    {
+        bool srgb = isSrgb(format);
+        bool compressed = isBlockCompressed(format);
+
+        uint32_t colorModel = 1; // RGBSDA
+        uint32_t sampleCount = 4;
+        const uint32_t rgbaChannels[4] = { 0, 1, 2, 15 };
+
+        switch (format)
+        {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            colorModel = 128;
+            sampleCount = 1;
+            break;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            colorModel = 131;
+            sampleCount = 1;
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            colorModel = 132;
+            sampleCount = 2;
+            break;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            colorModel = 134;
+            sampleCount = 1;
+            break;
+        default:
+            break;
+        }
+
+        const uint32_t blockSize = 24 + 16 * sampleCount;
+        uint32_t blockBytes = getBlockBytes(format);
+        uint32_t blockDimension = getBlockDimension(format) - 1;
+
+        std::vector<uint32_t> descriptor;
+        descriptor.push_back(4 + blockSize); // dfdTotalSize
+        descriptor.push_back(0); // vendor khronos, basic descriptor type
+        descriptor.push_back(2 | (blockSize << 16)); // version 1.3
+        descriptor.push_back(colorModel | (1 << 8) | ((srgb ? 2u : 1u) << 16)); // colour model, BT709 primaries, transfer function
+        descriptor.push_back(blockDimension | (blockDimension << 8)); // texel block dimensions minus one
+        descriptor.push_back(blockBytes); // bytes in plane 0
+        descriptor.push_back(0);
+
+        for (uint32_t i = 0; i < sampleCount; i++)
+        {
+            uint32_t bitLength = compressed ? blockBytes * 8 / sampleCount : 8;
+            uint32_t channel = compressed ? (format == VK_FORMAT_BC5_UNORM_BLOCK ? i : 0) : rgbaChannels[i];
+
+            // alpha is never srgb encoded and has to be flagged linear
+            uint32_t qualifiers = (srgb && channel == 15) ? 0x10 : 0;
+
+            descriptor.push_back((i * bitLength) | ((bitLength - 1) << 16) | ((channel | qualifiers) << 24));
+            descriptor.push_back(0); // sample position
+            descriptor.push_back(0); // lower
+            descriptor.push_back(compressed ? UINT32_MAX : 255); // upper
+        }
+
+        return descriptor;
+    }
+
+    // levels[0] is the full resolution image. the file stores the smallest level first, as the spec recommends
+    static bool write(const std::string& path, VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levels)
+    {
+        std::vector<uint32_t> descriptor = createDescriptor(format);
+
+        Ktx2Header header{};
+        memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+        header.vkFormat = format;
+        header.typeSize = 1;
+        header.pixelWidth = width;
+        header.pixelHeight = height;
+        header.pixelDepth = 0;
+        header.layerCount = 0;
+        header.faceCount = 1;
+        header.levelCount = static_cast<uint32_t>(levels.size());
+        header.supercompressionScheme = 0;
+
+        header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + sizeof(Ktx2Level) * levels.size());
+        header.dfdByteLength = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+
+        std::vector<Ktx2Level> levelIndex(levels.size());
+        uint64_t alignment = getBlockBytes(format);
+        uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+
+        for (size_t level = levels.size(); level-- > 0;)
+        {
+            offset = (offset + alignment - 1) / alignment * alignment; // levels start on a multiple of the texel block size
+
+            levelIndex[level].byteOffset = offset;
+            levelIndex[level].byteLength = levels[level].size();
+            levelIndex[level].uncompressedByteLength = levels[level].size();
+
+            offset += levels[level].size();
+        }
+
+        std::string tempPath = path + ".tmp";
+
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+
+            if (!file)
+            {
+                return false;
+            }
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(levelIndex.data()), levelIndex.size() * sizeof(Ktx2Level));
+            file.write(reinterpret_cast<const char*>(descriptor.data()), descriptor.size() * sizeof(uint32_t));
+
+            uint64_t written = header.dfdByteOffset + header.dfdByteLength;
+            const char padding[16] = {};
+
+            for (size_t level = levels.size(); level-- > 0;)
+            {
+                file.write(padding, levelIndex[level].byteOffset - written);
+                file.write(reinterpret_cast<const char*>(levels[level].data()), levels[level].size());
+                written = levelIndex[level].byteOffset + levels[level].size();
+            }
+
+            if (!file)
+            {
+                file.close();
+                std::remove(tempPath.c_str());
+                return false;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(tempPath, path, error);
+
+        if (error)
+        {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+
+        return true;
+    }
+};
+
+#endif // KTX2_H
@@ -1,15 +1,36 @@
 #include "VulkanRenderer.h"
+#include "ObjBenchmark.h"
 #include <string>
+#include <vector>
 
 
-int main()
+int main(int argc, char* argv[])
 {
+    if (argc == 3 && std::string(argv[1]) == "--bench-obj")
+    {
+        try
+        {
+            return ObjBenchmark::run(argv[2]);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
     VulkanRenderer app;
 
+    // LearnVulkan <model> <base color> <roughness> starts without asking for the paths
+    std::vector<std::string> paths;
+    if (argc == 4)
+    {
+        paths.assign(argv + 1, argv + 4);
+    }
+
     try 
     {
-        app.run();
+        app.run(paths);
     }
     catch (const std::exception& e) 
     {
@@ -0,0 +1,145 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// read only view of a whole file, the os pages it in on demand instead of copying it through a stream
+class MappedFile
+{
+public:
+    MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data = nullptr;
+    size_t size = 0;
+
+    // whether count elements of elementSize bytes at offset lie inside the file. written so that nothing can wrap
+    // around, a damaged header may hold any value
+    bool contains(uint64_t offset, uint64_t count, uint64_t elementSize) const
+    {
+        return offset <= size && count <= (size - offset) / elementSize;
+    }
+
+private:
+    void unmap();
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#endif
+};
+
+MappedFile::MappedFile(const std::string& path)
+{
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("failed to open file " + path);
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size = static_cast<size_t>(fileSize.QuadPart);
+
+    // empty files cannot be mapped
+    if (size == 0)
+    {
+        return;
+    }
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (mapping != NULL)
+    {
+        data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        throw std::runtime_error("failed to open file " + path);
+    }
+
+    struct stat fileStat;
+    fstat(fd, &fileStat);
+    size = static_cast<size_t>(fileStat.st_size);
+
+    if (size == 0)
+    {
+        close(fd);
+        return;
+    }
+
+    void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (view != MAP_FAILED)
+    {
+        data = static_cast<const char*>(view);
+        madvise(view, size, MADV_SEQUENTIAL);
+    }
+#endif
+
+    if (data == nullptr)
+    {
+        unmap();
+        throw std::runtime_error("failed to map file " + path);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+void MappedFile::unmap()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+    if (mapping != NULL)
+    {
+        CloseHandle(mapping);
+    }
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file);
+    }
+    data = nullptr;
+    mapping = NULL;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (data != nullptr)
+    {
+        munmap(const_cast<char*>(data), size);
+    }
+    data = nullptr;
+#endif
+}
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,192 @@
+#ifndef MATERIAL_PACKING_H
+#define MATERIAL_PACKING_H
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "stb_image.h"
+
+// the single channel maps of a material, empty when it has no such map
+struct MaterialMapSources
+{
+    std::string occlusion;
+    std::string roughness;
+    std::string metalness;
+};
+
+// combines a material's occlusion, roughness and metalness maps into the red, green and blue of one texture,
+// so the fragment shader reads all three with one fetch through one binding. the maps are found by name next to
+// the roughness map, the way the source tree names them: croissant_01_L0_Roughness.png and croissant_01_L0_AO.png
+// pack into croissant_01_L0_ORM. assetbake bakes the packed texture, without it the renderer packs on load
+namespace MaterialPacking
+{
+    const char* const PACKED_SUFFIX = "ORM";
+
+    // what a map without a source contributes: no occlusion, no metal
+    const uint8_t DEFAULT_OCCLUSION = 255;
+    const uint8_t DEFAULT_METALNESS = 0;
+
+    static std::string toLower(std::string text)
+    {
+        for (char& c : text)
+        {
+            c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+
+        return text;
+    }
+
+    static bool hasSuffix(const std::string& lowerStem, const char* const* suffixes, size_t suffixCount)
+    {
+        std::string suffix = lowerStem.substr(lowerStem.find_last_of('_') + 1);
+
+        for (size_t i = 0; i < suffixCount; i++)
+        {
+            if (suffix == suffixes[i])
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    const char* const OCCLUSION_SUFFIXES[] = { "ao", "occlusion" };
+    const char* const ROUGHNESS_SUFFIXES[] = { "roughness", "rough" };
+    const char* const METALNESS_SUFFIXES[] = { "metallic", "metalness", "metal" };
+
+    static bool isRoughnessMap(const std::filesystem::path& path)
+    {
+        return hasSuffix(toLower(path.stem().string()), ROUGHNESS_SUFFIXES, std::size(ROUGHNESS_SUFFIXES));
+    }
+
+    // the name without the map's own suffix, croissant_01_L0 for croissant_01_L0_Roughness.png
+    static std::string getMaterialPrefix(const std::filesystem::path& path)
+    {
+        std::string stem = path.stem().string();
+        size_t separator = stem.find_last_of('_');
+
+        return separator == std::string::npos ? stem : stem.substr(0, separator);
+    }
+
+    // where the packed texture of a roughness map lives in the source tree. it is never written there, assetbake
+    // puts the baked version at the matching place in its output
+    static std::string getPackedPath(const std::string& roughnessPath)
+    {
+        std::filesystem::path path(roughnessPath);
+        std::filesystem::path packed = path.parent_path() / (getMaterialPrefix(path) + "_" + PACKED_SUFFIX + path.extension().string());
+
+        return packed.generic_string();
+    }
+
+    // the maps sharing the roughness map's prefix, in png or jpg, names are compared without case
+    static MaterialMapSources findSources(const std::string& roughnessPath)
+    {
+        MaterialMapSources sources;
+        sources.roughness = roughnessPath;
+
+        std::filesystem::path path(roughnessPath);
+        std::string prefix = toLower(getMaterialPrefix(path)) + "_";
+
+        std::error_code error;
+        std::filesystem::directory_iterator directory(path.parent_path().empty() ? "." : path.parent_path(), error);
+
+        for (; !error && directory != std::filesystem::directory_iterator(); directory.increment(error))
+        {
+            std::string extension = toLower(directory->path().extension().string());
+            std::string stem = toLower(directory->path().stem().string());
+
+            if ((extension != ".png" && extension != ".jpg" && extension != ".jpeg") || stem.compare(0, prefix.size(), prefix) != 0 || stem.find('_', prefix.size()) != std::string::npos)
+            {
+                continue;
+            }
+
+            if (hasSuffix(stem, OCCLUSION_SUFFIXES, std::size(OCCLUSION_SUFFIXES)))
+            {
+                sources.occlusion = directory->path().generic_string();
+            }
+            else if (hasSuffix(stem, METALNESS_SUFFIXES, std::size(METALNESS_SUFFIXES)))
+            {
+                sources.metalness = directory->path().generic_string();
+            }
+        }
+
+        return sources;
+    }
+
+    static float srgbToLinear(float value)
+    {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    // RGBA8 at the roughness map's size, a map of another size is resampled to the nearest texel. roughness is
+    // linearized the way the baker stores masks, occlusion and metalness are data as is
+    static std::vector<uint8_t> pack(const MaterialMapSources& sources, uint32_t& width, uint32_t& height)
+    {
+        uint8_t toLinear[256];
+        for (int i = 0; i < 256; i++)
+        {
+            toLinear[i] = static_cast<uint8_t>(srgbToLinear(i / 255.0f) * 255.0f + 0.5f);
+        }
+
+        int roughnessWidth, roughnessHeight, channels;
+        stbi_uc* roughness = stbi_load(sources.roughness.c_str(), &roughnessWidth, &roughnessHeight, &channels, STBI_grey);
+
+        if (!roughness)
+        {
+            throw std::runtime_error("failed to load texture image " + sources.roughness);
+        }
+
+        width = static_cast<uint32_t>(roughnessWidth);
+        height = static_cast<uint32_t>(roughnessHeight);
+
+        std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+
+        for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+        {
+            pixels[i * 4 + 0] = DEFAULT_OCCLUSION;
+            pixels[i * 4 + 1] = toLinear[roughness[i]];
+            pixels[i * 4 + 2] = DEFAULT_METALNESS;
+            pixels[i * 4 + 3] = 255;
+        }
+
+        stbi_image_free(roughness);
+
+        // a map that fails to load is left at its default, the material still gets its roughness
+        auto packChannel = [&](const std::string& path, int channel)
+        {
+            int mapWidth, mapHeight, mapChannels;
+            stbi_uc* map = path.empty() ? nullptr : stbi_load(path.c_str(), &mapWidth, &mapHeight, &mapChannels, STBI_grey);
+
+            if (!map)
+            {
+                return;
+            }
+
+            for (uint32_t y = 0; y < height; y++)
+            {
+                size_t mapY = static_cast<size_t>(y) * mapHeight / height;
+
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    size_t mapX = static_cast<size_t>(x) * mapWidth / width;
+                    pixels[(static_cast<size_t>(y) * width + x) * 4 + channel] = map[mapY * mapWidth + mapX];
+                }
+            }
+
+            stbi_image_free(map);
+        };
+
+        packChannel(sources.occlusion, 0);
+        packChannel(sources.metalness, 2);
+
+        return pixels;
+    }
+};
+
+#endif // MATERIAL_PACKING_H
@@ -0,0 +1,462 @@
+#ifndef MEMORY_ALLOCATOR_H
+#define MEMORY_ALLOCATOR_H
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <stdexcept>
+
+#include "vk_mem_alloc.h"
+
+// usage classes, each one is suballocated out of its own pool of large blocks
+enum class MemoryUsage
+{
+    Staging,
+    Geometry,
+    Uniform,
+    Texture,
+    RenderTarget,
+    Count
+};
+
+const std::array<const char*, static_cast<size_t>(MemoryUsage::Count)> MEMORY_USAGE_NAMES =
+{
+    "staging",
+    "geometry",
+    "uniform",
+    "texture",
+    "renderTarget"
+};
+
+struct MemoryCategoryStats
+{
+    VkDeviceSize liveBytes = 0;
+    VkDeviceSize peakBytes = 0;
+    uint32_t allocationCount = 0;
+};
+
+class MemoryAllocator
+{
+public:
+    MemoryAllocator(VkInstance& instance, VkPhysicalDevice& physicalDevice, VkDevice& device, bool memoryBudgetEnabled);
+    void destroyAllocator();
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage, VkBuffer& buffer, VmaAllocation& allocation, void** mappedData = nullptr);
+    void createImage(const VkImageCreateInfo& imageInfo, MemoryUsage memoryUsage, VkImage& image, VmaAllocation& allocation);
+    void destroyBuffer(VkBuffer buffer, VmaAllocation allocation);
+    void destroyImage(VkImage image, VmaAllocation allocation);
+
+    void allocateMemory(const VkMemoryRequirements& requirements, MemoryUsage memoryUsage, bool lazilyAllocated, VmaAllocation& allocation, VmaAllocationInfo& allocationInfo);
+    void bindImageMemory(VmaAllocation allocation, VkImage image);
+    void freeMemory(VmaAllocation allocation);
+
+    MemoryCategoryStats getCategoryStats(MemoryUsage memoryUsage);
+    std::vector<VmaBudget> getHeapBudgets();
+    std::string getMemoryReport();
+    // best effort, a report that cannot be written is logged and false is returned
+    bool writeMemoryReport(const std::string& path);
+
+    VmaAllocator allocator = VK_NULL_HANDLE;
+
+private:
+    void createPools();
+    VmaAllocationCreateInfo getAllocationCreateInfo(MemoryUsage memoryUsage);
+
+    void trackAllocation(VmaAllocation allocation, MemoryUsage memoryUsage);
+    void untrackAllocation(VmaAllocation allocation);
+
+    std::array<VmaPool, static_cast<size_t>(MemoryUsage::Count)> pools{};
+
+    std::array<MemoryCategoryStats, static_cast<size_t>(MemoryUsage::Count)> categoryStats{};
+    std::unordered_map<VmaAllocation, MemoryUsage> allocationUsages;
+
+    bool memoryBudgetEnabled = false; // without VK_EXT_memory_budget VMA estimates the budget from heap sizes
+};
+
+// block size of each pool, resources are packed into blocks of this size instead of getting their own vkAllocateMemory
+const std::array<VkDeviceSize, static_cast<size_t>(MemoryUsage::Count)> POOL_BLOCK_SIZES =
+{
+    32ull * 1024 * 1024,  // staging
+    64ull * 1024 * 1024,  // geometry
+    4ull * 1024 * 1024,   // uniform
+    128ull * 1024 * 1024, // texture
+    64ull * 1024 * 1024   // render target
+};
+
+MemoryAllocator::MemoryAllocator(VkInstance& instance, VkPhysicalDevice& physicalDevice, VkDevice& device, bool memoryBudgetEnabled)
+{
+    this->memoryBudgetEnabled = memoryBudgetEnabled;
+
+    VmaVulkanFunctions vulkanFunctions{};
+    vulkanFunctions.vkGetInstanceProcAddr = &vkGetInstanceProcAddr;
+    vulkanFunctions.vkGetDeviceProcAddr = &vkGetDeviceProcAddr;
+
+    VmaAllocatorCreateInfo allocatorInfo{};
+    allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_0;
+    allocatorInfo.instance = instance;
+    allocatorInfo.physicalDevice = physicalDevice;
+    allocatorInfo.device = device;
+    allocatorInfo.pVulkanFunctions = &vulkanFunctions;
+
+    if (memoryBudgetEnabled)
+    {
+        allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
+
+    if (vmaCreateAllocator(&allocatorInfo, &allocator) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create memory allocator");
+    }
+
+    createPools();
+}
+
+void MemoryAllocator::destroyAllocator()
+{
+    for (VmaPool pool : pools)
+    {
+        if (pool != VK_NULL_HANDLE)
+        {
+            vmaDestroyPool(allocator, pool);
+        }
+    }
+
+    vmaDestroyAllocator(allocator);
+}
+
+void MemoryAllocator::createPools()
+{
+    // representative resources used to pick the memory type of each pool
+    VkBufferCreateInfo stagingInfo{};
+    stagingInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    stagingInfo.size = 0x10000;
+    stagingInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    stagingInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBufferCreateInfo geometryInfo = stagingInfo;
+    geometryInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+    VkBufferCreateInfo uniformInfo = stagingInfo;
+    uniformInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+
+    VkImageCreateInfo textureInfo{};
+    textureInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    textureInfo.imageType = VK_IMAGE_TYPE_2D;
+    textureInfo.extent = { 256, 256, 1 };
+    textureInfo.mipLevels = 1;
+    textureInfo.arrayLayers = 1;
+    textureInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    textureInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    textureInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    textureInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    textureInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    textureInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkImageCreateInfo renderTargetInfo = textureInfo;
+    renderTargetInfo.format = VK_FORMAT_B8G8R8A8_SRGB;
+    renderTargetInfo.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+    for (size_t i = 0; i < pools.size(); i++)
+    {
+        MemoryUsage memoryUsage = static_cast<MemoryUsage>(i);
+        VmaAllocationCreateInfo allocInfo = getAllocationCreateInfo(memoryUsage);
+
+        uint32_t memoryTypeIndex = 0;
+        VkResult result = VK_SUCCESS;
+
+        switch (memoryUsage)
+        {
+        case MemoryUsage::Staging:
+            result = vmaFindMemoryTypeIndexForBufferInfo(allocator, &stagingInfo, &allocInfo, &memoryTypeIndex);
+            break;
+        case MemoryUsage::Geometry:
+            result = vmaFindMemoryTypeIndexForBufferInfo(allocator, &geometryInfo, &allocInfo, &memoryTypeIndex);
+            break;
+        case MemoryUsage::Uniform:
+            result = vmaFindMemoryTypeIndexForBufferInfo(allocator, &uniformInfo, &allocInfo, &memoryTypeIndex);
+            break;
+        case MemoryUsage::Texture:
+            result = vmaFindMemoryTypeIndexForImageInfo(allocator, &textureInfo, &allocInfo, &memoryTypeIndex);
+            break;
+        default:
+            result = vmaFindMemoryTypeIndexForImageInfo(allocator, &renderTargetInfo, &allocInfo, &memoryTypeIndex);
+            break;
+        }
+
+        if (result != VK_SUCCESS)
+        {
+            continue; // no pool for this class, allocations fall back to the default pools
+        }
+
+        VmaPoolCreateInfo poolInfo{};
+        poolInfo.memoryTypeIndex = memoryTypeIndex;
+        poolInfo.blockSize = POOL_BLOCK_SIZES[i];
+
+        if (vmaCreatePool(allocator, &poolInfo, &pools[i]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create memory pool");
+        }
+    }
+}
+
+VmaAllocationCreateInfo MemoryAllocator::getAllocationCreateInfo(MemoryUsage memoryUsage)
+{
+    VmaAllocationCreateInfo allocInfo{};
+
+    switch (memoryUsage)
+    {
+    case MemoryUsage::Staging:
+    case MemoryUsage::Uniform:
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+        allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT; // written through persistent mappings without flushes
+        break;
+    default:
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+        break;
+    }
+
+    return allocInfo;
+}
+
+void MemoryAllocator::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage, VkBuffer& buffer, VmaAllocation& allocation, void** mappedData)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo = getAllocationCreateInfo(memoryUsage);
+    allocInfo.pool = pools[static_cast<size_t>(memoryUsage)];
+
+    VmaAllocationInfo allocationInfo{};
+    VkResult result = vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer, &allocation, &allocationInfo);
+
+    if (result != VK_SUCCESS && allocInfo.pool != VK_NULL_HANDLE)
+    {
+        // the pool's memory type may not be compatible with this buffer, let VMA pick one
+        allocInfo.pool = VK_NULL_HANDLE;
+        result = vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer, &allocation, &allocationInfo);
+    }
+
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate buffer memory");
+    }
+
+    if (mappedData != nullptr)
+    {
+        *mappedData = allocationInfo.pMappedData;
+    }
+
+    trackAllocation(allocation, memoryUsage);
+}
+
+void MemoryAllocator::createImage(const VkImageCreateInfo& imageInfo, MemoryUsage memoryUsage, VkImage& image, VmaAllocation& allocation)
+{
+    VmaAllocationCreateInfo allocInfo = getAllocationCreateInfo(memoryUsage);
+    allocInfo.pool = pools[static_cast<size_t>(memoryUsage)];
+
+    VkResult result = vmaCreateImage(allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr);
+
+    if (result != VK_SUCCESS && allocInfo.pool != VK_NULL_HANDLE)
+    {
+        allocInfo.pool = VK_NULL_HANDLE;
+        result = vmaCreateImage(allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr);
+    }
+
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate image memory");
+    }
+
+    trackAllocation(allocation, memoryUsage);
+}
+
+void MemoryAllocator::destroyBuffer(VkBuffer buffer, VmaAllocation allocation)
+{
+    untrackAllocation(allocation);
+    vmaDestroyBuffer(allocator, buffer, allocation);
+}
+
+void MemoryAllocator::destroyImage(VkImage image, VmaAllocation allocation)
+{
+    untrackAllocation(allocation);
+    vmaDestroyImage(allocator, image, allocation);
+}
+
+// raw memory that images are bound to later, lazilyAllocated asks for memory that is only committed if a transient attachment needs it
+void MemoryAllocator::allocateMemory(const VkMemoryRequirements& requirements, MemoryUsage memoryUsage, bool lazilyAllocated, VmaAllocation& allocation, VmaAllocationInfo& allocationInfo)
+{
+    VkResult result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+    if (lazilyAllocated)
+    {
+        VmaAllocationCreateInfo lazyInfo{};
+        lazyInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+
+        result = vmaAllocateMemory(allocator, &requirements, &lazyInfo, &allocation, &allocationInfo);
+    }
+
+    VmaAllocationCreateInfo allocInfo = getAllocationCreateInfo(memoryUsage);
+    allocInfo.pool = pools[static_cast<size_t>(memoryUsage)];
+
+    if (result != VK_SUCCESS)
+    {
+        result = vmaAllocateMemory(allocator, &requirements, &allocInfo, &allocation, &allocationInfo);
+    }
+
+    if (result != VK_SUCCESS && allocInfo.pool != VK_NULL_HANDLE)
+    {
+        allocInfo.pool = VK_NULL_HANDLE;
+        result = vmaAllocateMemory(allocator, &requirements, &allocInfo, &allocation, &allocationInfo);
+    }
+
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate memory");
+    }
+
+    trackAllocation(allocation, memoryUsage);
+}
+
+void MemoryAllocator::bindImageMemory(VmaAllocation allocation, VkImage image)
+{
+    if (vmaBindImageMemory(allocator, allocation, image) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to bind image memory");
+    }
+}
+
+void MemoryAllocator::freeMemory(VmaAllocation allocation)
+{
+    untrackAllocation(allocation);
+    vmaFreeMemory(allocator, allocation);
+}
+
+void MemoryAllocator::trackAllocation(VmaAllocation allocation, MemoryUsage memoryUsage)
+{
+    VmaAllocationInfo allocationInfo{};
+    vmaGetAllocationInfo(allocator, allocation, &allocationInfo);
+
+    MemoryCategoryStats& stats = categoryStats[static_cast<size_t>(memoryUsage)];
+    stats.liveBytes += allocationInfo.size;
+    stats.peakBytes = std::max(stats.peakBytes, stats.liveBytes);
+    stats.allocationCount++;
+
+    allocationUsages[allocation] = memoryUsage;
+}
+
+void MemoryAllocator::untrackAllocation(VmaAllocation allocation)
+{
+    auto it = allocationUsages.find(allocation);
+    if (it == allocationUsages.end())
+    {
+        return;
+    }
+
+    VmaAllocationInfo allocationInfo{};
+    vmaGetAllocationInfo(allocator, allocation, &allocationInfo);
+
+    MemoryCategoryStats& stats = categoryStats[static_cast<size_t>(it->second)];
+    stats.liveBytes -= allocationInfo.size;
+    stats.allocationCount--;
+
+    allocationUsages.erase(it);
+}
+
+MemoryCategoryStats MemoryAllocator::getCategoryStats(MemoryUsage memoryUsage)
+{
+    return categoryStats[static_cast<size_t>(memoryUsage)];
+}
+
+// usage and budget of every memory heap, as reported by VK_EXT_memory_budget when it is enabled
+std::vector<VmaBudget> MemoryAllocator::getHeapBudgets()
+{
+    const VkPhysicalDeviceMemoryProperties* memoryProperties;
+    vmaGetMemoryProperties(allocator, &memoryProperties);
+
+    std::vector<VmaBudget> budgets(memoryProperties->memoryHeapCount);
+    vmaGetHeapBudgets(allocator, budgets.data());
+
+    return budgets;
+}
+
+std::string MemoryAllocator::getMemoryReport()
+{
+    const VkPhysicalDeviceMemoryProperties* memoryProperties;
+    vmaGetMemoryProperties(allocator, &memoryProperties);
+
+    std::vector<VmaBudget> budgets = getHeapBudgets();
+
+    std::ostringstream report;
+    report << "{\n";
+    report << "  \"memoryBudgetExtension\": " << (memoryBudgetEnabled ? "true" : "false") << ",\n";
+
+    report << "  \"categories\": {\n";
+    for (size_t i = 0; i < categoryStats.size(); i++)
+    {
+        const MemoryCategoryStats& stats = categoryStats[i];
+
+        report << "    \"" << MEMORY_USAGE_NAMES[i] << "\": { "
+            << "\"liveBytes\": " << stats.liveBytes << ", "
+            << "\"peakBytes\": " << stats.peakBytes << ", "
+            << "\"allocations\": " << stats.allocationCount << " }"
+            << (i + 1 < categoryStats.size() ? "," : "") << "\n";
+    }
+    report << "  },\n";
+
+    report << "  \"heaps\": [\n";
+    for (size_t i = 0; i < budgets.size(); i++)
+    {
+        const VmaBudget& budget = budgets[i];
+        bool deviceLocal = memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+
+        report << "    { "
+            << "\"index\": " << i << ", "
+            << "\"deviceLocal\": " << (deviceLocal ? "true" : "false") << ", "
+            << "\"size\": " << memoryProperties->memoryHeaps[i].size << ", "
+            << "\"usage\": " << budget.usage << ", "
+            << "\"budget\": " << budget.budget << ", "
+            << "\"blockBytes\": " << budget.statistics.blockBytes << ", "
+            << "\"allocationBytes\": " << budget.statistics.allocationBytes << ", "
+            << "\"overBudget\": " << (budget.usage > budget.budget ? "true" : "false") << " }"
+            << (i + 1 < budgets.size() ? "," : "") << "\n";
+    }
+    report << "  ]\n";
+    report << "}\n";
+
+    return report.str();
+}
+
+bool MemoryAllocator::writeMemoryReport(const std::string& path)
+{
+    std::ofstream file(path, std::ios::trunc);
+
+    if (!file.is_open())
+    {
+        std::cerr << "failed to open memory report file " << path << std::endl;
+        return false;
+    }
+
+    file << getMemoryReport();
+
+    if (!file)
+    {
+        std::cerr << "failed to write memory report file " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+#endif // MEMORY_ALLOCATOR_H
@@ -0,0 +1,564 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+#include "VertexEncoding.h"
+#include "MappedFile.h"
+#include "Submesh.h"
+
+// a mesh in the layout the geometry arena stores along with everything drawing it needs. the arrays point into
+// whatever produced them, a mapped cache file or the scratch memory of an import
+struct EncodedMesh
+{
+    VertexFormat vertexFormat = VertexFormat::Full;
+    const void* vertexData = nullptr;
+    size_t vertexCount = 0;
+
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    const void* indexData = nullptr;
+    size_t indexCount = 0;
+
+    std::vector<Submesh> submeshes;
+    std::vector<MeshLod> lods;
+    std::vector<MeshMaterial> materials;
+    std::vector<float> materialUvDensity; // indexed like materials
+
+    // other files the mesh was built from, the .mtl files its mtllib lines name
+    std::vector<std::string> dependencies;
+
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    VertexTransform vertexTransform;
+};
+
+// header of a .meshcache or baked .mesh file. the vertex and index arrays follow at aligned offsets in exactly the
+// layout the geometry arena expects, so a mapped cache is copied into staging memory without any decoding. the
+// submesh table, the lod table, the material records, the dependencies and the strings they point into come after them
+struct MeshCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+
+    // what the cache was built from
+    uint64_t pathHash;
+    uint64_t sourceSize;
+    int64_t sourceModified;
+    uint64_t sourceHash;
+
+    uint32_t vertexFormat;
+    uint32_t vertexStride;
+    uint32_t indexSize;
+
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+
+    uint64_t submeshCount;
+    uint64_t lodCount;
+    uint64_t materialCount;
+    uint64_t dependencyCount;
+    uint64_t stringSize;
+    uint64_t submeshOffset;
+    uint64_t lodOffset;
+    uint64_t materialOffset;
+    uint64_t dependencyOffset;
+    uint64_t stringOffset;
+
+    float boundsMin[3];
+    float boundsMax[3];
+
+    float positionTransform[4];
+    float texCoordTransform[4];
+};
+
+// a MeshMaterial with its strings stored as offset and size into the string block
+struct MeshCacheMaterial
+{
+    uint32_t nameOffset;
+    uint32_t nameSize;
+    uint32_t baseColorOffset;
+    uint32_t baseColorSize;
+    uint32_t roughnessOffset;
+    uint32_t roughnessSize;
+    float uvDensity;
+};
+
+// a file the mesh was built from and its size and timestamp at the time, both 0 when it did not exist
+struct MeshCacheDependency
+{
+    uint32_t pathOffset;
+    uint32_t pathSize;
+    uint64_t size;
+    int64_t modified;
+};
+
+// a validated, mapped cache file. the pointers stay valid as long as the view is alive
+struct MeshCacheView
+{
+    std::unique_ptr<MappedFile> file;
+
+    const MeshCacheHeader* header = nullptr;
+    const void* vertices = nullptr; // in header->vertexFormat
+    const void* indices = nullptr; // header->indexSize bytes each
+    const Submesh* submeshes = nullptr;
+    const MeshLod* lods = nullptr;
+    const MeshCacheMaterial* materials = nullptr;
+    const MeshCacheDependency* dependencies = nullptr;
+    const char* strings = nullptr;
+};
+
+namespace MeshCache
+{
+    const uint32_t MESH_CACHE_MAGIC = 0x434D5256; // "VRMC"
+    const uint32_t MESH_CACHE_VERSION = 5; // bump whenever the loader's output changes
+    const uint64_t MESH_CACHE_ALIGNMENT = 64;
+
+    static std::string getCachePath(const std::string& sourcePath)
+    {
+        return sourcePath + ".meshcache";
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+    }
+
+    static uint64_t hashBytes(const char* data, size_t size)
+    {
+        uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+
+        size_t words = size / 8;
+        for (size_t i = 0; i < words; i++)
+        {
+            uint64_t word;
+            memcpy(&word, data + i * 8, 8);
+
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+            hash ^= hash >> 29;
+        }
+
+        for (size_t i = words * 8; i < size; i++)
+        {
+            hash = (hash ^ static_cast<uint8_t>(data[i])) * 0xFF51AFD7ED558CCDull;
+        }
+
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB9FE1A85EC53ull;
+        hash ^= hash >> 33;
+
+        return hash;
+    }
+
+    static uint64_t hashFile(const std::string& path)
+    {
+        MappedFile file(path);
+        return hashBytes(file.data, file.size);
+    }
+
+    static int64_t getModifiedTime(const std::string& path)
+    {
+        return static_cast<int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+    }
+
+    // size and timestamp of a file, both 0 when it does not exist
+    static void getFileStamp(const std::string& path, uint64_t& size, int64_t& modified)
+    {
+        std::error_code error;
+        size = 0;
+        modified = 0;
+
+        if (std::filesystem::is_regular_file(path, error))
+        {
+            size = std::filesystem::file_size(path);
+            modified = getModifiedTime(path);
+        }
+    }
+
+    static void computeBounds(const Vertex* vertices, size_t vertexCount, glm::vec3& boundsMin, glm::vec3& boundsMax)
+    {
+        boundsMin = vertexCount ? vertices[0].pos : glm::vec3(0.0f);
+        boundsMax = boundsMin;
+
+        for (size_t i = 1; i < vertexCount; i++)
+        {
+            boundsMin = glm::min(boundsMin, vertices[i].pos);
+            boundsMax = glm::max(boundsMax, vertices[i].pos);
+        }
+    }
+
+    // the arrays are read in place, so they also have to sit where the writer puts them
+    static bool isArrayInFile(uint64_t offset, uint64_t count, uint64_t elementSize, const MappedFile& file)
+    {
+        return offset % MESH_CACHE_ALIGNMENT == 0 && file.contains(offset, count, elementSize);
+    }
+
+    template <typename Index>
+    static bool areIndicesInRange(const Index* indices, uint64_t indexCount, uint64_t vertexCount)
+    {
+        for (uint64_t i = 0; i < indexCount; i++)
+        {
+            if (indices[i] >= vertexCount)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // maps a cache file and checks it is one this build can use as is. baked meshes are opened with this alone,
+    // they ship without their source
+    static bool openFile(const std::string& path, MeshCacheView& view)
+    {
+        std::error_code error;
+        if (!std::filesystem::exists(path, error))
+        {
+            return false;
+        }
+
+        try
+        {
+            view.file = std::make_unique<MappedFile>(path);
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+
+        const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(view.file->data);
+
+        bool valid = view.file->size >= sizeof(MeshCacheHeader)
+            && header->magic == MESH_CACHE_MAGIC
+            && header->version == MESH_CACHE_VERSION
+            && header->vertexFormat <= static_cast<uint32_t>(VertexFormat::Half)
+            && header->vertexStride == VertexEncoding::getVertexStride(static_cast<VertexFormat>(header->vertexFormat))
+            && (header->indexSize == sizeof(uint16_t) || header->indexSize == sizeof(uint32_t))
+            && isArrayInFile(header->vertexOffset, header->vertexCount, header->vertexStride, *view.file)
+            && isArrayInFile(header->indexOffset, header->indexCount, header->indexSize, *view.file)
+            && isArrayInFile(header->submeshOffset, header->submeshCount, sizeof(Submesh), *view.file)
+            && header->lodCount > 0
+            && isArrayInFile(header->lodOffset, header->lodCount, sizeof(MeshLod), *view.file)
+            && isArrayInFile(header->materialOffset, header->materialCount, sizeof(MeshCacheMaterial), *view.file)
+            && isArrayInFile(header->dependencyOffset, header->dependencyCount, sizeof(MeshCacheDependency), *view.file)
+            && view.file->contains(header->stringOffset, header->stringSize, 1);
+
+        if (!valid)
+        {
+            view = MeshCacheView{};
+            return false;
+        }
+
+        view.header = header;
+        view.vertices = view.file->data + header->vertexOffset;
+        view.indices = view.file->data + header->indexOffset;
+        view.submeshes = reinterpret_cast<const Submesh*>(view.file->data + header->submeshOffset);
+        view.lods = reinterpret_cast<const MeshLod*>(view.file->data + header->lodOffset);
+        view.materials = reinterpret_cast<const MeshCacheMaterial*>(view.file->data + header->materialOffset);
+        view.dependencies = reinterpret_cast<const MeshCacheDependency*>(view.file->data + header->dependencyOffset);
+        view.strings = view.file->data + header->stringOffset;
+
+        // the indices go to the gpu as they are, one past the vertices would have it read outside the mesh
+        bool indicesValid = header->indexSize == sizeof(uint16_t)
+            ? areIndicesInRange(static_cast<const uint16_t*>(view.indices), header->indexCount, header->vertexCount)
+            : areIndicesInRange(static_cast<const uint32_t*>(view.indices), header->indexCount, header->vertexCount);
+
+        if (!indicesValid)
+        {
+            view = MeshCacheView{};
+            return false;
+        }
+
+        // the ranges are used for draws as they are, one outside the index array or the material table would be read past
+        for (uint64_t i = 0; i < header->submeshCount; i++)
+        {
+            const Submesh& submesh = view.submeshes[i];
+
+            if (static_cast<uint64_t>(submesh.firstIndex) + submesh.indexCount > header->indexCount || submesh.materialIndex >= header->materialCount)
+            {
+                view = MeshCacheView{};
+                return false;
+            }
+        }
+
+        for (uint64_t i = 0; i < header->lodCount; i++)
+        {
+            const MeshLod& lod = view.lods[i];
+
+            if (static_cast<uint64_t>(lod.firstSubmesh) + lod.submeshCount > header->submeshCount)
+            {
+                view = MeshCacheView{};
+                return false;
+            }
+        }
+
+        for (uint64_t i = 0; i < header->materialCount; i++)
+        {
+            const MeshCacheMaterial& material = view.materials[i];
+
+            if (static_cast<uint64_t>(material.nameOffset) + material.nameSize > header->stringSize
+                || static_cast<uint64_t>(material.baseColorOffset) + material.baseColorSize > header->stringSize
+                || static_cast<uint64_t>(material.roughnessOffset) + material.roughnessSize > header->stringSize)
+            {
+                view = MeshCacheView{};
+                return false;
+            }
+        }
+
+        for (uint64_t i = 0; i < header->dependencyCount; i++)
+        {
+            const MeshCacheDependency& dependency = view.dependencies[i];
+
+            if (static_cast<uint64_t>(dependency.pathOffset) + dependency.pathSize > header->stringSize)
+            {
+                view = MeshCacheView{};
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static std::string readString(const MeshCacheView& view, uint32_t offset, uint32_t size)
+    {
+        return std::string(view.strings + offset, size);
+    }
+
+    // everything but the arrays is copied out, those keep pointing into the mapped file
+    static void readMesh(const MeshCacheView& view, EncodedMesh& mesh)
+    {
+        const MeshCacheHeader* header = view.header;
+
+        mesh.vertexFormat = static_cast<VertexFormat>(header->vertexFormat);
+        mesh.vertexData = view.vertices;
+        mesh.vertexCount = static_cast<size_t>(header->vertexCount);
+
+        mesh.indexType = header->indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+        mesh.indexData = view.indices;
+        mesh.indexCount = static_cast<size_t>(header->indexCount);
+
+        mesh.submeshes.assign(view.submeshes, view.submeshes + header->submeshCount);
+        mesh.lods.assign(view.lods, view.lods + header->lodCount);
+
+        mesh.materials.clear();
+        mesh.materialUvDensity.clear();
+
+        for (uint64_t i = 0; i < header->materialCount; i++)
+        {
+            const MeshCacheMaterial& material = view.materials[i];
+
+            mesh.materials.push_back(
+            {
+                readString(view, material.nameOffset, material.nameSize),
+                readString(view, material.baseColorOffset, material.baseColorSize),
+                readString(view, material.roughnessOffset, material.roughnessSize)
+            });
+            mesh.materialUvDensity.push_back(material.uvDensity);
+        }
+
+        mesh.dependencies.clear();
+
+        for (uint64_t i = 0; i < header->dependencyCount; i++)
+        {
+            mesh.dependencies.push_back(readString(view, view.dependencies[i].pathOffset, view.dependencies[i].pathSize));
+        }
+
+        mesh.boundsMin = glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+        mesh.boundsMax = glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]);
+
+        memcpy(&mesh.vertexTransform.position, header->positionTransform, sizeof(header->positionTransform));
+        memcpy(&mesh.vertexTransform.texCoord, header->texCoordTransform, sizeof(header->texCoordTransform));
+    }
+
+    // maps the cache of sourcePath and checks it still describes that file and its .mtl files and is in vertexFormat.
+    // a source whose timestamp changed but whose contents did not (a fresh checkout, a copy) is caught by the
+    // content hash and keeps its cache
+    static bool open(const std::string& sourcePath, VertexFormat vertexFormat, MeshCacheView& view)
+    {
+        if (!openFile(getCachePath(sourcePath), view))
+        {
+            return false;
+        }
+
+        const MeshCacheHeader* header = view.header;
+        bool valid = false;
+
+        // a missing or unreadable source just means the cache is not used
+        try
+        {
+            valid = header->vertexFormat == static_cast<uint32_t>(vertexFormat)
+                && header->pathHash == hashBytes(sourcePath.data(), sourcePath.size())
+                && header->sourceSize == std::filesystem::file_size(sourcePath);
+
+            if (valid && header->sourceModified != getModifiedTime(sourcePath))
+            {
+                valid = header->sourceHash == hashFile(sourcePath);
+            }
+
+            // the .mtl files only go by size and timestamp, they are small enough that a needless reparse is cheap
+            for (uint64_t i = 0; valid && i < header->dependencyCount; i++)
+            {
+                const MeshCacheDependency& dependency = view.dependencies[i];
+
+                uint64_t size;
+                int64_t modified;
+                getFileStamp(readString(view, dependency.pathOffset, dependency.pathSize), size, modified);
+
+                valid = size == dependency.size && modified == dependency.modified;
+            }
+        }
+        catch (const std::exception&)
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            view = MeshCacheView{};
+        }
+
+        return valid;
+    }
+
+    // writes through a temporary file so a crash never leaves a half written cache behind, returns false on failure
+    static bool writeFile(const std::string& path, const std::string& sourcePath, const EncodedMesh& mesh)
+    {
+        std::string strings;
+        std::vector<MeshCacheMaterial> materialRecords;
+        std::vector<MeshCacheDependency> dependencyRecords;
+
+        auto addString = [&](const std::string& value, uint32_t& offset, uint32_t& size)
+        {
+            offset = static_cast<uint32_t>(strings.size());
+            size = static_cast<uint32_t>(value.size());
+            strings += value;
+        };
+
+        for (size_t i = 0; i < mesh.materials.size(); i++)
+        {
+            const MeshMaterial& material = mesh.materials[i];
+
+            MeshCacheMaterial record{};
+            addString(material.name, record.nameOffset, record.nameSize);
+            addString(material.baseColorPath, record.baseColorOffset, record.baseColorSize);
+            addString(material.roughnessPath, record.roughnessOffset, record.roughnessSize);
+            record.uvDensity = i < mesh.materialUvDensity.size() ? mesh.materialUvDensity[i] : 1.0f;
+
+            materialRecords.push_back(record);
+        }
+
+        for (const std::string& dependency : mesh.dependencies)
+        {
+            MeshCacheDependency record{};
+            addString(dependency, record.pathOffset, record.pathSize);
+            getFileStamp(dependency, record.size, record.modified);
+
+            dependencyRecords.push_back(record);
+        }
+
+        MeshCacheHeader header{};
+        header.magic = MESH_CACHE_MAGIC;
+        header.version = MESH_CACHE_VERSION;
+        header.pathHash = hashBytes(sourcePath.data(), sourcePath.size());
+        header.sourceSize = std::filesystem::file_size(sourcePath);
+        header.sourceModified = getModifiedTime(sourcePath);
+        header.sourceHash = hashFile(sourcePath);
+        header.vertexFormat = static_cast<uint32_t>(mesh.vertexFormat);
+        header.vertexStride = VertexEncoding::getVertexStride(mesh.vertexFormat);
+        header.indexSize = VertexEncoding::getIndexSize(mesh.indexType);
+        header.vertexCount = mesh.vertexCount;
+        header.indexCount = mesh.indexCount;
+        header.submeshCount = mesh.submeshes.size();
+        header.lodCount = mesh.lods.size();
+        header.materialCount = materialRecords.size();
+        header.dependencyCount = dependencyRecords.size();
+        header.stringSize = strings.size();
+
+        uint64_t vertexBytes = mesh.vertexCount * header.vertexStride;
+        uint64_t indexBytes = mesh.indexCount * header.indexSize;
+        uint64_t submeshBytes = mesh.submeshes.size() * sizeof(Submesh);
+        uint64_t lodBytes = mesh.lods.size() * sizeof(MeshLod);
+        uint64_t materialBytes = materialRecords.size() * sizeof(MeshCacheMaterial);
+        uint64_t dependencyBytes = dependencyRecords.size() * sizeof(MeshCacheDependency);
+
+        header.vertexOffset = align(sizeof(MeshCacheHeader));
+        header.indexOffset = align(header.vertexOffset + vertexBytes);
+        header.submeshOffset = align(header.indexOffset + indexBytes);
+        header.lodOffset = align(header.submeshOffset + submeshBytes);
+        header.materialOffset = align(header.lodOffset + lodBytes);
+        header.dependencyOffset = align(header.materialOffset + materialBytes);
+        header.stringOffset = align(header.dependencyOffset + dependencyBytes);
+
+        memcpy(header.boundsMin, &mesh.boundsMin, sizeof(header.boundsMin));
+        memcpy(header.boundsMax, &mesh.boundsMax, sizeof(header.boundsMax));
+        memcpy(header.positionTransform, &mesh.vertexTransform.position, sizeof(header.positionTransform));
+        memcpy(header.texCoordTransform, &mesh.vertexTransform.texCoord, sizeof(header.texCoordTransform));
+
+        std::string tempPath = path + ".tmp";
+
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+
+            if (!file)
+            {
+                return false;
+            }
+
+            const char padding[MESH_CACHE_ALIGNMENT] = {};
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(padding, header.vertexOffset - sizeof(header));
+            file.write(reinterpret_cast<const char*>(mesh.vertexData), vertexBytes);
+            file.write(padding, header.indexOffset - header.vertexOffset - vertexBytes);
+            file.write(reinterpret_cast<const char*>(mesh.indexData), indexBytes);
+            file.write(padding, header.submeshOffset - header.indexOffset - indexBytes);
+            file.write(reinterpret_cast<const char*>(mesh.submeshes.data()), submeshBytes);
+            file.write(padding, header.lodOffset - header.submeshOffset - submeshBytes);
+            file.write(reinterpret_cast<const char*>(mesh.lods.data()), lodBytes);
+            file.write(padding, header.materialOffset - header.lodOffset - lodBytes);
+            file.write(reinterpret_cast<const char*>(materialRecords.data()), materialBytes);
+            file.write(padding, header.dependencyOffset - header.materialOffset - materialBytes);
+            file.write(reinterpret_cast<const char*>(dependencyRecords.data()), dependencyBytes);
+            file.write(padding, header.stringOffset - header.dependencyOffset - dependencyBytes);
+            file.write(strings.data(), strings.size());
+
+            if (!file)
+            {
+                file.close();
+                std::remove(tempPath.c_str());
+                return false;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(tempPath, path, error);
+
+        if (error)
+        {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    // cache next to the source, failing to write it is not an error since the next launch just parses the source again
+    static void write(const std::string& sourcePath, const EncodedMesh& mesh)
+    {
+        writeFile(getCachePath(sourcePath), sourcePath, mesh);
+    }
+};
+
+#endif // MESH_CACHE_H
@@ -0,0 +1,253 @@
+#ifndef MESH_IMPORT_H
+#define MESH_IMPORT_H
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Vertex.h"
+#include "Arena.h"
+#include "ThreadPool.h"
+#include "ObjParser.h"
+#include "VertexDedup.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Submesh.h"
+#include "VertexEncoding.h"
+#include "MeshCache.h"
+
+// what an import did to the mesh, for the baker's output and the renderer's verbose output
+struct MeshImportStats
+{
+    MeshOptimizeStats vertexCache;
+    std::vector<LodStats> lods; // finest first
+};
+
+// turns a source mesh into the vertex and index arrays the renderer draws from.
+// shared by Model, when it has no valid cache, and by the offline asset baker
+namespace MeshImport
+{
+    const size_t IMPORT_EXPAND_RANGE_SIZE = 64 * 1024;
+    const char* const DEFAULT_MATERIAL_NAME = "default";
+
+    // faces without a usemtl, or naming a material the .mtl does not have, get a material of their own with no
+    // textures so every submesh has a valid material index
+    static void assignDefaultMaterial(ObjMesh& mesh)
+    {
+        uint32_t defaultMaterial = static_cast<uint32_t>(mesh.materials.size());
+        bool used = false;
+
+        for (Submesh& submesh : mesh.submeshes)
+        {
+            if (submesh.materialIndex == SUBMESH_NO_MATERIAL)
+            {
+                submesh.materialIndex = defaultMaterial;
+                used = true;
+            }
+        }
+
+        if (used)
+        {
+            mesh.materials.push_back({ DEFAULT_MATERIAL_NAME, std::string(), std::string() });
+        }
+    }
+
+    // moves the corners so the submeshes of one material are next to each other, file order is kept otherwise.
+    // runs that end up adjacent with the same material and shape become one submesh
+    static void groupByMaterial(ObjMesh& mesh)
+    {
+        std::vector<Submesh> sorted = mesh.submeshes;
+        std::stable_sort(sorted.begin(), sorted.end(), [](const Submesh& a, const Submesh& b)
+        {
+            return a.materialIndex < b.materialIndex;
+        });
+
+        std::vector<ObjIndex> indices;
+        indices.reserve(mesh.indices.size());
+        mesh.submeshes.clear();
+
+        for (const Submesh& submesh : sorted)
+        {
+            size_t begin = indices.size();
+            indices.insert(indices.end(), mesh.indices.begin() + submesh.firstIndex, mesh.indices.begin() + submesh.firstIndex + submesh.indexCount);
+
+            ObjParser::appendSubmesh(mesh.submeshes, begin, indices.size(), submesh.materialIndex, submesh.shapeIndex);
+        }
+
+        mesh.indices = std::move(indices);
+    }
+
+    // parses the obj, deduplicates its corners, reorders the result for the gpu and appends the coarser levels of
+    // detail. submesh index ranges refer to indices, lods to runs of submeshes
+    static MeshImportStats importObj(const std::string& modelPath, ThreadPool& threadPool, Arena& scratch, ArenaVector<Vertex>& vertices, ArenaVector<uint32_t>& indices,
+        std::vector<Submesh>& submeshes, std::vector<MeshMaterial>& materials, std::vector<MeshLod>& lods, std::vector<std::string>& materialFiles,
+        const LodSettings& lodSettings = LodSettings())
+    {
+        ObjMesh mesh;
+
+        if (!ObjParser::loadObj(modelPath, mesh, threadPool))
+        {
+            ObjParser::loadObjReference(modelPath, mesh);
+        }
+
+        assignDefaultMaterial(mesh);
+        groupByMaterial(mesh);
+
+        size_t cornerCount = mesh.indices.size();
+
+        // one vertex per face corner, built in parallel and then collapsed by the dedup pass
+        Vertex* corners = scratch.allocate<Vertex>(cornerCount);
+
+        threadPool.parallelFor((cornerCount + IMPORT_EXPAND_RANGE_SIZE - 1) / IMPORT_EXPAND_RANGE_SIZE, [&](size_t range)
+        {
+            size_t begin = range * IMPORT_EXPAND_RANGE_SIZE;
+            size_t end = begin + IMPORT_EXPAND_RANGE_SIZE < cornerCount ? begin + IMPORT_EXPAND_RANGE_SIZE : cornerCount;
+
+            for (size_t i = begin; i < end; i++)
+            {
+                const ObjIndex& index = mesh.indices[i];
+                Vertex& vertex = corners[i];
+
+                vertex.pos =
+                {
+                    mesh.positions[3 * index.vertexIndex + 0],
+                    mesh.positions[3 * index.vertexIndex + 1],
+                    mesh.positions[3 * index.vertexIndex + 2],
+                };
+
+                // corners without a normal or texcoord get zeros, like the ones LoadObj leaves out
+                vertex.normal = glm::vec3(0.0f);
+                vertex.texCoord = glm::vec2(0.0f, 1.0f);
+
+                if (index.normalIndex >= 0)
+                {
+                    vertex.normal =
+                    {
+                        mesh.normals[3 * index.normalIndex + 0],
+                        mesh.normals[3 * index.normalIndex + 1],
+                        mesh.normals[3 * index.normalIndex + 2],
+                    };
+                }
+
+                if (index.texcoordIndex >= 0)
+                {
+                    vertex.texCoord =
+                    {
+                        mesh.texcoords[2 * index.texcoordIndex + 0],
+                        1.0f - mesh.texcoords[2 * index.texcoordIndex + 1]
+                    };
+                }
+
+                vertex.color = { 1.0f, 1.0f, 1.0f };
+            }
+        });
+
+        VertexDedup::deduplicate(corners, cornerCount, vertices, indices, threadPool, scratch);
+
+        MeshImportStats stats;
+        stats.vertexCache = MeshOptimizer::optimize(vertices, indices, mesh.submeshes, scratch);
+
+        submeshes = std::move(mesh.submeshes);
+        materials = std::move(mesh.materials);
+        materialFiles = std::move(mesh.materialFiles);
+
+        stats.lods = MeshSimplifier::generateLods(vertices.data(), vertices.size(), indices, submeshes, lods, lodSettings, scratch);
+
+        return stats;
+    }
+
+    static std::string describe(const MeshImportStats& stats)
+    {
+        std::ostringstream text;
+        text << "vertex cache ACMR " << stats.vertexCache.before.acmr << " -> " << stats.vertexCache.after.acmr
+            << ", ATVR " << stats.vertexCache.before.atvr << " -> " << stats.vertexCache.after.atvr;
+
+        text << ", lods:";
+        for (size_t i = 0; i < stats.lods.size(); i++)
+        {
+            text << (i ? ", " : " ") << stats.lods[i].triangleCount << " triangles (error " << stats.lods[i].error << ")";
+        }
+
+        return text.str();
+    }
+
+    // how many uv units one object space unit of each material's surface spans, on average over the finest level.
+    // the square root of the ratio of uv area to surface area, a material without any area keeps 1
+    static std::vector<float> computeUvDensity(const Vertex* vertices, const uint32_t* indices, const std::vector<Submesh>& submeshes, const MeshLod& lod, size_t materialCount)
+    {
+        std::vector<double> uvArea(materialCount, 0.0);
+        std::vector<double> surfaceArea(materialCount, 0.0);
+
+        for (uint32_t i = 0; i < lod.submeshCount; i++)
+        {
+            const Submesh& submesh = submeshes[lod.firstSubmesh + i];
+
+            if (submesh.materialIndex >= materialCount)
+            {
+                continue;
+            }
+
+            for (uint32_t index = submesh.firstIndex; index + 2 < submesh.firstIndex + submesh.indexCount; index += 3)
+            {
+                const Vertex& a = vertices[indices[index]];
+                const Vertex& b = vertices[indices[index + 1]];
+                const Vertex& c = vertices[indices[index + 2]];
+
+                glm::vec2 uvEdge0 = b.texCoord - a.texCoord;
+                glm::vec2 uvEdge1 = c.texCoord - a.texCoord;
+
+                uvArea[submesh.materialIndex] += std::abs(uvEdge0.x * uvEdge1.y - uvEdge0.y * uvEdge1.x) * 0.5;
+                surfaceArea[submesh.materialIndex] += glm::length(glm::cross(b.pos - a.pos, c.pos - a.pos)) * 0.5;
+            }
+        }
+
+        std::vector<float> density(materialCount, 1.0f);
+
+        for (size_t i = 0; i < materialCount; i++)
+        {
+            if (uvArea[i] > 0.0 && surfaceArea[i] > 0.0)
+            {
+                density[i] = static_cast<float>(std::sqrt(uvArea[i] / surfaceArea[i]));
+            }
+        }
+
+        return density;
+    }
+
+    // fills in the arrays of mesh in the arena's layout, along with the bounds, the transform that undoes the
+    // encoding and the uv densities. submeshes, lods and materials have to be set already. the compact formats and
+    // 16 bit indices are encoded into scratch, whatever is stored as is keeps pointing at vertices and indices
+    static void encode(VertexFormat format, const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+        EncodedMesh& mesh, Arena& scratch, ThreadPool& threadPool)
+    {
+        MeshCache::computeBounds(vertices, vertexCount, mesh.boundsMin, mesh.boundsMax);
+        mesh.materialUvDensity = computeUvDensity(vertices, indices, mesh.submeshes, mesh.lods[0], mesh.materials.size());
+
+        mesh.vertexFormat = format;
+        mesh.vertexTransform = VertexEncoding::computeTransform(format, vertices, vertexCount, mesh.boundsMin, mesh.boundsMax);
+        mesh.vertexCount = vertexCount;
+        mesh.vertexData = vertices;
+
+        if (format != VertexFormat::Full)
+        {
+            CompactVertex* encoded = scratch.allocate<CompactVertex>(vertexCount);
+            VertexEncoding::encodeVertices(format, vertices, vertexCount, mesh.vertexTransform, encoded, threadPool);
+            mesh.vertexData = encoded;
+        }
+
+        mesh.indexType = VertexEncoding::selectIndexType(vertexCount);
+        mesh.indexCount = indexCount;
+        mesh.indexData = indices;
+
+        if (mesh.indexType == VK_INDEX_TYPE_UINT16)
+        {
+            uint16_t* narrowed = scratch.allocate<uint16_t>(indexCount);
+            VertexEncoding::encodeIndices16(indices, indexCount, narrowed);
+            mesh.indexData = narrowed;
+        }
+    }
+};
+
+#endif // MESH_IMPORT_H
@@ -0,0 +1,497 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+#include "Arena.h"
+#include "Submesh.h"
+
+// average cache miss ratio per triangle and per vertex of an index buffer, 0.5 and 1.0 are the best possible
+struct VertexCacheStats
+{
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+struct MeshOptimizeStats
+{
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// reorders a deduplicated mesh for the gpu: triangles for the post-transform vertex cache (tipsify), clusters of
+// those triangles so outward facing ones tend to draw first (sander et al.'s view independent overdraw ordering),
+// and finally vertices in the order they are first used so fetches walk the vertex buffer front to back.
+// triangles never move between submeshes, every submesh is drawn on its own
+namespace MeshOptimizer
+{
+    const uint32_t VERTEX_CACHE_SIZE = 16;
+    const float OVERDRAW_THRESHOLD = 1.05f; // how much worse than tipsify a cluster's ACMR may get when splitting it
+
+    const uint32_t OPTIMIZE_INVALID = UINT32_MAX;
+
+    // the per submesh passes draw from their own arena, reset after every submesh, so a mesh with many submeshes
+    // only ever holds the scratch of its largest one
+    const size_t OPTIMIZE_SCRATCH_BLOCK_SIZE = 4 * 1024 * 1024;
+
+    // fifo cache simulation. a vertex is cached while fewer than cacheSize misses happened since it was loaded
+    static VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize, Arena& scratch)
+    {
+        VertexCacheStats stats;
+
+        if (indexCount == 0 || vertexCount == 0)
+        {
+            return stats;
+        }
+
+        uint32_t* timestamps = scratch.allocate<uint32_t>(vertexCount);
+        memset(timestamps, 0, sizeof(uint32_t) * vertexCount);
+
+        uint32_t time = cacheSize + 1;
+        size_t misses = 0;
+
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            uint32_t vertex = indices[i];
+
+            if (time - timestamps[vertex] > cacheSize)
+            {
+                timestamps[vertex] = time++;
+                misses++;
+            }
+        }
+
+        stats.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+        stats.atvr = static_cast<float>(misses) / static_cast<float>(vertexCount);
+
+        return stats;
+    }
+
+    // next vertex to fan around once the current one has no triangles left. recently touched vertices come first,
+    // then the lowest vertex that still has triangles
+    static uint32_t skipDeadEnd(const uint32_t* live, uint32_t* deadEnd, size_t& deadEndSize, size_t vertexCount, size_t& cursor)
+    {
+        while (deadEndSize > 0)
+        {
+            uint32_t vertex = deadEnd[--deadEndSize];
+
+            if (live[vertex] > 0)
+            {
+                return vertex;
+            }
+        }
+
+        for (; cursor < vertexCount; cursor++)
+        {
+            if (live[cursor] > 0)
+            {
+                return static_cast<uint32_t>(cursor);
+            }
+        }
+
+        return OPTIMIZE_INVALID;
+    }
+
+    // tipsify, sander, nehab and barczak 2007. emits every remaining triangle around one vertex at a time and picks
+    // the next vertex among the ones just emitted that will still be in the cache once its own triangles are done.
+    // clusters receives the first triangle of every run that had to start over from a dead end
+    static void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize,
+        uint32_t* clusters, size_t& clusterCount, Arena& scratch)
+    {
+        size_t triangleCount = indexCount / 3;
+        clusterCount = 0;
+
+        if (triangleCount == 0)
+        {
+            return;
+        }
+
+        uint32_t* live = scratch.allocate<uint32_t>(vertexCount);
+        uint32_t* offsets = scratch.allocate<uint32_t>(vertexCount + 1);
+        uint32_t* adjacency = scratch.allocate<uint32_t>(indexCount);
+        uint32_t* cacheTime = scratch.allocate<uint32_t>(vertexCount);
+        uint32_t* deadEnd = scratch.allocate<uint32_t>(indexCount);
+        uint8_t* emitted = scratch.allocate<uint8_t>(triangleCount);
+
+        memset(live, 0, sizeof(uint32_t) * vertexCount);
+        memset(cacheTime, 0, sizeof(uint32_t) * vertexCount);
+        memset(emitted, 0, triangleCount);
+
+        // triangles around every vertex, live counts how many of them are still waiting to be emitted
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            live[indices[i]]++;
+        }
+
+        uint32_t offset = 0;
+        for (size_t vertex = 0; vertex < vertexCount; vertex++)
+        {
+            offsets[vertex] = offset;
+            offset += live[vertex];
+        }
+        offsets[vertexCount] = offset;
+
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            adjacency[offsets[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        for (size_t vertex = 0; vertex < vertexCount; vertex++)
+        {
+            offsets[vertex] -= live[vertex];
+        }
+
+        size_t deadEndSize = 0;
+        size_t cursor = 0;
+        size_t outputIndex = 0;
+        uint32_t time = cacheSize + 1;
+
+        uint32_t current = skipDeadEnd(live, deadEnd, deadEndSize, vertexCount, cursor);
+        clusters[clusterCount++] = 0;
+
+        while (current != OPTIMIZE_INVALID)
+        {
+            size_t candidatesBegin = deadEndSize;
+
+            for (uint32_t i = offsets[current]; i < offsets[current + 1]; i++)
+            {
+                uint32_t triangle = adjacency[i];
+
+                if (emitted[triangle])
+                {
+                    continue;
+                }
+
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    uint32_t vertex = indices[triangle * 3 + corner];
+
+                    destination[outputIndex++] = vertex;
+                    deadEnd[deadEndSize++] = vertex;
+                    live[vertex]--;
+
+                    if (time - cacheTime[vertex] > cacheSize)
+                    {
+                        cacheTime[vertex] = time++;
+                    }
+                }
+
+                emitted[triangle] = 1;
+            }
+
+            // a candidate that would fall out of the cache before all its triangles are emitted is only a last resort
+            uint32_t next = OPTIMIZE_INVALID;
+            int64_t bestPriority = -1;
+
+            for (size_t i = candidatesBegin; i < deadEndSize; i++)
+            {
+                uint32_t vertex = deadEnd[i];
+
+                if (live[vertex] == 0)
+                {
+                    continue;
+                }
+
+                int64_t priority = 0;
+                if (time - cacheTime[vertex] + 2 * live[vertex] <= cacheSize)
+                {
+                    priority = time - cacheTime[vertex];
+                }
+
+                if (priority > bestPriority)
+                {
+                    bestPriority = priority;
+                    next = vertex;
+                }
+            }
+
+            if (next == OPTIMIZE_INVALID)
+            {
+                next = skipDeadEnd(live, deadEnd, deadEndSize, vertexCount, cursor);
+
+                if (next != OPTIMIZE_INVALID)
+                {
+                    clusters[clusterCount++] = static_cast<uint32_t>(outputIndex / 3);
+                }
+            }
+
+            current = next;
+        }
+    }
+
+    // splits the hard clusters tipsify produced further, wherever the cache efficiency of the part so far is already
+    // close to that of the whole cluster. smaller clusters give the sort below more freedom
+    static size_t splitClusters(const uint32_t* indices, size_t indexCount, size_t vertexCount, const uint32_t* hardClusters, size_t hardClusterCount,
+        uint32_t cacheSize, float threshold, uint32_t* softClusters, Arena& scratch)
+    {
+        size_t triangleCount = indexCount / 3;
+
+        uint32_t* timestamps = scratch.allocate<uint32_t>(vertexCount);
+        memset(timestamps, 0, sizeof(uint32_t) * vertexCount);
+
+        // starting a cluster moves time past every cached vertex, which empties the cache without touching it
+        uint32_t time = 0;
+        auto triangleMisses = [&](size_t triangle)
+        {
+            uint32_t misses = 0;
+
+            for (int corner = 0; corner < 3; corner++)
+            {
+                uint32_t vertex = indices[triangle * 3 + corner];
+
+                if (time - timestamps[vertex] > cacheSize)
+                {
+                    timestamps[vertex] = time++;
+                    misses++;
+                }
+            }
+
+            return misses;
+        };
+
+        size_t softClusterCount = 0;
+
+        for (size_t cluster = 0; cluster < hardClusterCount; cluster++)
+        {
+            size_t begin = hardClusters[cluster];
+            size_t end = cluster + 1 < hardClusterCount ? hardClusters[cluster + 1] : triangleCount;
+
+            time += cacheSize + 1;
+
+            size_t clusterMisses = 0;
+            for (size_t triangle = begin; triangle < end; triangle++)
+            {
+                clusterMisses += triangleMisses(triangle);
+            }
+
+            float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+            time += cacheSize + 1;
+            softClusters[softClusterCount++] = static_cast<uint32_t>(begin);
+
+            size_t misses = 0;
+            size_t triangles = 0;
+
+            for (size_t triangle = begin; triangle < end; triangle++)
+            {
+                misses += triangleMisses(triangle);
+                triangles++;
+
+                if (triangle + 1 < end && static_cast<float>(misses) / static_cast<float>(triangles) <= clusterThreshold)
+                {
+                    softClusters[softClusterCount++] = static_cast<uint32_t>(triangle + 1);
+
+                    time += cacheSize + 1;
+                    misses = 0;
+                    triangles = 0;
+                }
+            }
+
+            // a tail that never got down to the threshold would only cost misses on its own, it stays with the part before it
+            if (triangles > 0 && softClusters[softClusterCount - 1] != begin)
+            {
+                softClusterCount--;
+            }
+        }
+
+        return softClusterCount;
+    }
+
+    // sorts clusters by how far out they face from the centre of the mesh. those drawn first are the ones most likely
+    // to cover the rest from any direction, which cuts overdraw without knowing the view
+    static void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, const uint32_t* hardClusters,
+        size_t hardClusterCount, uint32_t cacheSize, float threshold, Arena& scratch)
+    {
+        size_t triangleCount = indexCount / 3;
+
+        if (triangleCount == 0)
+        {
+            return;
+        }
+
+        uint32_t* clusters = scratch.allocate<uint32_t>(triangleCount + 1);
+        size_t clusterCount = splitClusters(indices, indexCount, vertexCount, hardClusters, hardClusterCount, cacheSize, threshold, clusters, scratch);
+        clusters[clusterCount] = static_cast<uint32_t>(triangleCount);
+
+        glm::vec3* centroids = scratch.allocate<glm::vec3>(clusterCount);
+        glm::vec3* normals = scratch.allocate<glm::vec3>(clusterCount);
+        float* keys = scratch.allocate<float>(clusterCount);
+        uint32_t* order = scratch.allocate<uint32_t>(clusterCount);
+
+        // area weighted, the length of a cross product is twice the triangle's area
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+
+        for (size_t cluster = 0; cluster < clusterCount; cluster++)
+        {
+            glm::vec3 centroid(0.0f);
+            glm::vec3 normal(0.0f);
+            float area = 0.0f;
+
+            for (size_t triangle = clusters[cluster]; triangle < clusters[cluster + 1]; triangle++)
+            {
+                const glm::vec3& a = vertices[indices[triangle * 3 + 0]].pos;
+                const glm::vec3& b = vertices[indices[triangle * 3 + 1]].pos;
+                const glm::vec3& c = vertices[indices[triangle * 3 + 2]].pos;
+
+                glm::vec3 cross = glm::cross(b - a, c - a);
+                float triangleArea = glm::length(cross);
+
+                centroid += (a + b + c) * (triangleArea / 3.0f);
+                normal += cross;
+                area += triangleArea;
+            }
+
+            meshCentroid += centroid;
+            meshArea += area;
+
+            centroids[cluster] = area > 0.0f ? centroid / area : centroid;
+            normals[cluster] = normal;
+        }
+
+        meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : meshCentroid;
+
+        for (size_t cluster = 0; cluster < clusterCount; cluster++)
+        {
+            float length = glm::length(normals[cluster]);
+            keys[cluster] = length > 0.0f ? glm::dot(centroids[cluster] - meshCentroid, normals[cluster] / length) : 0.0f;
+            order[cluster] = static_cast<uint32_t>(cluster);
+        }
+
+        // ties keep tipsify's order, so the result does not depend on the sort implementation
+        std::sort(order, order + clusterCount, [&](uint32_t a, uint32_t b)
+        {
+            return keys[a] > keys[b] || (keys[a] == keys[b] && a < b);
+        });
+
+        uint32_t* sorted = scratch.allocate<uint32_t>(indexCount);
+        size_t outputIndex = 0;
+
+        for (size_t i = 0; i < clusterCount; i++)
+        {
+            uint32_t cluster = order[i];
+            size_t begin = static_cast<size_t>(clusters[cluster]) * 3;
+            size_t end = static_cast<size_t>(clusters[cluster + 1]) * 3;
+
+            memcpy(sorted + outputIndex, indices + begin, (end - begin) * sizeof(uint32_t));
+            outputIndex += end - begin;
+        }
+
+        memcpy(indices, sorted, indexCount * sizeof(uint32_t));
+    }
+
+    // renumbers vertices in order of first use and rewrites the indices to match, returns the number of vertices kept
+    static size_t optimizeVertexFetch(Vertex* destination, uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, Arena& scratch)
+    {
+        uint32_t* remap = scratch.allocate<uint32_t>(vertexCount);
+        memset(remap, 0xFF, sizeof(uint32_t) * vertexCount);
+
+        uint32_t next = 0;
+
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            uint32_t vertex = indices[i];
+
+            if (remap[vertex] == OPTIMIZE_INVALID)
+            {
+                remap[vertex] = next;
+                destination[next++] = vertices[vertex];
+            }
+
+            indices[i] = remap[vertex];
+        }
+
+        return next;
+    }
+
+    // the triangle passes run on one submesh at a time with the vertices renumbered locally, so the work per
+    // submesh depends on its own size and not on the whole mesh's vertex count. everything it allocates is dead
+    // once it returns, the caller resets scratch before the next submesh
+    static void optimizeSubmesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const Vertex* vertices,
+        uint32_t* localVertex, Arena& scratch)
+    {
+        uint32_t* localIndices = scratch.allocate<uint32_t>(indexCount);
+        size_t localCount = 0;
+
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            uint32_t vertex = indices[i];
+
+            if (localVertex[vertex] == OPTIMIZE_INVALID)
+            {
+                localVertex[vertex] = static_cast<uint32_t>(localCount++);
+            }
+
+            localIndices[i] = localVertex[vertex];
+        }
+
+        // the vertex arrays only need the submesh's own vertices, a second pass fills them
+        uint32_t* globalVertex = scratch.allocate<uint32_t>(localCount);
+        Vertex* localVertices = scratch.allocate<Vertex>(localCount);
+
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            globalVertex[localIndices[i]] = indices[i];
+        }
+
+        for (size_t i = 0; i < localCount; i++)
+        {
+            localVertices[i] = vertices[globalVertex[i]];
+        }
+
+        uint32_t* reordered = scratch.allocate<uint32_t>(indexCount);
+        uint32_t* clusters = scratch.allocate<uint32_t>(indexCount / 3 + 1);
+        size_t clusterCount = 0;
+
+        optimizeVertexCache(reordered, localIndices, indexCount, localCount, VERTEX_CACHE_SIZE, clusters, clusterCount, scratch);
+        optimizeOverdraw(reordered, indexCount, localVertices, localCount, clusters, clusterCount, VERTEX_CACHE_SIZE, OVERDRAW_THRESHOLD, scratch);
+
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            destination[i] = globalVertex[reordered[i]];
+        }
+
+        // leaves the table cleared for the next submesh
+        for (size_t i = 0; i < localCount; i++)
+        {
+            localVertex[globalVertex[i]] = OPTIMIZE_INVALID;
+        }
+    }
+
+    static MeshOptimizeStats optimize(ArenaVector<Vertex>& vertices, ArenaVector<uint32_t>& indices, const std::vector<Submesh>& submeshes, Arena& scratch)
+    {
+        MeshOptimizeStats stats;
+        stats.before = analyzeVertexCache(indices.data(), indices.size(), vertices.size(), VERTEX_CACHE_SIZE, scratch);
+
+        uint32_t* reordered = scratch.allocate<uint32_t>(indices.size());
+        uint32_t* localVertex = scratch.allocate<uint32_t>(vertices.size());
+        memset(localVertex, 0xFF, sizeof(uint32_t) * vertices.size());
+
+        Arena submeshScratch(OPTIMIZE_SCRATCH_BLOCK_SIZE);
+
+        for (const Submesh& submesh : submeshes)
+        {
+            optimizeSubmesh(reordered + submesh.firstIndex, indices.data() + submesh.firstIndex, submesh.indexCount, vertices.data(), localVertex, submeshScratch);
+            submeshScratch.reset();
+        }
+
+        Vertex* fetchOrdered = scratch.allocate<Vertex>(vertices.size());
+        size_t vertexCount = optimizeVertexFetch(fetchOrdered, reordered, indices.size(), vertices.data(), vertices.size(), scratch);
+
+        vertices.resize(vertexCount);
+        memcpy(vertices.data(), fetchOrdered, vertexCount * sizeof(Vertex));
+        memcpy(indices.data(), reordered, indices.size() * sizeof(uint32_t));
+
+        stats.after = analyzeVertexCache(indices.data(), indices.size(), vertices.size(), VERTEX_CACHE_SIZE, scratch);
+
+        return stats;
+    }
+};
+
+#endif // MESH_OPTIMIZER_H
@@ -0,0 +1,780 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+#include "Arena.h"
+#include "Submesh.h"
+#include "MeshOptimizer.h"
+
+// how the lod chain of a mesh is built. every level aims for reduction times the triangles of the one before it,
+// maxError caps how far a level may move from the full detail surface, relative to the mesh's bounding radius
+struct LodSettings
+{
+    uint32_t levelCount = 4;
+    float reduction = 0.5f;
+    float maxError = 0.05f;
+};
+
+struct LodStats
+{
+    size_t triangleCount = 0;
+    float error = 0.0f;
+};
+
+// builds coarser levels of a deduplicated mesh by edge collapse with garland and heckbert's quadric error metric.
+// a vertex only ever collapses onto one of its neighbours, so every level keeps drawing from the full detail vertex
+// buffer and only adds indices. border vertices only slide along the border, and the two vertices of a uv or normal
+// seam only slide along the seam, together, so both sides keep their attributes and the seam stays closed. vertices
+// where seams meet or that one submesh shares with another never move, which keeps material boundaries exact
+namespace MeshSimplifier
+{
+    const double BORDER_WEIGHT = 10.0; // how strongly open borders keep their shape compared to the surface
+    const double FLIP_THRESHOLD = 0.2; // smallest cosine between a triangle's normal before and after a collapse
+    const float MIN_LEVEL_REDUCTION = 0.9f; // a level that keeps more of the previous one's triangles than this ends the chain
+
+    const uint32_t SIMPLIFY_INVALID = UINT32_MAX;
+
+    // symmetric 4x4 error matrix of a set of planes, evaluated as the weighted sum of squared distances to them
+    struct Quadric
+    {
+        double a00, a11, a22, a01, a02, a12;
+        double b0, b1, b2;
+        double c;
+        double weight;
+    };
+
+    static void addPlane(Quadric& quadric, const glm::dvec3& normal, double distance, double weight)
+    {
+        quadric.a00 += weight * normal.x * normal.x;
+        quadric.a11 += weight * normal.y * normal.y;
+        quadric.a22 += weight * normal.z * normal.z;
+        quadric.a01 += weight * normal.x * normal.y;
+        quadric.a02 += weight * normal.x * normal.z;
+        quadric.a12 += weight * normal.y * normal.z;
+        quadric.b0 += weight * normal.x * distance;
+        quadric.b1 += weight * normal.y * distance;
+        quadric.b2 += weight * normal.z * distance;
+        quadric.c += weight * distance * distance;
+        quadric.weight += weight;
+    }
+
+    static void addQuadric(Quadric& destination, const Quadric& source)
+    {
+        destination.a00 += source.a00;
+        destination.a11 += source.a11;
+        destination.a22 += source.a22;
+        destination.a01 += source.a01;
+        destination.a02 += source.a02;
+        destination.a12 += source.a12;
+        destination.b0 += source.b0;
+        destination.b1 += source.b1;
+        destination.b2 += source.b2;
+        destination.c += source.c;
+        destination.weight += source.weight;
+    }
+
+    // squared distance averaged over the weight, so the error is in object space units squared whatever the triangle sizes
+    static double evaluate(const Quadric& a, const Quadric& b, const glm::dvec3& p)
+    {
+        double a00 = a.a00 + b.a00, a11 = a.a11 + b.a11, a22 = a.a22 + b.a22;
+        double a01 = a.a01 + b.a01, a02 = a.a02 + b.a02, a12 = a.a12 + b.a12;
+        double b0 = a.b0 + b.b0, b1 = a.b1 + b.b1, b2 = a.b2 + b.b2;
+        double c = a.c + b.c;
+        double weight = a.weight + b.weight;
+
+        double error = p.x * (a00 * p.x + a01 * p.y + a02 * p.z)
+            + p.y * (a01 * p.x + a11 * p.y + a12 * p.z)
+            + p.z * (a02 * p.x + a12 * p.y + a22 * p.z)
+            + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+
+        return weight > 0.0 ? std::fabs(error) / weight : 0.0;
+    }
+
+    // what carries over from one level to the next, so each level is simplified from the previous one and the
+    // quadrics keep accumulating the error of every collapse so far
+    struct SimplifyState
+    {
+        const Vertex* vertices = nullptr;
+        size_t vertexCount = 0;
+
+        std::vector<uint32_t> indices;
+        std::vector<uint32_t> triangleSubmesh; // index into the full detail submeshes
+
+        std::vector<uint32_t> positionId; // first vertex with the same position, seams are several vertices at one position
+        std::vector<uint32_t> seamPartner; // the other vertex at a position that has exactly two, SIMPLIFY_INVALID otherwise
+        std::vector<uint8_t> locked;
+        std::vector<Quadric> quadrics; // by position id
+
+        double error = 0.0; // largest collapse cost so far, squared
+
+        // per pass
+        std::vector<uint32_t> adjacencyOffsets;
+        std::vector<uint32_t> adjacency;
+        std::vector<uint32_t> remap;
+        std::vector<uint8_t> touched;
+    };
+
+    // a seam collapse also moves the vertex on the other side of the seam, partnerFrom onto partnerTo
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        double cost;
+        uint32_t partnerFrom = SIMPLIFY_INVALID;
+        uint32_t partnerTo = SIMPLIFY_INVALID;
+    };
+
+    static glm::dvec3 getPosition(const SimplifyState& state, uint32_t vertex)
+    {
+        return glm::dvec3(state.vertices[vertex].pos);
+    }
+
+    static void initialize(SimplifyState& state, const Vertex* vertices, size_t vertexCount, const uint32_t* indices, const std::vector<Submesh>& submeshes)
+    {
+        state.vertices = vertices;
+        state.vertexCount = vertexCount;
+        state.error = 0.0;
+
+        state.indices.clear();
+        state.triangleSubmesh.clear();
+
+        for (size_t i = 0; i < submeshes.size(); i++)
+        {
+            const Submesh& submesh = submeshes[i];
+
+            state.indices.insert(state.indices.end(), indices + submesh.firstIndex, indices + submesh.firstIndex + submesh.indexCount);
+            state.triangleSubmesh.insert(state.triangleSubmesh.end(), submesh.indexCount / 3, static_cast<uint32_t>(i));
+        }
+
+        // vertices sorted by position, equal runs share a position id
+        std::vector<uint32_t> order(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            order[i] = static_cast<uint32_t>(i);
+        }
+
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+        {
+            const glm::vec3& pa = vertices[a].pos;
+            const glm::vec3& pb = vertices[b].pos;
+
+            if (pa.x != pb.x) return pa.x < pb.x;
+            if (pa.y != pb.y) return pa.y < pb.y;
+            if (pa.z != pb.z) return pa.z < pb.z;
+            return a < b;
+        });
+
+        state.positionId.assign(vertexCount, SIMPLIFY_INVALID);
+        state.seamPartner.assign(vertexCount, SIMPLIFY_INVALID);
+        state.locked.assign(vertexCount, 0);
+
+        for (size_t begin = 0; begin < vertexCount;)
+        {
+            size_t end = begin + 1;
+            while (end < vertexCount && vertices[order[end]].pos == vertices[order[begin]].pos)
+            {
+                end++;
+            }
+
+            for (size_t i = begin; i < end; i++)
+            {
+                state.positionId[order[i]] = order[begin];
+                state.locked[order[i]] = end - begin > 2 ? 1 : 0;
+            }
+
+            if (end - begin == 2)
+            {
+                state.seamPartner[order[begin]] = order[begin + 1];
+                state.seamPartner[order[begin + 1]] = order[begin];
+            }
+
+            begin = end;
+        }
+
+        std::vector<uint32_t> vertexSubmesh(vertexCount, SIMPLIFY_INVALID);
+
+        for (size_t i = 0; i < state.indices.size(); i++)
+        {
+            uint32_t vertex = state.indices[i];
+            uint32_t submesh = state.triangleSubmesh[i / 3];
+
+            if (vertexSubmesh[vertex] == SIMPLIFY_INVALID)
+            {
+                vertexSubmesh[vertex] = submesh;
+            }
+            else if (vertexSubmesh[vertex] != submesh)
+            {
+                state.locked[vertex] = 1;
+            }
+        }
+
+        // every triangle's plane weighted by its area, open edges add a plane through the edge standing up from the triangle
+        state.quadrics.assign(vertexCount, Quadric{});
+
+        std::vector<uint64_t> edges;
+        edges.reserve(state.indices.size());
+
+        for (size_t i = 0; i < state.indices.size(); i += 3)
+        {
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                uint64_t a = state.positionId[state.indices[i + corner]];
+                uint64_t b = state.positionId[state.indices[i + (corner + 1) % 3]];
+
+                edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+            }
+        }
+
+        std::sort(edges.begin(), edges.end());
+
+        for (size_t i = 0; i < state.indices.size(); i += 3)
+        {
+            uint32_t p[3] =
+            {
+                state.positionId[state.indices[i + 0]],
+                state.positionId[state.indices[i + 1]],
+                state.positionId[state.indices[i + 2]]
+            };
+
+            glm::dvec3 p0 = getPosition(state, p[0]);
+            glm::dvec3 normal = glm::cross(getPosition(state, p[1]) - p0, getPosition(state, p[2]) - p0);
+            double length = glm::length(normal);
+
+            if (length == 0.0)
+            {
+                continue;
+            }
+
+            normal /= length;
+
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                addPlane(state.quadrics[p[corner]], normal, -glm::dot(normal, p0), length * 0.5);
+            }
+
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                uint64_t a = p[corner];
+                uint64_t b = p[(corner + 1) % 3];
+                uint64_t key = a < b ? (a << 32) | b : (b << 32) | a;
+
+                auto range = std::equal_range(edges.begin(), edges.end(), key);
+                if (range.second - range.first != 1)
+                {
+                    continue;
+                }
+
+                glm::dvec3 pa = getPosition(state, p[corner]);
+                glm::dvec3 edge = getPosition(state, p[(corner + 1) % 3]) - pa;
+                glm::dvec3 borderNormal = glm::cross(edge, normal);
+                double borderLength = glm::length(borderNormal);
+
+                if (borderLength == 0.0)
+                {
+                    continue;
+                }
+
+                borderNormal /= borderLength;
+                double weight = glm::dot(edge, edge) * BORDER_WEIGHT;
+
+                addPlane(state.quadrics[p[corner]], borderNormal, -glm::dot(borderNormal, pa), weight);
+                addPlane(state.quadrics[p[(corner + 1) % 3]], borderNormal, -glm::dot(borderNormal, pa), weight);
+            }
+        }
+    }
+
+    // vertex to triangle lists of the current index buffer
+    static void buildAdjacency(SimplifyState& state)
+    {
+        state.adjacencyOffsets.assign(state.vertexCount + 1, 0);
+
+        for (uint32_t vertex : state.indices)
+        {
+            state.adjacencyOffsets[vertex + 1]++;
+        }
+
+        for (size_t i = 0; i < state.vertexCount; i++)
+        {
+            state.adjacencyOffsets[i + 1] += state.adjacencyOffsets[i];
+        }
+
+        state.adjacency.resize(state.indices.size());
+        std::vector<uint32_t> fill(state.adjacencyOffsets.begin(), state.adjacencyOffsets.end() - 1);
+
+        for (size_t i = 0; i < state.indices.size(); i++)
+        {
+            state.adjacency[fill[state.indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    // the vertex the collapses of this pass have moved vertex onto, itself when it has not moved. a target is never
+    // moved in the same pass, so one step is enough
+    static uint32_t getCurrent(const SimplifyState& state, uint32_t vertex)
+    {
+        return state.remap[vertex];
+    }
+
+    // the neighbours around vertex that only one of its triangles reaches, which are the ends of the open edges of its
+    // fan. false when a neighbour is reached by more than two triangles, a non manifold fan
+    static bool findFanBorders(const SimplifyState& state, uint32_t vertex, std::vector<uint32_t>& neighbours, std::vector<uint32_t>& borders)
+    {
+        neighbours.clear();
+        borders.clear();
+
+        for (uint32_t i = state.adjacencyOffsets[vertex]; i < state.adjacencyOffsets[vertex + 1]; i++)
+        {
+            const uint32_t* triangle = &state.indices[state.adjacency[i] * 3];
+
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                if (triangle[corner] != vertex)
+                {
+                    neighbours.push_back(triangle[corner]);
+                }
+            }
+        }
+
+        std::sort(neighbours.begin(), neighbours.end());
+
+        for (size_t begin = 0; begin < neighbours.size();)
+        {
+            size_t end = begin + 1;
+            while (end < neighbours.size() && neighbours[end] == neighbours[begin])
+            {
+                end++;
+            }
+
+            if (end - begin > 2)
+            {
+                return false;
+            }
+
+            if (end - begin == 1)
+            {
+                borders.push_back(neighbours[begin]);
+            }
+
+            begin = end;
+        }
+
+        return true;
+    }
+
+    // a seam vertex and its partner each see the seam as the two open edges of their fan, and both fans have to end
+    // at the same two positions. the pair then collapses onto one of those, each side onto its own vertex there, as
+    // long as the seam goes on through it, so the attributes on either side are kept. the pair is handled from its
+    // lower vertex
+    static bool findSeamCollapse(const SimplifyState& state, uint32_t vertex, std::vector<uint32_t>& neighbours, Collapse& collapse)
+    {
+        uint32_t partner = state.seamPartner[vertex];
+
+        if (partner < vertex || state.locked[partner] || state.adjacencyOffsets[partner + 1] == state.adjacencyOffsets[partner])
+        {
+            return false;
+        }
+
+        std::vector<uint32_t> borders, partnerBorders;
+
+        if (!findFanBorders(state, vertex, neighbours, borders) || !findFanBorders(state, partner, neighbours, partnerBorders)
+            || borders.size() != 2 || partnerBorders.size() != 2)
+        {
+            return false;
+        }
+
+        uint32_t position = state.positionId[vertex];
+        collapse.cost = -1.0;
+
+        for (uint32_t target : borders)
+        {
+            uint32_t partnerTarget = SIMPLIFY_INVALID;
+
+            for (uint32_t candidate : partnerBorders)
+            {
+                if (state.positionId[candidate] == state.positionId[target])
+                {
+                    partnerTarget = candidate;
+                }
+            }
+
+            if (partnerTarget == SIMPLIFY_INVALID || partnerTarget == target)
+            {
+                continue;
+            }
+
+            double cost = evaluate(state.quadrics[position], state.quadrics[state.positionId[target]], getPosition(state, target));
+
+            if (collapse.cost < 0.0 || cost < collapse.cost)
+            {
+                collapse = { vertex, target, cost, partner, partnerTarget };
+            }
+        }
+
+        return collapse.cost >= 0.0;
+    }
+
+    // the cheapest neighbour a free vertex can collapse onto, or false when it has none. a neighbour position that
+    // shows up as two different vertices around it is a seam ending here and is left alone, as are non manifold fans
+    static bool findCollapse(const SimplifyState& state, uint32_t vertex, std::vector<uint32_t>& neighbours, Collapse& collapse)
+    {
+        if (state.seamPartner[vertex] != SIMPLIFY_INVALID)
+        {
+            return findSeamCollapse(state, vertex, neighbours, collapse);
+        }
+
+        neighbours.clear();
+
+        uint32_t position = state.positionId[vertex];
+
+        for (uint32_t i = state.adjacencyOffsets[vertex]; i < state.adjacencyOffsets[vertex + 1]; i++)
+        {
+            const uint32_t* triangle = &state.indices[state.adjacency[i] * 3];
+
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                if (triangle[corner] != vertex)
+                {
+                    neighbours.push_back(triangle[corner]);
+                }
+            }
+        }
+
+        std::sort(neighbours.begin(), neighbours.end(), [&](uint32_t a, uint32_t b)
+        {
+            return state.positionId[a] != state.positionId[b] ? state.positionId[a] < state.positionId[b] : a < b;
+        });
+
+        bool border = false;
+
+        for (size_t begin = 0; begin < neighbours.size();)
+        {
+            size_t end = begin + 1;
+            while (end < neighbours.size() && state.positionId[neighbours[end]] == state.positionId[neighbours[begin]])
+            {
+                end++;
+            }
+
+            if (end - begin > 2)
+            {
+                return false;
+            }
+
+            border |= end - begin == 1;
+            begin = end;
+        }
+
+        collapse.cost = -1.0;
+
+        for (size_t begin = 0; begin < neighbours.size();)
+        {
+            size_t end = begin + 1;
+            while (end < neighbours.size() && state.positionId[neighbours[end]] == state.positionId[neighbours[begin]])
+            {
+                end++;
+            }
+
+            uint32_t target = neighbours[begin];
+            bool seam = end - begin == 2 && neighbours[begin] != neighbours[begin + 1];
+            bool alongBorder = end - begin == 1;
+
+            if (!seam && (!border || alongBorder))
+            {
+                double cost = evaluate(state.quadrics[position], state.quadrics[state.positionId[target]], getPosition(state, target));
+
+                if (collapse.cost < 0.0 || cost < collapse.cost)
+                {
+                    collapse = { vertex, target, cost };
+                }
+            }
+
+            begin = end;
+        }
+
+        return collapse.cost >= 0.0;
+    }
+
+    // true when moving from onto to would turn one of from's remaining triangles over. the triangles are taken as the
+    // earlier collapses of this pass have left them, a neighbour that already moved is tested where it is now
+    static bool flipsTriangle(const SimplifyState& state, uint32_t from, uint32_t to)
+    {
+        uint32_t targetPosition = state.positionId[to];
+        glm::dvec3 target = getPosition(state, to);
+
+        for (uint32_t i = state.adjacencyOffsets[from]; i < state.adjacencyOffsets[from + 1]; i++)
+        {
+            const uint32_t* triangle = &state.indices[state.adjacency[i] * 3];
+            uint32_t current[3] = { getCurrent(state, triangle[0]), getCurrent(state, triangle[1]), getCurrent(state, triangle[2]) };
+            uint32_t positions[3] = { state.positionId[current[0]], state.positionId[current[1]], state.positionId[current[2]] };
+
+            // removed by this collapse or by an earlier one
+            if (positions[0] == targetPosition || positions[1] == targetPosition || positions[2] == targetPosition
+                || positions[0] == positions[1] || positions[1] == positions[2] || positions[0] == positions[2])
+            {
+                continue;
+            }
+
+            glm::dvec3 before[3] = { getPosition(state, current[0]), getPosition(state, current[1]), getPosition(state, current[2]) };
+            glm::dvec3 after[3] = { before[0], before[1], before[2] };
+
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                if (triangle[corner] == from)
+                {
+                    after[corner] = target;
+                }
+            }
+
+            glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+
+            if (glm::dot(normalBefore, normalAfter) <= FLIP_THRESHOLD * glm::length(normalBefore) * glm::length(normalAfter))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static bool flipsTriangle(const SimplifyState& state, const Collapse& collapse)
+    {
+        return flipsTriangle(state, collapse.from, collapse.to)
+            || (collapse.partnerFrom != SIMPLIFY_INVALID && flipsTriangle(state, collapse.partnerFrom, collapse.partnerTo));
+    }
+
+    // triangles that would disappear with the collapse, the ones around from sharing the collapsed edge that no
+    // earlier collapse of this pass has removed already
+    static size_t countRemoved(const SimplifyState& state, uint32_t from, uint32_t to)
+    {
+        uint32_t targetPosition = state.positionId[to];
+        size_t removed = 0;
+
+        for (uint32_t i = state.adjacencyOffsets[from]; i < state.adjacencyOffsets[from + 1]; i++)
+        {
+            const uint32_t* triangle = &state.indices[state.adjacency[i] * 3];
+            uint32_t positions[3] =
+            {
+                state.positionId[getCurrent(state, triangle[0])],
+                state.positionId[getCurrent(state, triangle[1])],
+                state.positionId[getCurrent(state, triangle[2])]
+            };
+
+            bool degenerate = positions[0] == positions[1] || positions[1] == positions[2] || positions[0] == positions[2];
+
+            removed += !degenerate && (positions[0] == targetPosition || positions[1] == targetPosition || positions[2] == targetPosition);
+        }
+
+        return removed;
+    }
+
+    static size_t countRemoved(const SimplifyState& state, const Collapse& collapse)
+    {
+        size_t removed = countRemoved(state, collapse.from, collapse.to);
+
+        if (collapse.partnerFrom != SIMPLIFY_INVALID)
+        {
+            removed += countRemoved(state, collapse.partnerFrom, collapse.partnerTo);
+        }
+
+        return removed;
+    }
+
+    // one round of collapses, cheapest first, with every position touched at most once so the costs stay valid.
+    // returns how many collapses were applied
+    static size_t simplifyPass(SimplifyState& state, size_t targetTriangles, double maxErrorSquared)
+    {
+        buildAdjacency(state);
+
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> neighbours;
+
+        for (size_t vertex = 0; vertex < state.vertexCount; vertex++)
+        {
+            Collapse collapse;
+
+            if (!state.locked[vertex] && state.adjacencyOffsets[vertex + 1] > state.adjacencyOffsets[vertex]
+                && findCollapse(state, static_cast<uint32_t>(vertex), neighbours, collapse) && collapse.cost <= maxErrorSquared)
+            {
+                collapses.push_back(collapse);
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+        {
+            return a.cost < b.cost;
+        });
+
+        state.remap.resize(state.vertexCount);
+        for (size_t i = 0; i < state.vertexCount; i++)
+        {
+            state.remap[i] = static_cast<uint32_t>(i);
+        }
+
+        state.touched.assign(state.vertexCount, 0);
+
+        size_t triangleCount = state.indices.size() / 3;
+        size_t applied = 0;
+
+        for (const Collapse& collapse : collapses)
+        {
+            if (triangleCount <= targetTriangles)
+            {
+                break;
+            }
+
+            uint32_t fromPosition = state.positionId[collapse.from];
+            uint32_t toPosition = state.positionId[collapse.to];
+
+            if (state.touched[fromPosition] || state.touched[toPosition] || flipsTriangle(state, collapse))
+            {
+                continue;
+            }
+
+            triangleCount -= std::min(countRemoved(state, collapse), triangleCount);
+
+            state.remap[collapse.from] = collapse.to;
+            if (collapse.partnerFrom != SIMPLIFY_INVALID)
+            {
+                state.remap[collapse.partnerFrom] = collapse.partnerTo;
+            }
+
+            addQuadric(state.quadrics[toPosition], state.quadrics[fromPosition]);
+            state.touched[fromPosition] = 1;
+            state.touched[toPosition] = 1;
+            state.error = std::max(state.error, collapse.cost);
+            applied++;
+        }
+
+        // rewrites the triangles and drops the ones that became degenerate
+        size_t written = 0;
+
+        for (size_t i = 0; i < state.indices.size(); i += 3)
+        {
+            uint32_t a = state.remap[state.indices[i + 0]];
+            uint32_t b = state.remap[state.indices[i + 1]];
+            uint32_t c = state.remap[state.indices[i + 2]];
+
+            if (state.positionId[a] == state.positionId[b] || state.positionId[b] == state.positionId[c] || state.positionId[a] == state.positionId[c])
+            {
+                continue;
+            }
+
+            state.indices[written + 0] = a;
+            state.indices[written + 1] = b;
+            state.indices[written + 2] = c;
+            state.triangleSubmesh[written / 3] = state.triangleSubmesh[i / 3];
+            written += 3;
+        }
+
+        state.indices.resize(written);
+        state.triangleSubmesh.resize(written / 3);
+
+        return applied;
+    }
+
+    // collapses until the mesh has at most targetTriangles or nothing within maxError is left to collapse
+    static void simplify(SimplifyState& state, size_t targetTriangles, float maxError)
+    {
+        double maxErrorSquared = static_cast<double>(maxError) * maxError;
+
+        while (state.indices.size() / 3 > targetTriangles)
+        {
+            if (simplifyPass(state, targetTriangles, maxErrorSquared) == 0)
+            {
+                break;
+            }
+        }
+    }
+
+    // appends the coarser levels after the full detail indices and submeshes. lods gets one entry per level, the
+    // first being the submeshes already there. every level's submeshes are in the same order as the full detail ones
+    // and are reordered for the vertex cache, the vertex buffer is left as it is
+    static std::vector<LodStats> generateLods(const Vertex* vertices, size_t vertexCount, ArenaVector<uint32_t>& indices, std::vector<Submesh>& submeshes,
+        std::vector<MeshLod>& lods, const LodSettings& settings, Arena& scratch)
+    {
+        std::vector<LodStats> stats;
+
+        lods.clear();
+        lods.push_back({ 0, static_cast<uint32_t>(submeshes.size()), 0.0f });
+        stats.push_back({ indices.size() / 3, 0.0f });
+
+        if (settings.levelCount <= 1 || indices.empty())
+        {
+            return stats;
+        }
+
+        glm::vec3 boundsMin = vertices[0].pos;
+        glm::vec3 boundsMax = vertices[0].pos;
+
+        for (size_t i = 1; i < vertexCount; i++)
+        {
+            boundsMin = glm::min(boundsMin, vertices[i].pos);
+            boundsMax = glm::max(boundsMax, vertices[i].pos);
+        }
+
+        float maxError = settings.maxError * glm::length(boundsMax - boundsMin) * 0.5f;
+
+        std::vector<Submesh> fullDetail = submeshes;
+
+        SimplifyState state;
+        initialize(state, vertices, vertexCount, indices.data(), fullDetail);
+
+        uint32_t* localVertex = scratch.allocate<uint32_t>(vertexCount);
+        memset(localVertex, 0xFF, sizeof(uint32_t) * vertexCount);
+
+        Arena submeshScratch(MeshOptimizer::OPTIMIZE_SCRATCH_BLOCK_SIZE);
+
+        for (uint32_t level = 1; level < settings.levelCount; level++)
+        {
+            size_t previousTriangles = state.indices.size() / 3;
+            size_t targetTriangles = static_cast<size_t>(previousTriangles * settings.reduction);
+
+            simplify(state, targetTriangles, maxError);
+
+            size_t triangles = state.indices.size() / 3;
+
+            if (triangles == 0 || triangles > previousTriangles * MIN_LEVEL_REDUCTION)
+            {
+                break;
+            }
+
+            MeshLod lod{ static_cast<uint32_t>(submeshes.size()), 0, static_cast<float>(std::sqrt(state.error)) };
+
+            for (size_t begin = 0; begin < triangles;)
+            {
+                size_t end = begin + 1;
+                while (end < triangles && state.triangleSubmesh[end] == state.triangleSubmesh[begin])
+                {
+                    end++;
+                }
+
+                const Submesh& source = fullDetail[state.triangleSubmesh[begin]];
+                size_t firstIndex = indices.size();
+                size_t indexCount = (end - begin) * 3;
+
+                indices.resize(firstIndex + indexCount);
+                MeshOptimizer::optimizeSubmesh(indices.data() + firstIndex, state.indices.data() + begin * 3, indexCount, vertices, localVertex, submeshScratch);
+                submeshScratch.reset();
+
+                submeshes.push_back({ static_cast<uint32_t>(firstIndex), static_cast<uint32_t>(indexCount), source.materialIndex, source.shapeIndex });
+                lod.submeshCount++;
+
+                begin = end;
+            }
+
+            lods.push_back(lod);
+            stats.push_back({ triangles, lod.error });
+        }
+
+        return stats;
+    }
+};
+
+#endif // MESH_SIMPLIFIER_H
@@ -1,147 +1,219 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <algorithm>
 #include <stdexcept>
-#include <unordered_map>
 #include <vector>
 #include <string>
+#include <memory>
 
 #include "Vertex.h"
-#include "Buffer.h"
+#include "GeometryArena.h"
+#include "UploadContext.h"
+#include "DeletionQueue.h"
+#include "Arena.h"
+#include "VertexEncoding.h"
+#include "Submesh.h"
+
+#include "MeshImport.h"
+#include "MeshCache.h"
+
+// everything about a model that does not need the device: the mesh encoded for the arena, either mapped from its
+// cache or imported and encoded into scratch. built with Model::load, which may run on any thread
+struct ModelData
+{
+    ModelData();
+
+    Arena scratch; // owns the imported arrays and the encoded copies
+
+    MeshCacheView cache;
+    ArenaVector<Vertex> importedVertices;
+    ArenaVector<uint32_t> importedIndices;
 
-#include "tiny_obj_loader.h"
+    EncodedMesh mesh;
+
+    bool imported = false; // parsed from the source instead of read from a cache or a baked file
+    MeshImportStats importStats;
+};
 
 class Model
 {
 public:
-    Model(std::string& modelPath, VkDevice& device, VkPhysicalDevice& physicalDevice, VkQueue& graphicsQueue, VkCommandPool& commandPool);
+    Model(ModelData& data, GeometryArena& geometryArena, UploadContext& uploadContext, DeletionQueue& deletionQueue);
+
+    static std::unique_ptr<ModelData> load(const std::string& modelPath, VertexFormat vertexFormat, ThreadPool& threadPool);
 
     void destroyModel();
 
-    void createVertexBuffer(VkDevice& device, VkPhysicalDevice& physicalDevice, VkQueue& graphicsQueue, VkCommandPool& commandPool);
-    void createIndexBuffer(VkDevice& device, VkPhysicalDevice& physicalDevice, VkQueue& graphicsQueue, VkCommandPool& commandPool);
+    void createVertexBuffer(UploadContext& uploadContext, const void* vertexData, size_t vertexCount);
+    void createIndexBuffer(UploadContext& uploadContext, const void* indexData, size_t indexCount);
 
-    std::vector<uint32_t> indices;
+    // picks the level to draw from how many pixels its error covers at the given distance. pixelsPerUnit is the
+    // size on screen of one object space unit at distance 1. a coarser level is only taken once its error is
+    // comfortably below maxPixelError, so an object sitting at a switching distance does not flicker between two
+    uint32_t selectLod(float distance, float pixelsPerUnit, float maxPixelError, float hysteresis);
 
-    VkBuffer vertexBuffer = NULL;
-    VkBuffer indexBuffer = NULL;
+    GeometryRange geometry; // base vertex and first index inside the shared arena buffers
 
-private:
-    VkDeviceMemory vertexBufferMemory = NULL;
-    VkDeviceMemory indexBufferMemory = NULL;
+    std::vector<Submesh> submeshes; // every level's submeshes grouped by material, firstIndex is relative to geometry.firstIndex
+    std::vector<MeshLod> lods; // finest first, always at least one
+    std::vector<MeshMaterial> materials;
+    std::vector<float> materialUvDensity; // indexed like materials, decides how much of their textures is streamed in
+
+    uint32_t currentLod = 0;
+
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
 
-    VkDevice* pDevice = nullptr;
+    VertexTransform vertexTransform; // undoes the arena's vertex encoding in the vertex shader
 
-    std::vector<Vertex> vertices;
+private:
+    GeometryArena* pGeometryArena = nullptr;
+    DeletionQueue* pDeletionQueue = nullptr;
 };
 
-Model::Model(std::string& modelPath, VkDevice& device, VkPhysicalDevice& physicalDevice, VkQueue& graphicsQueue, VkCommandPool& commandPool)
+// scratch for the cpu side of a load, it is thrown away as soon as the geometry has been staged
+const size_t MODEL_SCRATCH_BLOCK_SIZE = 16 * 1024 * 1024;
+
+ModelData::ModelData()
+    : scratch(MODEL_SCRATCH_BLOCK_SIZE, true),
+    importedVertices{ ArenaAllocator<Vertex>(scratch) },
+    importedIndices{ ArenaAllocator<uint32_t>(scratch) }
 {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
+}
+
+// only allocates the arena range and copies the prepared data into staging memory
+Model::Model(ModelData& data, GeometryArena& geometryArena, UploadContext& uploadContext, DeletionQueue& deletionQueue)
+{
+    pGeometryArena = &geometryArena;
+    pDeletionQueue = &deletionQueue;
+
+    EncodedMesh& mesh = data.mesh;
+
+    submeshes = std::move(mesh.submeshes);
+    lods = std::move(mesh.lods);
+    materials = std::move(mesh.materials);
+    materialUvDensity = std::move(mesh.materialUvDensity);
+    boundsMin = mesh.boundsMin;
+    boundsMax = mesh.boundsMax;
+    vertexTransform = mesh.vertexTransform;
+
+    geometry = geometryArena.allocate(static_cast<uint32_t>(mesh.vertexCount), static_cast<uint32_t>(mesh.indexCount), mesh.indexType);
+
+    createVertexBuffer(uploadContext, mesh.vertexData, mesh.vertexCount);
+    createIndexBuffer(uploadContext, mesh.indexData, mesh.indexCount);
+}
+
+std::unique_ptr<ModelData> Model::load(const std::string& modelPath, VertexFormat vertexFormat, ThreadPool& threadPool)
+{
+    std::unique_ptr<ModelData> data = std::make_unique<ModelData>();
+    EncodedMesh& mesh = data->mesh;
+
+    // baked meshes ship without their source, anything else is parsed unless it has an up to date cache
+    bool baked = modelPath.size() > 5 && modelPath.compare(modelPath.size() - 5, 5, ".mesh") == 0;
+    bool cached = baked ? MeshCache::openFile(modelPath, data->cache) : MeshCache::open(modelPath, vertexFormat, data->cache);
+
+    if (baked && !cached)
+    {
+        throw std::runtime_error("failed to open baked mesh " + modelPath);
+    }
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, modelPath.c_str()))
+    if (cached)
     {
-        throw std::runtime_error(warn + err);
+        // warm start, the mapped arrays go straight into staging memory
+        MeshCache::readMesh(data->cache, mesh);
     }
+    else
+    {
+        data->imported = true;
+        data->importStats = MeshImport::importObj(modelPath, threadPool, data->scratch, data->importedVertices, data->importedIndices, mesh.submeshes, mesh.materials, mesh.lods, mesh.dependencies);
+        MeshImport::encode(vertexFormat, data->importedVertices.data(), data->importedVertices.size(), data->importedIndices.data(), data->importedIndices.size(), mesh, data->scratch, threadPool);
 
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+        MeshCache::write(modelPath, mesh);
+    }
 
-    for (const auto& shape : shapes)
+    // a mesh baked in another format than the one the renderer draws with, because the compact vertex shader is
+    // missing, is decoded and encoded again
+    if (mesh.vertexFormat != vertexFormat)
     {
-        for (const auto& index : shape.mesh.indices)
+        const Vertex* vertices = static_cast<const Vertex*>(mesh.vertexData);
+        const uint32_t* indices = static_cast<const uint32_t*>(mesh.indexData);
+
+        if (mesh.vertexFormat != VertexFormat::Full)
         {
-            Vertex vertex{};
-
-            vertex.pos =
-            {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2],
-            };
-
-            vertex.normal =
-            {
-                attrib.normals[3 * index.normal_index + 0],
-                attrib.normals[3 * index.normal_index + 1],
-                attrib.normals[3 * index.normal_index + 2],
-            };
-
-            vertex.texCoord =
-            {
-                attrib.texcoords[2 * index.texcoord_index + 0],
-                1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-            };
-
-            vertex.color = { 1.0f, 1.0f, 1.0f };
-
-
-            if (uniqueVertices.count(vertex) == 0)
-            {
-                uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                vertices.push_back(vertex);
-            }
-            indices.push_back(uniqueVertices[vertex]);
+            Vertex* decoded = data->scratch.allocate<Vertex>(mesh.vertexCount);
+            VertexEncoding::decodeVertices(mesh.vertexFormat, static_cast<const CompactVertex*>(mesh.vertexData), mesh.vertexCount, mesh.vertexTransform, decoded, threadPool);
+            vertices = decoded;
         }
-    }
 
-    createVertexBuffer(device, physicalDevice, graphicsQueue, commandPool);
-    createIndexBuffer(device, physicalDevice, graphicsQueue, commandPool);
-}
+        if (mesh.indexType == VK_INDEX_TYPE_UINT16)
+        {
+            uint32_t* widened = data->scratch.allocate<uint32_t>(mesh.indexCount);
+            VertexEncoding::decodeIndices16(static_cast<const uint16_t*>(mesh.indexData), mesh.indexCount, widened);
+            indices = widened;
+        }
 
-void Model::destroyModel()
-{
-    vkDestroyBuffer(*pDevice, indexBuffer, nullptr);
-    vkFreeMemory(*pDevice, indexBufferMemory, nullptr);
+        MeshImport::encode(vertexFormat, vertices, mesh.vertexCount, indices, mesh.indexCount, mesh, data->scratch, threadPool);
+    }
 
-    vkDestroyBuffer(*pDevice, vertexBuffer, nullptr);
-    vkFreeMemory(*pDevice, vertexBufferMemory, nullptr);
+    return data;
 }
 
-void Model::createVertexBuffer(VkDevice& device, VkPhysicalDevice& physicalDevice, VkQueue& graphicsQueue, VkCommandPool& commandPool)
+uint32_t Model::selectLod(float distance, float pixelsPerUnit, float maxPixelError, float hysteresis)
 {
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+    float scale = pixelsPerUnit / std::max(distance, 1e-4f);
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    Buffer::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, device, physicalDevice);
+    uint32_t lod = 0;
+    while (lod + 1 < lods.size() && lods[lod + 1].error * scale <= maxPixelError)
+    {
+        lod++;
+    }
 
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
+    // finer levels are taken right away, coarser ones need the margin
+    while (lod > currentLod && lods[lod].error * scale > maxPixelError * (1.0f - hysteresis))
+    {
+        lod--;
+    }
 
-    Buffer::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory, device, physicalDevice);
+    currentLod = lod;
 
-    Buffer::copyBuffer(stagingBuffer, vertexBuffer, bufferSize, graphicsQueue, commandPool, device);
+    return currentLod;
+}
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+// the arena range is only handed back once no frame in flight can still be drawing from it
+void Model::destroyModel()
+{
+    GeometryArena* geometryArena = pGeometryArena;
+    GeometryRange range = geometry;
+
+    pDeletionQueue->push([=]() mutable
+    {
+        geometryArena->free(range);
+    });
 
-    pDevice = &device;
+    geometry = GeometryRange{};
 }
 
-void Model::createIndexBuffer(VkDevice& device, VkPhysicalDevice& physicalDevice, VkQueue& graphicsQueue, VkCommandPool& commandPool)
+void Model::createVertexBuffer(UploadContext& uploadContext, const void* vertexData, size_t vertexCount)
 {
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+    VkDeviceSize bufferSize = static_cast<VkDeviceSize>(pGeometryArena->vertexStride) * vertexCount;
+    VkDeviceSize bufferOffset = pGeometryArena->getVertexByteOffset(geometry);
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    Buffer::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, device, physicalDevice);
+    VkBuffer buffer = pGeometryArena->getVertexBuffer(geometry);
 
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
+    uploadContext.uploadBuffer(vertexData, bufferSize, buffer, bufferOffset);
+    uploadContext.releaseBuffer(buffer, bufferOffset, bufferSize, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+}
 
-    Buffer::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory, device, physicalDevice);
+void Model::createIndexBuffer(UploadContext& uploadContext, const void* indexData, size_t indexCount)
+{
+    VkDeviceSize bufferSize = static_cast<VkDeviceSize>(VertexEncoding::getIndexSize(geometry.indexType)) * indexCount;
+    VkDeviceSize bufferOffset = pGeometryArena->getIndexByteOffset(geometry);
 
-    Buffer::copyBuffer(stagingBuffer, indexBuffer, bufferSize, graphicsQueue, commandPool, device);
+    VkBuffer buffer = pGeometryArena->getIndexBuffer(geometry);
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    uploadContext.uploadBuffer(indexData, bufferSize, buffer, bufferOffset);
+    uploadContext.releaseBuffer(buffer, bufferOffset, bufferSize, VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 }
 
 #endif // MODEL_H
@@ -0,0 +1,91 @@
+#ifndef OBJ_BENCHMARK_H
+#define OBJ_BENCHMARK_H
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "ObjParser.h"
+#include "ThreadPool.h"
+
+// times the parallel parser against tinyobj on one file and checks both produce the same mesh.
+// run with: LearnVulkan --bench-obj <path>
+namespace ObjBenchmark
+{
+    const int OBJ_BENCHMARK_RUNS = 3;
+
+    template<typename T>
+    static bool sameArray(const std::vector<T>& a, const std::vector<T>& b)
+    {
+        return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+    }
+
+    // best of a few runs, the first one also pays for the file cache
+    template<typename F>
+    static double timeBest(F&& load)
+    {
+        double best = 0.0;
+
+        for (int i = 0; i < OBJ_BENCHMARK_RUNS; i++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            load();
+            auto end = std::chrono::high_resolution_clock::now();
+
+            double seconds = std::chrono::duration<double>(end - start).count();
+            best = (i == 0 || seconds < best) ? seconds : best;
+        }
+
+        return best;
+    }
+
+    static int run(const std::string& path)
+    {
+        ThreadPool threadPool;
+
+        double megabytes = 0.0;
+        {
+            MappedFile file(path);
+            megabytes = file.size / (1024.0 * 1024.0);
+        }
+
+        ObjMesh reference;
+        double referenceSeconds = timeBest([&]()
+        {
+            reference = ObjMesh{};
+            ObjParser::loadObjReference(path, reference);
+        });
+
+        ObjMesh parsed;
+        bool supported = true;
+        double parsedSeconds = timeBest([&]()
+        {
+            parsed = ObjMesh{};
+            supported = ObjParser::loadObj(path, parsed, threadPool);
+        });
+
+        std::cout << path << " (" << megabytes << " MB, " << reference.indices.size() / 3 << " triangles)" << std::endl;
+        std::cout << "tinyobj:        " << referenceSeconds * 1000.0 << " ms, " << megabytes / referenceSeconds << " MB/s" << std::endl;
+
+        if (!supported)
+        {
+            std::cout << "parallel parser: file has polygons with more than four corners, loads fall back to tinyobj" << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        std::cout << "parallel parser: " << parsedSeconds * 1000.0 << " ms, " << megabytes / parsedSeconds << " MB/s on "
+            << threadPool.getThreadCount() + 1 << " threads (" << referenceSeconds / parsedSeconds << "x)" << std::endl;
+
+        bool identical = sameArray(reference.positions, parsed.positions)
+            && sameArray(reference.normals, parsed.normals)
+            && sameArray(reference.texcoords, parsed.texcoords)
+            && sameArray(reference.indices, parsed.indices);
+
+        std::cout << (identical ? "outputs are identical" : "outputs differ") << std::endl;
+
+        return identical ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+};
+
+#endif // OBJ_BENCHMARK_H
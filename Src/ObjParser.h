@@ -0,0 +1,990 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "Submesh.h"
+
+#include "tiny_obj_loader.h"
+
+struct ObjIndex
+{
+    int vertexIndex;
+    int normalIndex; // -1 when the face has none
+    int texcoordIndex;
+};
+
+// attribute arrays as they appear in the file plus the triangulated corners of every face in file order,
+// the same data Model used to gather from tinyobj's attrib_t and shape list. submeshes split the corners
+// wherever the shape (g or o) or the material (usemtl) changes
+struct ObjMesh
+{
+    std::vector<float> positions; // xyz
+    std::vector<float> normals; // xyz
+    std::vector<float> texcoords; // uv
+
+    std::vector<ObjIndex> indices;
+
+    std::vector<Submesh> submeshes;
+    std::vector<MeshMaterial> materials;
+
+    // the .mtl files the mesh depends on, the one every mtllib line resolved to or its first candidate when none
+    // could be opened, so creating it later is noticed as well
+    std::vector<std::string> materialFiles;
+};
+
+// the file is memory mapped, cut into chunks at line boundaries and every chunk is parsed on the thread pool.
+// numbers are parsed with the same arithmetic tinyobj uses so the result matches LoadObj bit for bit
+namespace ObjParser
+{
+    // files smaller than this are not worth splitting
+    const size_t OBJ_CHUNK_SIZE = 1024 * 1024;
+
+    // a g, o or usemtl line, corner is the number of triangle corners the chunk emitted before it
+    struct ChunkEvent
+    {
+        size_t corner;
+        bool newShape;
+        bool setsMaterial;
+        std::string materialName;
+    };
+
+    struct Chunk
+    {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+
+        std::vector<ChunkEvent> events;
+        std::vector<std::string> materialLibraries; // mtllib lines, every one may list several candidate files
+
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<float> texcoords;
+
+        std::vector<ObjIndex> corners;
+        std::vector<uint32_t> faceSizes;
+
+        // negative indices are relative to the attribute count at that line, they are stored relative to the
+        // chunk and listed here (corner * 3 + component) to be rebased once every chunk's counts are known
+        std::vector<size_t> relativeCorners;
+
+        size_t triangleCorners = 0;
+        bool needsReference = false;
+        bool hasInvalidCorners = false; // an index past the end of its attribute array, set while triangulating
+
+        // offsets of this chunk in the merged mesh
+        size_t positionBase = 0;
+        size_t normalBase = 0;
+        size_t texcoordBase = 0;
+        size_t indexBase = 0;
+    };
+
+    // same algorithm as tinyobj's tryParseDouble, including its rounding
+    static bool parseDouble(const char* s, const char* end, double& result)
+    {
+        if (s >= end)
+        {
+            return false;
+        }
+
+        double mantissa = 0.0;
+        int exponent = 0;
+
+        char sign = '+';
+        char exponentSign = '+';
+        const char* current = s;
+
+        int read = 0;
+        bool leadingDot = false;
+
+        if (*current == '+' || *current == '-')
+        {
+            sign = *current;
+            current++;
+            if (current != end && *current == '.')
+            {
+                leadingDot = true;
+            }
+        }
+        else if (*current == '.')
+        {
+            leadingDot = true;
+        }
+        else if (static_cast<unsigned int>(*current - '0') >= 10)
+        {
+            return false;
+        }
+
+        if (!leadingDot)
+        {
+            while (current != end && static_cast<unsigned int>(*current - '0') < 10)
+            {
+                mantissa *= 10;
+                mantissa += static_cast<int>(*current - '0');
+                current++;
+                read++;
+            }
+
+            if (read == 0)
+            {
+                return false;
+            }
+        }
+
+        if (current != end && *current == '.')
+        {
+            static const double powers[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+            const int powerCount = sizeof(powers) / sizeof(powers[0]);
+
+            current++;
+            read = 1;
+
+            while (current != end && static_cast<unsigned int>(*current - '0') < 10)
+            {
+                mantissa += static_cast<int>(*current - '0') * (read < powerCount ? powers[read] : std::pow(10.0, -read));
+                read++;
+                current++;
+            }
+        }
+
+        if (current != end && (*current == 'e' || *current == 'E'))
+        {
+            current++;
+
+            if (current != end && (*current == '+' || *current == '-'))
+            {
+                exponentSign = *current;
+                current++;
+            }
+            else if (current == end || static_cast<unsigned int>(*current - '0') >= 10)
+            {
+                return false;
+            }
+
+            read = 0;
+            while (current != end && static_cast<unsigned int>(*current - '0') < 10)
+            {
+                if (exponent > 2147483647 / 10)
+                {
+                    return false;
+                }
+
+                exponent *= 10;
+                exponent += static_cast<int>(*current - '0');
+                current++;
+                read++;
+            }
+
+            exponent *= (exponentSign == '+' ? 1 : -1);
+
+            if (read == 0)
+            {
+                return false;
+            }
+        }
+
+        result = (sign == '+' ? 1 : -1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+        return true;
+    }
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    // reads the next whitespace separated number, missing or malformed numbers give defaultValue like in tinyobj
+    static float parseFloat(const char*& token, const char* end, double defaultValue = 0.0)
+    {
+        while (token != end && isSpace(*token))
+        {
+            token++;
+        }
+
+        const char* numberEnd = token;
+        while (numberEnd != end && !isSpace(*numberEnd) && *numberEnd != '\r')
+        {
+            numberEnd++;
+        }
+
+        double value = defaultValue;
+        parseDouble(token, numberEnd, value);
+
+        token = numberEnd;
+        return static_cast<float>(value);
+    }
+
+    // atoi semantics, the token is not advanced
+    static int parseInt(const char* token, const char* end)
+    {
+        while (token != end && (isSpace(*token) || *token == '\r' || *token == '\v' || *token == '\f'))
+        {
+            token++;
+        }
+
+        bool negative = false;
+        if (token != end && (*token == '+' || *token == '-'))
+        {
+            negative = *token == '-';
+            token++;
+        }
+
+        int value = 0;
+        while (token != end && static_cast<unsigned int>(*token - '0') < 10)
+        {
+            value = value * 10 + (*token - '0');
+            token++;
+        }
+
+        return negative ? -value : value;
+    }
+
+    // the next whitespace separated word, like tinyobj's parseString
+    static std::string parseName(const char*& token, const char* end)
+    {
+        while (token != end && isSpace(*token))
+        {
+            token++;
+        }
+
+        const char* nameBegin = token;
+        while (token != end && !isSpace(*token) && *token != '\r')
+        {
+            token++;
+        }
+
+        return std::string(nameBegin, token);
+    }
+
+    static void skipIndex(const char*& token, const char* end)
+    {
+        while (token != end && *token != '/' && !isSpace(*token) && *token != '\r')
+        {
+            token++;
+        }
+    }
+
+    // same rules as tinyobj's fixIndex, relative indices are kept relative to the chunk for now
+    static bool fixIndex(int index, int chunkCount, bool allowZero, int& result, bool& relative)
+    {
+        relative = false;
+
+        if (index > 0)
+        {
+            result = index - 1;
+            return true;
+        }
+
+        if (index == 0)
+        {
+            result = -1;
+            return allowZero;
+        }
+
+        result = chunkCount + index;
+        relative = true;
+        return true;
+    }
+
+    static void parseFace(const char* token, const char* end, Chunk& chunk)
+    {
+        uint32_t cornerCount = 0;
+
+        int positionCount = static_cast<int>(chunk.positions.size() / 3);
+        int normalCount = static_cast<int>(chunk.normals.size() / 3);
+        int texcoordCount = static_cast<int>(chunk.texcoords.size() / 2);
+
+        while (token != end && *token != '\r')
+        {
+            ObjIndex corner{ -1, -1, -1 };
+            bool relative[3] = { false, false, false };
+            bool valid = fixIndex(parseInt(token, end), positionCount, false, corner.vertexIndex, relative[0]);
+
+            skipIndex(token, end);
+
+            if (valid && token != end && *token == '/')
+            {
+                token++;
+
+                if (token != end && *token == '/')
+                {
+                    // i//k
+                    token++;
+                    valid = fixIndex(parseInt(token, end), normalCount, true, corner.normalIndex, relative[2]);
+                    skipIndex(token, end);
+                }
+                else
+                {
+                    // i/j or i/j/k
+                    valid = fixIndex(parseInt(token, end), texcoordCount, true, corner.texcoordIndex, relative[1]);
+                    skipIndex(token, end);
+
+                    if (valid && token != end && *token == '/')
+                    {
+                        token++;
+                        valid = fixIndex(parseInt(token, end), normalCount, true, corner.normalIndex, relative[2]);
+                        skipIndex(token, end);
+                    }
+                }
+            }
+
+            if (!valid)
+            {
+                throw std::runtime_error("failed to parse obj face, zero vertex index");
+            }
+
+            for (size_t component = 0; component < 3; component++)
+            {
+                if (relative[component])
+                {
+                    chunk.relativeCorners.push_back(chunk.corners.size() * 3 + component);
+                }
+            }
+
+            chunk.corners.push_back(corner);
+            cornerCount++;
+
+            while (token != end && (isSpace(*token) || *token == '\r'))
+            {
+                token++;
+            }
+        }
+
+        // LoadObj drops degenerate faces, quads are split by the shorter diagonal after merging and
+        // anything bigger goes through tinyobj's ear clipping
+        if (cornerCount == 3)
+        {
+            chunk.triangleCorners += 3;
+        }
+        else if (cornerCount == 4)
+        {
+            chunk.triangleCorners += 6;
+        }
+        else if (cornerCount > 4)
+        {
+            chunk.needsReference = true;
+        }
+
+        chunk.faceSizes.push_back(cornerCount);
+    }
+
+    static void parseLine(const char* token, const char* end, Chunk& chunk)
+    {
+        while (token != end && isSpace(*token))
+        {
+            token++;
+        }
+
+        if (end - token < 2 || token[0] == '#')
+        {
+            return;
+        }
+
+        if (token[0] == 'v' && isSpace(token[1]))
+        {
+            token += 2;
+            chunk.positions.push_back(parseFloat(token, end));
+            chunk.positions.push_back(parseFloat(token, end));
+            chunk.positions.push_back(parseFloat(token, end));
+        }
+        else if (token[0] == 'v' && token[1] == 'n' && end - token > 2 && isSpace(token[2]))
+        {
+            token += 3;
+            chunk.normals.push_back(parseFloat(token, end));
+            chunk.normals.push_back(parseFloat(token, end));
+            chunk.normals.push_back(parseFloat(token, end));
+        }
+        else if (token[0] == 'v' && token[1] == 't' && end - token > 2 && isSpace(token[2]))
+        {
+            token += 3;
+            chunk.texcoords.push_back(parseFloat(token, end));
+            chunk.texcoords.push_back(parseFloat(token, end));
+        }
+        else if (token[0] == 'f' && isSpace(token[1]))
+        {
+            token += 2;
+            while (token != end && isSpace(*token))
+            {
+                token++;
+            }
+
+            parseFace(token, end, chunk);
+        }
+        else if ((token[0] == 'g' || token[0] == 'o') && isSpace(token[1]))
+        {
+            chunk.events.push_back({ chunk.triangleCorners, true, false, std::string() });
+        }
+        else if (end - token > 6 && strncmp(token, "usemtl", 6) == 0 && isSpace(token[6]))
+        {
+            token += 7;
+            chunk.events.push_back({ chunk.triangleCorners, false, true, parseName(token, end) });
+        }
+        else if (end - token > 6 && strncmp(token, "mtllib", 6) == 0 && isSpace(token[6]))
+        {
+            chunk.materialLibraries.push_back(std::string(token + 7, end));
+        }
+
+        // smoothing groups, lines and points do not change the triangle list
+    }
+
+    // lines end at \n, \r\n or a lone \r like in tinyobj's safeGetline
+    static void parseChunk(Chunk& chunk)
+    {
+        const char* line = chunk.begin;
+
+        while (line < chunk.end)
+        {
+            const char* lineEnd = line;
+            while (lineEnd < chunk.end && *lineEnd != '\n' && *lineEnd != '\r')
+            {
+                lineEnd++;
+            }
+
+            parseLine(line, lineEnd, chunk);
+
+            line = lineEnd;
+            if (line < chunk.end && *line == '\r')
+            {
+                line++;
+            }
+            if (line < chunk.end && *line == '\n')
+            {
+                line++;
+            }
+        }
+    }
+
+    static void rebaseChunk(Chunk& chunk)
+    {
+        for (size_t relativeCorner : chunk.relativeCorners)
+        {
+            ObjIndex& corner = chunk.corners[relativeCorner / 3];
+
+            switch (relativeCorner % 3)
+            {
+            case 0:
+                corner.vertexIndex += static_cast<int>(chunk.positionBase);
+                if (corner.vertexIndex < 0)
+                {
+                    throw std::runtime_error("invalid relative vertex index in obj");
+                }
+                break;
+            case 1:
+                corner.texcoordIndex += static_cast<int>(chunk.texcoordBase);
+                if (corner.texcoordIndex < 0)
+                {
+                    throw std::runtime_error("invalid relative texcoord index in obj");
+                }
+                break;
+            case 2:
+                corner.normalIndex += static_cast<int>(chunk.normalBase);
+                if (corner.normalIndex < 0)
+                {
+                    throw std::runtime_error("invalid relative normal index in obj");
+                }
+                break;
+            }
+        }
+    }
+
+    static bool isInRange(int index, size_t count)
+    {
+        return index >= 0 && static_cast<size_t>(index) < count;
+    }
+
+    // faces pointing past the end of the positions still take their corners, marked invalid, and are dropped by
+    // removeInvalidFaces, so the chunk offsets computed while parsing stay valid
+    static void triangulateChunk(Chunk& chunk, ObjMesh& mesh)
+    {
+        const std::vector<float>& v = mesh.positions;
+        size_t vertexCount = v.size() / 3;
+        size_t normalCount = mesh.normals.size() / 3;
+        size_t texcoordCount = mesh.texcoords.size() / 2;
+
+        const ObjIndex* corners = chunk.corners.data();
+        ObjIndex* output = mesh.indices.data() + chunk.indexBase;
+
+        for (uint32_t faceSize : chunk.faceSizes)
+        {
+            bool valid = true;
+
+            for (uint32_t i = 0; i < faceSize; i++)
+            {
+                valid = valid && isInRange(corners[i].vertexIndex, vertexCount);
+
+                if ((corners[i].normalIndex >= 0 && !isInRange(corners[i].normalIndex, normalCount))
+                    || (corners[i].texcoordIndex >= 0 && !isInRange(corners[i].texcoordIndex, texcoordCount)))
+                {
+                    chunk.hasInvalidCorners = true;
+                }
+            }
+
+            if (!valid)
+            {
+                chunk.hasInvalidCorners = true;
+            }
+
+            if (!valid)
+            {
+                // LoadObj drops the whole face, not only the triangles touching the missing position
+                size_t triangleCorners = faceSize == 3 ? 3 : (faceSize == 4 ? 6 : 0);
+
+                for (size_t i = 0; i < triangleCorners; i++)
+                {
+                    *output++ = { -1, -1, -1 };
+                }
+            }
+            else if (faceSize == 3)
+            {
+                *output++ = corners[0];
+                *output++ = corners[1];
+                *output++ = corners[2];
+            }
+            else if (faceSize == 4)
+            {
+                size_t vi0 = corners[0].vertexIndex;
+                size_t vi1 = corners[1].vertexIndex;
+                size_t vi2 = corners[2].vertexIndex;
+                size_t vi3 = corners[3].vertexIndex;
+
+                float e02x = v[vi2 * 3 + 0] - v[vi0 * 3 + 0];
+                float e02y = v[vi2 * 3 + 1] - v[vi0 * 3 + 1];
+                float e02z = v[vi2 * 3 + 2] - v[vi0 * 3 + 2];
+                float e13x = v[vi3 * 3 + 0] - v[vi1 * 3 + 0];
+                float e13y = v[vi3 * 3 + 1] - v[vi1 * 3 + 1];
+                float e13z = v[vi3 * 3 + 2] - v[vi1 * 3 + 2];
+
+                float sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+                float sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+
+                if (sqr02 < sqr13)
+                {
+                    *output++ = corners[0];
+                    *output++ = corners[1];
+                    *output++ = corners[2];
+
+                    *output++ = corners[0];
+                    *output++ = corners[2];
+                    *output++ = corners[3];
+                }
+                else
+                {
+                    *output++ = corners[0];
+                    *output++ = corners[1];
+                    *output++ = corners[3];
+
+                    *output++ = corners[1];
+                    *output++ = corners[2];
+                    *output++ = corners[3];
+                }
+            }
+
+            corners += faceSize;
+        }
+    }
+
+    // gives every chunk its offset into the merged array and sizes the array
+    static void layoutChunks(std::vector<Chunk>& chunks, std::vector<float> Chunk::* member, size_t Chunk::* base, std::vector<float>& output)
+    {
+        size_t total = 0;
+        for (Chunk& chunk : chunks)
+        {
+            chunk.*base = total;
+            total += (chunk.*member).size();
+        }
+
+        output.resize(total);
+    }
+
+    // texture paths in a .mtl are relative to the directory of the obj
+    static MeshMaterial toMeshMaterial(const tinyobj::material_t& material, const std::filesystem::path& directory)
+    {
+        auto resolve = [&](const std::string& texture)
+        {
+            return texture.empty() ? std::string() : (directory / texture).lexically_normal().generic_string();
+        };
+
+        MeshMaterial meshMaterial;
+        meshMaterial.name = material.name;
+        meshMaterial.baseColorPath = resolve(material.diffuse_texname);
+
+        // map_Pr when the pbr extension is used, otherwise the specular exponent map is the closest thing
+        meshMaterial.roughnessPath = resolve(!material.roughness_texname.empty() ? material.roughness_texname : material.specular_highlight_texname);
+
+        return meshMaterial;
+    }
+
+    // extends the last submesh when the run continues it, empty runs are dropped
+    static void appendSubmesh(std::vector<Submesh>& submeshes, size_t begin, size_t end, uint32_t materialIndex, uint32_t shapeIndex)
+    {
+        if (end == begin)
+        {
+            return;
+        }
+
+        if (!submeshes.empty())
+        {
+            Submesh& last = submeshes.back();
+
+            if (last.materialIndex == materialIndex && last.shapeIndex == shapeIndex && last.firstIndex + last.indexCount == begin)
+            {
+                last.indexCount += static_cast<uint32_t>(end - begin);
+                return;
+            }
+        }
+
+        submeshes.push_back({ static_cast<uint32_t>(begin), static_cast<uint32_t>(end - begin), materialIndex, shapeIndex });
+    }
+
+    // the file every mtllib line resolves to, the first candidate that opens like in tinyobj. a line naming a file
+    // that an earlier line already resolved to adds nothing
+    static std::vector<std::string> findMaterialFiles(const std::vector<std::string>& libraryLines, const std::filesystem::path& directory)
+    {
+        std::vector<std::string> files;
+
+        for (const std::string& line : libraryLines)
+        {
+            std::vector<std::string> candidates;
+            const char* token = line.data();
+            const char* end = token + line.size();
+
+            for (std::string name = parseName(token, end); !name.empty(); name = parseName(token, end))
+            {
+                candidates.push_back((directory / name).lexically_normal().generic_string());
+            }
+
+            if (candidates.empty())
+            {
+                continue;
+            }
+
+            std::string file = candidates[0];
+
+            for (const std::string& candidate : candidates)
+            {
+                if (std::find(files.begin(), files.end(), candidate) != files.end() || std::ifstream(candidate))
+                {
+                    file = candidate;
+                    break;
+                }
+            }
+
+            if (std::find(files.begin(), files.end(), file) == files.end())
+            {
+                files.push_back(file);
+            }
+        }
+
+        return files;
+    }
+
+    // loads every library the mtllib lines name
+    static std::map<std::string, int> loadMaterials(const std::vector<Chunk>& chunks, const std::filesystem::path& directory, ObjMesh& mesh)
+    {
+        std::map<std::string, int> materialMap;
+        std::vector<tinyobj::material_t> materials;
+        std::vector<std::string> libraryLines;
+
+        for (const Chunk& chunk : chunks)
+        {
+            libraryLines.insert(libraryLines.end(), chunk.materialLibraries.begin(), chunk.materialLibraries.end());
+        }
+
+        mesh.materialFiles = findMaterialFiles(libraryLines, directory);
+
+        for (const std::string& file : mesh.materialFiles)
+        {
+            std::ifstream stream(file);
+            if (stream)
+            {
+                std::string warn, err;
+                tinyobj::LoadMtl(&materialMap, &materials, &stream, &warn, &err);
+            }
+        }
+
+        mesh.materials.clear();
+        for (const tinyobj::material_t& material : materials)
+        {
+            mesh.materials.push_back(toMeshMaterial(material, directory));
+        }
+
+        return materialMap;
+    }
+
+    // what LoadObj makes of faces with indices past the end of the file's arrays: faces whose positions are missing
+    // are dropped, a shape left without faces goes with them, and a missing normal or texcoord is left out of the
+    // corner. LoadObj itself only drops such quads and hands triangles on, which would read past the positions
+    static void removeInvalidFaces(ObjMesh& mesh)
+    {
+        size_t vertexCount = mesh.positions.size() / 3;
+        size_t normalCount = mesh.normals.size() / 3;
+        size_t texcoordCount = mesh.texcoords.size() / 2;
+
+        std::vector<Submesh> submeshes;
+        size_t written = 0;
+        uint32_t shapeIndex = 0;
+        uint32_t lastShape = SUBMESH_NO_MATERIAL;
+
+        for (const Submesh& submesh : mesh.submeshes)
+        {
+            size_t begin = written;
+
+            for (size_t i = submesh.firstIndex; i < submesh.firstIndex + submesh.indexCount; i += 3)
+            {
+                ObjIndex* triangle = &mesh.indices[i];
+
+                if (!isInRange(triangle[0].vertexIndex, vertexCount) || !isInRange(triangle[1].vertexIndex, vertexCount)
+                    || !isInRange(triangle[2].vertexIndex, vertexCount))
+                {
+                    continue;
+                }
+
+                for (size_t corner = 0; corner < 3; corner++)
+                {
+                    ObjIndex index = triangle[corner];
+                    index.normalIndex = isInRange(index.normalIndex, normalCount) ? index.normalIndex : -1;
+                    index.texcoordIndex = isInRange(index.texcoordIndex, texcoordCount) ? index.texcoordIndex : -1;
+                    mesh.indices[written++] = index;
+                }
+            }
+
+            if (written == begin)
+            {
+                continue;
+            }
+
+            if (lastShape != SUBMESH_NO_MATERIAL && submesh.shapeIndex != lastShape)
+            {
+                shapeIndex++;
+            }
+            lastShape = submesh.shapeIndex;
+
+            appendSubmesh(submeshes, begin, written, submesh.materialIndex, shapeIndex);
+        }
+
+        mesh.indices.resize(written);
+        mesh.submeshes = std::move(submeshes);
+    }
+
+    // walks the g, o and usemtl lines of every chunk in file order. a new shape only starts at a g or o line once the
+    // previous one has faces, which is when tinyobj starts a new shape_t as well. a usemtl line only starts a new
+    // submesh, LoadObj adds the faces after it to the same shape_t with their own material id
+    static void buildSubmeshes(const std::vector<Chunk>& chunks, const std::map<std::string, int>& materialMap, ObjMesh& mesh)
+    {
+        mesh.submeshes.clear();
+
+        uint32_t shapeIndex = 0;
+        uint32_t materialIndex = SUBMESH_NO_MATERIAL;
+        size_t shapeBegin = 0;
+        size_t runBegin = 0;
+
+        for (const Chunk& chunk : chunks)
+        {
+            for (const ChunkEvent& event : chunk.events)
+            {
+                size_t corner = chunk.indexBase + event.corner;
+
+                if (event.newShape)
+                {
+                    if (corner > shapeBegin)
+                    {
+                        appendSubmesh(mesh.submeshes, runBegin, corner, materialIndex, shapeIndex);
+                        runBegin = shapeBegin = corner;
+                        shapeIndex++;
+                    }
+
+                    continue;
+                }
+
+                auto it = materialMap.find(event.materialName);
+                uint32_t nextMaterial = it != materialMap.end() ? static_cast<uint32_t>(it->second) : SUBMESH_NO_MATERIAL;
+
+                if (nextMaterial != materialIndex)
+                {
+                    appendSubmesh(mesh.submeshes, runBegin, corner, materialIndex, shapeIndex);
+                    runBegin = corner;
+                    materialIndex = nextMaterial;
+                }
+            }
+        }
+
+        appendSubmesh(mesh.submeshes, runBegin, mesh.indices.size(), materialIndex, shapeIndex);
+    }
+
+    // tinyobj loader, kept for files using features the parallel parser does not cover and as the benchmark reference
+    static void loadObjReference(const std::string& path, ObjMesh& mesh)
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+
+        std::filesystem::path directory = std::filesystem::path(path).parent_path();
+        std::string materialDirectory = directory.string();
+
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str(), materialDirectory.empty() ? nullptr : materialDirectory.c_str()))
+        {
+            throw std::runtime_error(warn + err);
+        }
+
+        mesh.positions = std::move(attrib.vertices);
+        mesh.normals = std::move(attrib.normals);
+        mesh.texcoords = std::move(attrib.texcoords);
+
+        mesh.materials.clear();
+        for (const tinyobj::material_t& material : materials)
+        {
+            mesh.materials.push_back(toMeshMaterial(material, directory));
+        }
+
+        // tinyobj does not say which files it read, the mtllib lines are found again
+        std::vector<std::string> libraryLines;
+        std::ifstream file(path);
+        std::string line;
+
+        while (std::getline(file, line))
+        {
+            size_t begin = line.find_first_not_of(" \t");
+
+            if (begin != std::string::npos && line.compare(begin, 6, "mtllib") == 0 && line.size() > begin + 6 && isSpace(line[begin + 6]))
+            {
+                libraryLines.push_back(line.substr(begin + 7));
+            }
+        }
+
+        mesh.materialFiles = findMaterialFiles(libraryLines, directory);
+
+        mesh.indices.clear();
+        mesh.submeshes.clear();
+
+        for (size_t shape = 0; shape < shapes.size(); shape++)
+        {
+            const tinyobj::mesh_t& shapeMesh = shapes[shape].mesh;
+
+            for (size_t triangle = 0; triangle * 3 < shapeMesh.indices.size(); triangle++)
+            {
+                int material = triangle < shapeMesh.material_ids.size() ? shapeMesh.material_ids[triangle] : -1;
+                uint32_t materialIndex = material >= 0 ? static_cast<uint32_t>(material) : SUBMESH_NO_MATERIAL;
+
+                size_t begin = mesh.indices.size();
+
+                for (size_t corner = 0; corner < 3; corner++)
+                {
+                    const tinyobj::index_t& index = shapeMesh.indices[triangle * 3 + corner];
+                    mesh.indices.push_back({ index.vertex_index, index.normal_index, index.texcoord_index });
+                }
+
+                appendSubmesh(mesh.submeshes, begin, mesh.indices.size(), materialIndex, static_cast<uint32_t>(shape));
+            }
+        }
+
+        removeInvalidFaces(mesh);
+    }
+
+    // returns false when the file has polygons with more than four corners, the caller should use loadObjReference then
+    static bool loadObj(const std::string& path, ObjMesh& mesh, ThreadPool& threadPool)
+    {
+        MappedFile file(path);
+
+        size_t chunkCount = file.size / OBJ_CHUNK_SIZE;
+        size_t maxChunks = static_cast<size_t>(threadPool.getThreadCount() + 1) * 4;
+        chunkCount = chunkCount < 1 ? 1 : (chunkCount > maxChunks ? maxChunks : chunkCount);
+
+        std::vector<Chunk> chunks(chunkCount);
+
+        // every chunk but the first starts right after a line break
+        const char* fileEnd = file.data + file.size;
+        const char* begin = file.data;
+
+        for (size_t i = 0; i < chunkCount; i++)
+        {
+            const char* end = i + 1 == chunkCount ? fileEnd : file.data + file.size * (i + 1) / chunkCount;
+
+            if (end < begin)
+            {
+                end = begin;
+            }
+
+            while (end < fileEnd && end[-1] != '\n')
+            {
+                end++;
+            }
+
+            chunks[i].begin = begin;
+            chunks[i].end = end;
+            begin = end;
+        }
+
+        threadPool.parallelFor(chunkCount, [&](size_t i)
+        {
+            parseChunk(chunks[i]);
+        });
+
+        for (const Chunk& chunk : chunks)
+        {
+            if (chunk.needsReference)
+            {
+                return false;
+            }
+        }
+
+        layoutChunks(chunks, &Chunk::positions, &Chunk::positionBase, mesh.positions);
+        layoutChunks(chunks, &Chunk::normals, &Chunk::normalBase, mesh.normals);
+        layoutChunks(chunks, &Chunk::texcoords, &Chunk::texcoordBase, mesh.texcoords);
+
+        size_t indexCount = 0;
+        for (Chunk& chunk : chunks)
+        {
+            chunk.indexBase = indexCount;
+            indexCount += chunk.triangleCorners;
+        }
+        mesh.indices.resize(indexCount);
+
+        threadPool.parallelFor(chunkCount, [&](size_t i)
+        {
+            Chunk& chunk = chunks[i];
+
+            std::copy(chunk.positions.begin(), chunk.positions.end(), mesh.positions.begin() + chunk.positionBase);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), mesh.normals.begin() + chunk.normalBase);
+            std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), mesh.texcoords.begin() + chunk.texcoordBase);
+
+            // the bases so far are float offsets, relative indices count whole attributes
+            chunk.positionBase /= 3;
+            chunk.normalBase /= 3;
+            chunk.texcoordBase /= 2;
+
+            rebaseChunk(chunk);
+        });
+
+        // quads look at the positions, so every chunk has to be merged before triangulating
+        threadPool.parallelFor(chunkCount, [&](size_t i)
+        {
+            triangulateChunk(chunks[i], mesh);
+        });
+
+        std::map<std::string, int> materialMap = loadMaterials(chunks, std::filesystem::path(path).parent_path(), mesh);
+        buildSubmeshes(chunks, materialMap, mesh);
+
+        for (const Chunk& chunk : chunks)
+        {
+            if (chunk.hasInvalidCorners)
+            {
+                removeInvalidFaces(mesh);
+                break;
+            }
+        }
+
+        return true;
+    }
+};
+
+#endif // OBJ_PARSER_H
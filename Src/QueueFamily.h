@@ -13,6 +13,7 @@ namespace QueueFamily
     {
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
+        std::optional<uint32_t> transferFamily; // only set when the device has a family without graphics support
 
         bool isComplete() {
             return graphicsFamily.has_value() && presentFamily.has_value();
@@ -29,25 +30,37 @@ namespace QueueFamily
         std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
         vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
 
+        bool transferOnlyFound = false;
+
         int i = 0;
         for (const auto& queueFamily : queueFamilies)
         {
-            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            if (!indices.isComplete())
             {
-                indices.graphicsFamily = i;
-            }
+                if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+                {
+                    indices.graphicsFamily = i;
+                }
 
-            VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+                VkBool32 presentSupport = false;
+                vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
 
-            if (presentSupport)
-            {
-                indices.presentFamily = i;
+                if (presentSupport)
+                {
+                    indices.presentFamily = i;
+                }
             }
 
-            if (indices.isComplete())
+            // prefer a transfer-only family (usually the dma engine), otherwise any family that is not graphics
+            if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
             {
-                break;
+                bool transferOnly = !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT);
+
+                if (!indices.transferFamily.has_value() || (transferOnly && !transferOnlyFound))
+                {
+                    indices.transferFamily = i;
+                    transferOnlyFound = transferOnly;
+                }
             }
 
             i++;
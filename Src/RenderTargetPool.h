@@ -0,0 +1,203 @@
+#ifndef RENDER_TARGET_POOL_H
+#define RENDER_TARGET_POOL_H
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <memory>
+#include <vector>
+#include <stdexcept>
+
+#include "MemoryAllocator.h"
+#include "ImageView.h"
+
+struct RenderTargetDesc
+{
+    VkFormat format;
+    VkExtent2D extent;
+    VkSampleCountFlagBits samples;
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspectMask;
+};
+
+struct RenderTarget
+{
+    RenderTargetDesc desc;
+
+    VkImage image = NULL;
+    VkImageView imageView = NULL;
+
+    size_t memorySlot = 0;
+};
+
+// attachments that are rebuilt whenever the swapchain changes. images and views are cheap to recreate,
+// the memory behind them is not, so it is kept in slots that later targets alias as long as they fit.
+// targets that are alive at the same time never share a slot
+class RenderTargetPool
+{
+public:
+    RenderTargetPool(VkDevice& device, MemoryAllocator& allocator);
+    void destroyRenderTargetPool();
+
+    RenderTarget* acquire(const RenderTargetDesc& desc);
+    void release(RenderTarget* target);
+    void trim();
+
+private:
+    struct MemorySlot
+    {
+        VmaAllocation allocation = NULL;
+        VkDeviceSize size = 0;
+        VkDeviceSize offset = 0;
+        uint32_t memoryType = 0;
+        bool lazilyAllocated = false;
+        bool inUse = false;
+    };
+
+    size_t findMemorySlot(const VkMemoryRequirements& requirements, bool transient);
+
+    std::vector<std::unique_ptr<RenderTarget>> targets;
+    std::vector<MemorySlot> slots;
+
+    VkDevice* pDevice = nullptr;
+    MemoryAllocator* pAllocator = nullptr;
+};
+
+// new slots are made this much larger than requested so a window that keeps growing does not allocate on every resize
+const float RENDER_TARGET_SLOT_HEADROOM = 1.5f;
+
+RenderTargetPool::RenderTargetPool(VkDevice& device, MemoryAllocator& allocator)
+{
+    pDevice = &device;
+    pAllocator = &allocator;
+}
+
+void RenderTargetPool::destroyRenderTargetPool()
+{
+    while (!targets.empty())
+    {
+        release(targets.back().get());
+    }
+
+    trim();
+}
+
+RenderTarget* RenderTargetPool::acquire(const RenderTargetDesc& desc)
+{
+    auto target = std::make_unique<RenderTarget>();
+    target->desc = desc;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = desc.extent.width;
+    imageInfo.extent.height = desc.extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = desc.format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = desc.usage;
+    imageInfo.samples = desc.samples;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(*pDevice, &imageInfo, nullptr, &target->image) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create render target image");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(*pDevice, target->image, &requirements);
+
+    target->memorySlot = findMemorySlot(requirements, desc.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+    slots[target->memorySlot].inUse = true;
+
+    pAllocator->bindImageMemory(slots[target->memorySlot].allocation, target->image);
+
+    target->imageView = ImageView::createImageView(target->image, desc.format, desc.aspectMask, 1, *pDevice);
+
+    targets.push_back(std::move(target));
+    return targets.back().get();
+}
+
+// the target's memory goes back to the pool, its contents are not preserved
+void RenderTargetPool::release(RenderTarget* target)
+{
+    for (size_t i = 0; i < targets.size(); i++)
+    {
+        if (targets[i].get() != target)
+        {
+            continue;
+        }
+
+        vkDestroyImageView(*pDevice, target->imageView, nullptr);
+        vkDestroyImage(*pDevice, target->image, nullptr);
+
+        slots[target->memorySlot].inUse = false;
+
+        targets.erase(targets.begin() + i);
+        return;
+    }
+}
+
+// frees every slot no target is using, called once the new set of targets has been acquired
+void RenderTargetPool::trim()
+{
+    for (MemorySlot& slot : slots)
+    {
+        if (!slot.inUse && slot.allocation != NULL)
+        {
+            pAllocator->freeMemory(slot.allocation);
+            slot = MemorySlot{};
+        }
+    }
+}
+
+size_t RenderTargetPool::findMemorySlot(const VkMemoryRequirements& requirements, bool transient)
+{
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        const MemorySlot& slot = slots[i];
+
+        bool compatible = slot.allocation != NULL && !slot.inUse
+            && slot.size >= requirements.size
+            && (requirements.memoryTypeBits & (1u << slot.memoryType))
+            && slot.offset % requirements.alignment == 0
+            && (transient || !slot.lazilyAllocated); // lazily allocated memory can only back transient attachments
+
+        if (compatible)
+        {
+            return i;
+        }
+    }
+
+    VkMemoryRequirements slotRequirements = requirements;
+    slotRequirements.size = static_cast<VkDeviceSize>(requirements.size * RENDER_TARGET_SLOT_HEADROOM);
+
+    MemorySlot slot{};
+    VmaAllocationInfo allocationInfo{};
+    pAllocator->allocateMemory(slotRequirements, MemoryUsage::RenderTarget, transient, slot.allocation, allocationInfo);
+
+    slot.size = allocationInfo.size;
+    slot.offset = allocationInfo.offset;
+    slot.memoryType = allocationInfo.memoryType;
+
+    VkMemoryPropertyFlags memoryFlags;
+    vmaGetMemoryTypeProperties(pAllocator->allocator, slot.memoryType, &memoryFlags);
+    slot.lazilyAllocated = memoryFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        if (slots[i].allocation == NULL)
+        {
+            slots[i] = slot;
+            return i;
+        }
+    }
+
+    slots.push_back(slot);
+    return slots.size() - 1;
+}
+
+#endif // RENDER_TARGET_POOL_H
@@ -0,0 +1,156 @@
+#ifndef STAGING_RING_H
+#define STAGING_RING_H
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <deque>
+#include <stdexcept>
+
+#include "MemoryAllocator.h"
+
+struct StagingAllocation
+{
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    void* data;
+};
+
+// one persistently mapped staging buffer that every upload suballocates from,
+// space is handed back once the upload submission that read it has completed
+class StagingRing
+{
+public:
+    StagingRing(VkDeviceSize size, MemoryAllocator& allocator);
+    void destroyStagingRing();
+
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, StagingAllocation& allocation);
+    void retire(uint64_t ticket);
+    void reclaim(uint64_t completedTicket);
+
+    bool hasPendingAllocations();
+    VkDeviceSize getMaxChunkSize();
+
+    VkBuffer buffer = NULL;
+
+private:
+    struct Region
+    {
+        VkDeviceSize end;
+        uint64_t ticket;
+    };
+
+    VmaAllocation allocation = NULL;
+    char* mappedData = nullptr;
+
+    VkDeviceSize capacity = 0;
+    VkDeviceSize head = 0; // next free byte
+    VkDeviceSize tail = 0; // oldest byte still read by the gpu
+    bool pendingAllocations = false; // allocated since the last retire()
+
+    std::deque<Region> inFlight;
+
+    MemoryAllocator* pAllocator = nullptr;
+};
+
+StagingRing::StagingRing(VkDeviceSize size, MemoryAllocator& allocator)
+{
+    void* data;
+    allocator.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::Staging, buffer, allocation, &data);
+
+    mappedData = static_cast<char*>(data);
+    capacity = size;
+
+    pAllocator = &allocator;
+}
+
+void StagingRing::destroyStagingRing()
+{
+    inFlight.clear();
+    pAllocator->destroyBuffer(buffer, allocation);
+}
+
+// returns false when the ring is full, the caller has to submit or wait for older uploads and try again
+bool StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, StagingAllocation& allocation)
+{
+    if (size > capacity)
+    {
+        throw std::runtime_error("staging allocation larger than the staging ring, upload must be chunked");
+    }
+
+    bool empty = inFlight.empty() && !pendingAllocations;
+
+    if (empty)
+    {
+        head = 0;
+        tail = 0;
+    }
+    else if (head == tail)
+    {
+        return false; // wrapped all the way around to the tail
+    }
+
+    VkDeviceSize alignedHead = (head + alignment - 1) & ~(alignment - 1);
+    VkDeviceSize offset;
+
+    if (head >= tail || empty)
+    {
+        if (alignedHead + size <= capacity)
+        {
+            offset = alignedHead;
+        }
+        else if (size <= tail || empty)
+        {
+            offset = 0; // wrap around, the unused end of the buffer is skipped until the tail passes it
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (alignedHead + size <= tail)
+    {
+        offset = alignedHead;
+    }
+    else
+    {
+        return false;
+    }
+
+    head = offset + size;
+    pendingAllocations = true;
+
+    allocation = { buffer, offset, mappedData + offset };
+    return true;
+}
+
+void StagingRing::retire(uint64_t ticket)
+{
+    if (pendingAllocations)
+    {
+        inFlight.push_back({ head, ticket });
+        pendingAllocations = false;
+    }
+}
+
+void StagingRing::reclaim(uint64_t completedTicket)
+{
+    while (!inFlight.empty() && inFlight.front().ticket <= completedTicket)
+    {
+        tail = inFlight.front().end;
+        inFlight.pop_front();
+    }
+}
+
+bool StagingRing::hasPendingAllocations()
+{
+    return pendingAllocations;
+}
+
+VkDeviceSize StagingRing::getMaxChunkSize()
+{
+    // small enough that a chunk always fits once older submissions have drained
+    return capacity / 4;
+}
+
+#endif // STAGING_RING_H
@@ -0,0 +1,35 @@
+#ifndef SUBMESH_H
+#define SUBMESH_H
+
+#include <cstdint>
+#include <string>
+
+const uint32_t SUBMESH_NO_MATERIAL = UINT32_MAX;
+
+// a run of triangles from one obj shape drawn with one material. firstIndex is relative to the mesh
+struct Submesh
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t materialIndex;
+    uint32_t shapeIndex;
+};
+
+// one level of detail, a run of the mesh's submeshes. error is how far, in object space units, the level's surface
+// may be from the full detail one, 0 for the full detail level itself
+struct MeshLod
+{
+    uint32_t firstSubmesh;
+    uint32_t submeshCount;
+    float error;
+};
+
+// a material from the .mtl, texture paths are resolved against the mtl's directory and empty when it has no such map
+struct MeshMaterial
+{
+    std::string name;
+    std::string baseColorPath;
+    std::string roughnessPath;
+};
+
+#endif // SUBMESH_H
@@ -10,13 +10,13 @@
 #include <stdexcept>
 
 #include "QueueFamily.h"
-#include "Image.h"
+#include "RenderTargetPool.h"
 #include "Device.h"
 
 class SwapChain
 {
 public:
-    SwapChain(VkPhysicalDevice& physicalDevice, VkSurfaceKHR& surface, VkDevice& device, GLFWwindow* window);
+    SwapChain(VkPhysicalDevice& physicalDevice, VkSurfaceKHR& surface, VkDevice& device, RenderTargetPool& renderTargetPool, GLFWwindow* window);
     void createFramebuffers(VkRenderPass& renderPass);
     void recreateSwapChain(VkPhysicalDevice& physicalDevice, VkSurfaceKHR& surface, VkDevice& device, GLFWwindow* window, VkRenderPass renderPass);
     void cleanupSwapChain();
@@ -31,8 +31,9 @@ public:
     std::vector<VkImageView> swapChainImageViews;
     std::vector<VkFramebuffer> swapChainFramebuffers;
 
-    std::unique_ptr<Image> colorImage;
-    std::unique_ptr<Image> depthImage;
+    // owned by the render target pool, replaced on every recreation
+    RenderTarget* colorImage = nullptr;
+    RenderTarget* depthImage = nullptr;
 
     VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
 
@@ -49,10 +50,12 @@ private:
     VkPhysicalDevice* pPhysicalDevice = nullptr;
     GLFWwindow* pWindow = nullptr;
     VkSurfaceKHR* pSurface = nullptr;
+    RenderTargetPool* pRenderTargetPool = nullptr;
 };
 
-SwapChain::SwapChain(VkPhysicalDevice& physicalDevice, VkSurfaceKHR& surface, VkDevice& device, GLFWwindow* window)
+SwapChain::SwapChain(VkPhysicalDevice& physicalDevice, VkSurfaceKHR& surface, VkDevice& device, RenderTargetPool& renderTargetPool, GLFWwindow* window)
 {
+    pRenderTargetPool = &renderTargetPool;
     createSwapChain(physicalDevice, surface, device, window);
 }
 
@@ -195,15 +198,14 @@ void SwapChain::createColorResources()
 {
     VkFormat colorFormat = swapChainImageFormat;
 
-    colorImage = std::make_unique<Image>(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, *pDevice, *pPhysicalDevice);
-    colorImage->createImageView(VK_IMAGE_ASPECT_COLOR_BIT, 1);
+    // only resolved into the swapchain image, so it never needs to leave tile memory
+    colorImage = pRenderTargetPool->acquire({ colorFormat, swapChainExtent, msaaSamples, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT });
 }
 
 void SwapChain::createDepthResources()
 {
     VkFormat depthFormat = findDepthFormat();
-    depthImage = std::make_unique<Image>(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, *pDevice, *pPhysicalDevice);
-    depthImage->createImageView(VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+    depthImage = pRenderTargetPool->acquire({ depthFormat, swapChainExtent, msaaSamples, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT });
 }
 
 VkFormat SwapChain::findDepthFormat()
@@ -250,6 +252,8 @@ void SwapChain::recreateSwapChain(VkPhysicalDevice& physicalDevice, VkSurfaceKHR
 
     createSwapChain(physicalDevice, surface, device, window);
     createFramebuffers(renderPass);
+
+    pRenderTargetPool->trim(); // drop memory the new targets were too large to reuse
 }
 
 void SwapChain::createFramebuffers(VkRenderPass& renderPass)
@@ -283,8 +287,8 @@ void SwapChain::createFramebuffers(VkRenderPass& renderPass)
 
 void SwapChain::cleanupSwapChain()
 {
-    colorImage->destroyImage();
-    depthImage->destroyImage();
+    pRenderTargetPool->release(colorImage);
+    pRenderTargetPool->release(depthImage);
 
     for (int i = 0; i < swapChainFramebuffers.size(); i++)
     {
@@ -1,71 +1,279 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include <array>
+#include <vector>
+#include <memory>
+
 #include "stb_image.h"
 
 #include "Image.h"
+#include "UploadContext.h"
+#include "Ktx2.h"
+#include "MaterialPacking.h"
+
+// what a texture file holds once it has been read, everything that does not need the device.
+// it is built with Texture::load, which may run on any thread
+struct TextureData
+{
+    Ktx2Texture ktx; // baked textures, every level is already in the mapping
+
+    // png and jpg, only the first level, the rest is generated on the gpu
+    std::unique_ptr<stbi_uc, void (*)(void*)> pixels{ nullptr, stbi_image_free };
+    std::vector<uint8_t> packedPixels; // in place of pixels for material maps packed on load
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
 
 class Texture
 {
 public:
-	Texture(std::string baseColorPath, VkDevice& device, VkPhysicalDevice& physicalDevice, VkCommandPool commandPool, VkQueue& graphicsQueue);
+	Texture(std::string baseColorPath, VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue);
+    // a baked texture can start with only the levels from firstLevel on resident, the texture streamer brings in the rest
+    Texture(TextureData& data, VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue, uint32_t firstLevel = 0);
+    Texture(const std::array<uint8_t, 4>& color, VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue, VkFormat format = VK_FORMAT_R8G8B8A8_SRGB);
+
+    static std::unique_ptr<TextureData> load(const std::string& path);
+    static std::unique_ptr<TextureData> loadPacked(const MaterialMapSources& sources);
+
+    // a new image with the baked levels from firstLevel on, nothing about the texture itself changes. used for the
+    // first upload and by the streamer whenever it changes which levels are resident
+    static std::unique_ptr<Image> createKtx2Image(TextureData& data, uint32_t firstLevel, VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue);
+    static VkImageViewType getViewType(const Ktx2Texture& ktx);
+
+    // takes over an image from createKtx2Image, the old one is destroyed once frames in flight are done with it
+    void replaceImage(std::unique_ptr<Image> image, uint32_t firstLevel);
+
     void createTextureSampler(VkDevice& device, VkPhysicalDevice& physicalDevice);
     void destroyTexture();
 
-    uint32_t mipLevels;
+    uint32_t mipLevels; // in the image, the resident ones
+    uint32_t levelCount; // all the texture has, resident or not
+    uint32_t firstLevel = 0; // the finest level resident, the image's level 0. the view never reaches finer ones
+
+    // of level 0, whether it is resident or not
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    // arrays and cubemaps come from baked files, everything else is a plain 2D texture
+    VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D;
 
     VkSampler textureSampler;
 
     std::unique_ptr<Image> textureImage;
 
 private:
+    void createImage(const stbi_uc* pixels, uint32_t width, uint32_t height, VkFormat format, VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue);
 };
 
-Texture::Texture(std::string baseColorPath, VkDevice& device, VkPhysicalDevice& physicalDevice, VkCommandPool commandPool, VkQueue& graphicsQueue)
+Texture::Texture(std::string baseColorPath, VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue)
+    : Texture(*load(baseColorPath), device, physicalDevice, allocator, uploadContext, deletionQueue)
 {
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(baseColorPath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+}
+
+Texture::Texture(TextureData& data, VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue, uint32_t firstLevel)
+{
+    if (data.ktx.file)
+    {
+        width = data.ktx.width;
+        height = data.ktx.height;
+        levelCount = data.ktx.levelCount;
+        viewType = getViewType(data.ktx);
+
+        replaceImage(createKtx2Image(data, firstLevel, device, physicalDevice, allocator, uploadContext, deletionQueue), firstLevel);
+    }
+    else
+    {
+        const stbi_uc* pixels = data.pixels ? data.pixels.get() : data.packedPixels.data();
+        createImage(pixels, data.width, data.height, data.format, device, physicalDevice, allocator, uploadContext, deletionQueue);
+    }
+
+    createTextureSampler(device, physicalDevice);
+}
 
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
+// a single texel, used in place of textures that are still loading or failed to load
+Texture::Texture(const std::array<uint8_t, 4>& color, VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue, VkFormat format)
+{
+    createImage(color.data(), 1, 1, format, device, physicalDevice, allocator, uploadContext, deletionQueue);
+    createTextureSampler(device, physicalDevice);
+}
 
-    mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+// maps a baked texture or decodes a png or jpg
+std::unique_ptr<TextureData> Texture::load(const std::string& path)
+{
+    std::unique_ptr<TextureData> data = std::make_unique<TextureData>();
 
-    if (!pixels)
+    if (Ktx2::isKtx2Path(path))
     {
-        throw std::runtime_error("failed to load texture image!");
+        Ktx2::open(path, data->ktx);
+        return data;
     }
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+    int texWidth, texHeight, texChannels;
+    data->pixels.reset(stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha));
 
-    Buffer::createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, device, physicalDevice);
+    if (!data->pixels)
+    {
+        throw std::runtime_error("failed to load texture image " + path);
+    }
 
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(device, stagingBufferMemory);
+    data->width = static_cast<uint32_t>(texWidth);
+    data->height = static_cast<uint32_t>(texHeight);
 
-    stbi_image_free(pixels);
+    return data;
+}
 
-    textureImage = std::make_unique<Image>(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, device, physicalDevice);
-    textureImage->transitionImageLayout(VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, commandPool, device, graphicsQueue);
-    textureImage->copyBufferToImage(stagingBuffer, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), commandPool, device, graphicsQueue);
+// occlusion, roughness and metalness packed into one linear texture, for materials without a baked one
+std::unique_ptr<TextureData> Texture::loadPacked(const MaterialMapSources& sources)
+{
+    std::unique_ptr<TextureData> data = std::make_unique<TextureData>();
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    data->packedPixels = MaterialPacking::pack(sources, data->width, data->height);
+    data->format = VK_FORMAT_R8G8B8A8_UNORM;
+
+    return data;
+}
+
+// RGBA8 pixels of the first level, srgb colour or linear data, mipmapped on the gpu. without linear blits for the
+// format the texture is sampled from that first level only
+void Texture::createImage(const stbi_uc* pixels, uint32_t texWidth, uint32_t texHeight, VkFormat format, VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue)
+{
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+    bool generateMips = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+
+    mipLevels = generateMips ? static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1 : 1;
+    levelCount = mipLevels;
+    width = texWidth;
+    height = texHeight;
+
+    textureImage = std::make_unique<Image>(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, MemoryUsage::Texture, device, allocator, deletionQueue);
+    // recorded into the upload context's batch, nothing is submitted here
+    textureImage->transitionImageLayout(uploadContext.getCommandBuffer(), format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+    uploadContext.uploadImage(*textureImage, pixels, texWidth, texHeight, 4);
+
+    // blits need a graphics queue, so mips are generated after the image has been handed over
+    uploadContext.releaseImage(*textureImage, mipLevels);
+
+    if (generateMips)
+    {
+        textureImage->generateMipMaps(uploadContext.getGraphicsCommandBuffer(), format, static_cast<int32_t>(texWidth), static_cast<int32_t>(texHeight), mipLevels, physicalDevice);
+    }
+    else
+    {
+        textureImage->transitionImageLayout(uploadContext.getGraphicsCommandBuffer(), format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+    }
 
-    textureImage->generateMipMaps(VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels, physicalDevice, device, commandPool, graphicsQueue);
     textureImage->createImageView(VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+}
 
-    createTextureSampler(device, physicalDevice);
+VkImageViewType Texture::getViewType(const Ktx2Texture& ktx)
+{
+    if (ktx.faceCount == 6)
+    {
+        return ktx.isArray ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
+    }
+
+    return ktx.isArray ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+}
+
+// baked texture, every mip level of every layer is already in the file and goes straight from the mapping into
+// staging memory, nothing is generated on the gpu. a device without the block compressed formats fails the load,
+// the texture's users keep their placeholder
+std::unique_ptr<Image> Texture::createKtx2Image(TextureData& data, uint32_t firstLevel, VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue)
+{
+    const Ktx2Texture& ktx = data.ktx;
+    VkFormat format = ktx.format;
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+    {
+        throw std::runtime_error("texture format not supported by the device");
+    }
+
+    uint32_t mipLevels = ktx.levelCount - firstLevel;
+
+    bool cubemap = ktx.faceCount == 6;
+    uint32_t arrayLayers = ktx.layerCount * ktx.faceCount;
+
+    std::unique_ptr<Image> image = std::make_unique<Image>(std::max(1u, ktx.width >> firstLevel), std::max(1u, ktx.height >> firstLevel), mipLevels, VK_SAMPLE_COUNT_1_BIT, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, MemoryUsage::Texture, device, allocator, deletionQueue, arrayLayers, cubemap ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0);
+
+    try
+    {
+        image->transitionImageLayout(uploadContext.getCommandBuffer(), format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
 
+        // the file keeps a level's layers and faces next to each other, in the order vulkan numbers the layers
+        std::vector<ImageUploadRegion> regions;
+
+        for (uint32_t level = firstLevel; level < ktx.levelCount; level++)
+        {
+            uint32_t levelWidth = std::max(1u, ktx.width >> level);
+            uint32_t levelHeight = std::max(1u, ktx.height >> level);
+            uint64_t imageSize = Ktx2::getImageSize(format, levelWidth, levelHeight);
+
+            for (uint32_t layer = 0; layer < arrayLayers; layer++)
+            {
+                const char* levelData = ktx.levelData[level] + imageSize * layer;
+                regions.push_back({ levelData, imageSize, levelWidth, levelHeight, level - firstLevel, layer });
+            }
+        }
+
+        uploadContext.uploadImageRegions(*image, regions, Ktx2::getBlockBytes(format), Ktx2::getBlockDimension(format));
+
+        uploadContext.releaseImage(*image, mipLevels);
+        image->transitionImageLayout(uploadContext.getGraphicsCommandBuffer(), format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+        image->createImageView(VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, getViewType(ktx));
+    }
+    catch (...)
+    {
+        // copies into it may already be recorded, it is destroyed once they have finished. nothing samples it,
+        // so the frames in flight do not have to be waited for
+        Image* failed = image.release();
+
+        uploadContext.destroyAfterUpload([failed]()
+        {
+            if (failed->imageView != NULL)
+            {
+                vkDestroyImageView(*failed->pDevice, failed->imageView, nullptr);
+            }
+            failed->pAllocator->destroyImage(failed->image, failed->imageAllocation);
+
+            delete failed;
+        });
+
+        throw;
+    }
+
+    return image;
+}
+
+void Texture::replaceImage(std::unique_ptr<Image> image, uint32_t firstLevel)
+{
+    if (textureImage)
+    {
+        textureImage->destroyImage();
+    }
+
+    textureImage = std::move(image);
+    this->firstLevel = firstLevel;
+    mipLevels = levelCount - firstLevel;
 }
 
 void Texture::destroyTexture()
 {
-    vkDestroySampler(*textureImage->pDevice, textureSampler, nullptr);
-    textureImage->destroyImage();
+    VkDevice device = *textureImage->pDevice;
+    VkSampler sampler = textureSampler;
 
+    textureImage->pDeletionQueue->push([=]()
+    {
+        vkDestroySampler(device, sampler, nullptr);
+    });
+
+    textureImage->destroyImage();
 }
 
 void Texture::createTextureSampler(VkDevice& device, VkPhysicalDevice& physicalDevice)
@@ -93,7 +301,7 @@ void Texture::createTextureSampler(VkDevice& device, VkPhysicalDevice& physicalD
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = static_cast<float>(mipLevels);
+    samplerInfo.maxLod = static_cast<float>(levelCount); // the view limits it to what is resident
 
     if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS)
     {
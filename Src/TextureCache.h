@@ -0,0 +1,191 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Texture.h"
+#include "AssetLoader.h"
+#include "AssetPaths.h"
+#include "MaterialPacking.h"
+#include "TextureStreamer.h"
+#include "UploadContext.h"
+#include "DeletionQueue.h"
+#include "MemoryAllocator.h"
+
+// the maps one material samples, both point into the cache
+struct MaterialTextures
+{
+    Texture* baseColor = nullptr;
+    Texture* roughness = nullptr; // occlusion, roughness and metalness when the renderer packs material maps
+};
+
+// owns every texture the renderer has loaded. materials that share a map share one Texture, the path is
+// normalized first so "a/../b.png" and "b.png" are the same entry. with a streamer, baked textures are uploaded
+// with only their mip tail and handed to it for the rest
+class TextureCache
+{
+public:
+    TextureCache(VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue, AssetLoader& assetLoader, TextureStreamer* streamer = nullptr);
+
+    // onReady gets the texture once it can be sampled, or nullptr when it failed to load. a texture that is
+    // already loaded calls it right away, one that is still loading adds it to the callbacks waiting for it
+    void request(const std::string& path, std::function<void(Texture*)> onReady);
+
+    // the occlusion, roughness and metalness maps that go with a roughness map in the source tree, packed into one
+    // texture. the baked one when assetbake has built it, otherwise they are packed on a worker
+    void requestPacked(const std::string& roughnessPath, std::function<void(Texture*)> onReady);
+
+    void destroyTextureCache();
+
+    size_t getTextureCount() const;
+
+private:
+    struct Entry
+    {
+        std::unique_ptr<Texture> texture;
+        bool loaded = false;
+        std::vector<std::function<void(Texture*)>> waiting;
+    };
+
+    void load(const std::string& key, std::function<std::unique_ptr<TextureData>()> read, std::function<void(Texture*)> onReady);
+
+    std::unordered_map<std::string, Entry> textures;
+
+    VkDevice* pDevice = nullptr;
+    VkPhysicalDevice* pPhysicalDevice = nullptr;
+    MemoryAllocator* pAllocator = nullptr;
+    UploadContext* pUploadContext = nullptr;
+    DeletionQueue* pDeletionQueue = nullptr;
+    AssetLoader* pAssetLoader = nullptr;
+    TextureStreamer* pStreamer = nullptr;
+};
+
+TextureCache::TextureCache(VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue, AssetLoader& assetLoader, TextureStreamer* streamer)
+{
+    pDevice = &device;
+    pPhysicalDevice = &physicalDevice;
+    pAllocator = &allocator;
+    pUploadContext = &uploadContext;
+    pDeletionQueue = &deletionQueue;
+    pAssetLoader = &assetLoader;
+    pStreamer = streamer;
+}
+
+void TextureCache::request(const std::string& path, std::function<void(Texture*)> onReady)
+{
+    std::string key = std::filesystem::path(path).lexically_normal().generic_string();
+
+    load(key, [key]() { return Texture::load(key); }, std::move(onReady));
+}
+
+void TextureCache::requestPacked(const std::string& roughnessPath, std::function<void(Texture*)> onReady)
+{
+    std::string packedPath = MaterialPacking::getPackedPath(roughnessPath);
+    std::string bakedPath = AssetPaths::resolve(packedPath);
+
+    if (bakedPath != packedPath)
+    {
+        request(bakedPath, std::move(onReady));
+        return;
+    }
+
+    // the source tree has no such file, the key only names the combination
+    std::string key = std::filesystem::path(packedPath).lexically_normal().generic_string();
+
+    load(key, [roughnessPath]() { return Texture::loadPacked(MaterialPacking::findSources(roughnessPath)); }, std::move(onReady));
+}
+
+void TextureCache::load(const std::string& key, std::function<std::unique_ptr<TextureData>()> read, std::function<void(Texture*)> onReady)
+{
+    auto it = textures.find(key);
+    if (it != textures.end())
+    {
+        if (it->second.loaded)
+        {
+            onReady(it->second.texture.get());
+        }
+        else
+        {
+            it->second.waiting.push_back(std::move(onReady));
+        }
+
+        return;
+    }
+
+    textures[key].waiting.push_back(std::move(onReady));
+
+    // decoded on a worker, the image is created and recorded on the loader's thread
+    auto data = std::make_shared<std::unique_ptr<TextureData>>();
+
+    pAssetLoader->load(key, [data, read = std::move(read)]()
+    {
+        *data = read();
+    },
+    [this, data, key]()
+    {
+        uint32_t firstLevel = pStreamer ? TextureStreamer::getInitialLevel(**data) : 0;
+
+        Entry& entry = textures[key];
+        entry.texture = std::make_unique<Texture>(**data, *pDevice, *pPhysicalDevice, *pAllocator, *pUploadContext, *pDeletionQueue, firstLevel);
+
+        // the streamer keeps the file mapped for the levels still to come
+        if (firstLevel > 0)
+        {
+            pStreamer->add(entry.texture.get(), std::move(*data));
+        }
+
+        data->reset();
+    },
+    [this, key](bool)
+    {
+        // a failed load leaves the entry without a texture, its users keep their placeholder
+        Entry& entry = textures[key];
+        entry.loaded = true;
+
+        std::vector<std::function<void(Texture*)>> waiting = std::move(entry.waiting);
+        entry.waiting.clear();
+
+        for (auto& callback : waiting)
+        {
+            callback(entry.texture.get());
+        }
+    });
+}
+
+void TextureCache::destroyTextureCache()
+{
+    if (pStreamer)
+    {
+        pStreamer->clear();
+    }
+
+    for (auto& texture : textures)
+    {
+        if (texture.second.texture)
+        {
+            texture.second.texture->destroyTexture();
+        }
+    }
+
+    textures.clear();
+}
+
+// textures that have finished loading
+size_t TextureCache::getTextureCount() const
+{
+    size_t count = 0;
+
+    for (const auto& texture : textures)
+    {
+        count += texture.second.texture ? 1 : 0;
+    }
+
+    return count;
+}
+
+#endif // TEXTURE_CACHE_H
@@ -0,0 +1,381 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "Texture.h"
+#include "Ktx2.h"
+#include "UploadContext.h"
+#include "DeletionQueue.h"
+#include "MemoryAllocator.h"
+
+// textures start with only their mip tail resident, levels up to this size on their longest side
+const uint32_t STREAMING_TAIL_SIZE = 128;
+
+// how much one update may hand to the upload context, a change larger than this still goes out on its own
+const VkDeviceSize STREAMING_UPLOAD_BYTES_PER_UPDATE = 16ull * 1024 * 1024;
+
+// updates without a request before a texture falls back to its tail
+const uint32_t STREAMING_IDLE_UPDATES = 120;
+
+// keeps the mip levels of baked textures resident as far as the screen needs them. a texture starts with its
+// small tail and the renderer requests, every update, the finest level it could sample along with how urgent that
+// is. finer levels come in one at a time, the most urgent first, and the least urgent textures give up their finer
+// levels when everything requested does not fit the budget.
+// an image cannot change its levels, so every change builds a new image with the resident ones from the still
+// mapped file and swaps it in once the copies have finished. the view only covers the resident levels, which is
+// what keeps sampling out of the ones that are not. all of it runs on the thread that owns the upload context
+class TextureStreamer
+{
+public:
+    TextureStreamer(VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue, VkDeviceSize budget);
+
+    // the level a texture is first uploaded from, 0 when it is not worth streaming
+    static uint32_t getInitialLevel(const TextureData& data);
+
+    // takes over streaming of a texture created from data at getInitialLevel, data keeps the file mapped
+    void add(Texture* texture, std::unique_ptr<TextureData> data);
+
+    // the finest level the texture is sampled at and how urgent it is, larger is more urgent. several requests for
+    // one texture in an update keep the finest level and the highest priority, textures not streamed are ignored
+    void request(Texture* texture, uint32_t level, float priority);
+
+    // once per frame, swaps in finished images and starts the changes the requests ask for
+    void update();
+
+    // called with a texture whose image was swapped, whatever samples it has to be rebound
+    void setResidencyCallback(std::function<void(Texture*)> callback);
+
+    VkDeviceSize getResidentBytes() const;
+
+    // only valid once the device is idle, the textures themselves belong to the cache
+    void clear();
+
+private:
+    struct Stream
+    {
+        Texture* texture = nullptr;
+        std::unique_ptr<TextureData> data;
+        uint32_t tailLevel = 0;
+        uint32_t targetLevel = 0;
+        float priority = 0.0f;
+
+        bool requested = false;
+        uint32_t requestedLevel = 0;
+        float requestedPriority = 0.0f;
+        uint32_t idleUpdates = 0;
+
+        // the image being uploaded, swapped in once ticket is complete
+        std::unique_ptr<Image> incoming;
+        uint32_t incomingLevel = 0;
+        uint64_t ticket = 0;
+
+        bool failed = false;
+    };
+
+    VkDeviceSize getBytes(const Stream& stream, uint32_t firstLevel) const;
+    void startChange(Stream& stream, uint32_t firstLevel);
+
+    std::vector<Stream> streams;
+    std::unordered_map<Texture*, size_t> streamIndices;
+
+    // scratch for update, kept so the frame loop does not allocate once they have grown to the stream count
+    std::vector<uint32_t> wanted;
+    std::vector<size_t> order;
+    std::vector<size_t> promotions;
+
+    VkDeviceSize budget = 0;
+    std::function<void(Texture*)> residencyCallback;
+
+    VkDevice* pDevice = nullptr;
+    VkPhysicalDevice* pPhysicalDevice = nullptr;
+    MemoryAllocator* pAllocator = nullptr;
+    UploadContext* pUploadContext = nullptr;
+    DeletionQueue* pDeletionQueue = nullptr;
+};
+
+TextureStreamer::TextureStreamer(VkDevice& device, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator, UploadContext& uploadContext, DeletionQueue& deletionQueue, VkDeviceSize budget)
+{
+    pDevice = &device;
+    pPhysicalDevice = &physicalDevice;
+    pAllocator = &allocator;
+    pUploadContext = &uploadContext;
+    pDeletionQueue = &deletionQueue;
+
+    this->budget = budget;
+}
+
+// png and jpg get their levels generated on the gpu and are always whole
+uint32_t TextureStreamer::getInitialLevel(const TextureData& data)
+{
+    if (!data.ktx.file || data.ktx.levelCount <= 1)
+    {
+        return 0;
+    }
+
+    uint32_t level = 0;
+
+    while (level + 1 < data.ktx.levelCount && std::max(data.ktx.width >> level, data.ktx.height >> level) > STREAMING_TAIL_SIZE)
+    {
+        level++;
+    }
+
+    return level;
+}
+
+void TextureStreamer::add(Texture* texture, std::unique_ptr<TextureData> data)
+{
+    Stream stream;
+    stream.texture = texture;
+    stream.data = std::move(data);
+    stream.tailLevel = texture->firstLevel;
+    stream.targetLevel = texture->firstLevel;
+
+    streamIndices[texture] = streams.size();
+    streams.push_back(std::move(stream));
+}
+
+void TextureStreamer::request(Texture* texture, uint32_t level, float priority)
+{
+    auto it = streamIndices.find(texture);
+    if (it == streamIndices.end())
+    {
+        return;
+    }
+
+    Stream& stream = streams[it->second];
+    level = std::min(level, stream.tailLevel);
+
+    if (!stream.requested)
+    {
+        stream.requested = true;
+        stream.requestedLevel = level;
+        stream.requestedPriority = priority;
+    }
+    else
+    {
+        stream.requestedLevel = std::min(stream.requestedLevel, level);
+        stream.requestedPriority = std::max(stream.requestedPriority, priority);
+    }
+}
+
+void TextureStreamer::update()
+{
+    for (Stream& stream : streams)
+    {
+        if (stream.incoming && pUploadContext->isComplete(stream.ticket))
+        {
+            stream.texture->replaceImage(std::move(stream.incoming), stream.incomingLevel);
+
+            if (residencyCallback)
+            {
+                residencyCallback(stream.texture);
+            }
+        }
+
+        if (stream.requested)
+        {
+            stream.targetLevel = stream.requestedLevel;
+            stream.priority = stream.requestedPriority;
+            stream.idleUpdates = 0;
+        }
+        else if (stream.idleUpdates < STREAMING_IDLE_UPDATES && ++stream.idleUpdates == STREAMING_IDLE_UPDATES)
+        {
+            stream.targetLevel = stream.tailLevel;
+            stream.priority = 0.0f;
+        }
+
+        stream.requested = false;
+    }
+
+    // a texture one level finer than it needs keeps it, so one that sits right at the edge does not upload every
+    // other update. anything coarser than that is given up, as is everything of a texture gone idle. a texture with
+    // a change in flight will have the incoming levels, and until that lands both its images are resident
+    wanted.resize(streams.size());
+    VkDeviceSize wantedBytes = 0;
+    VkDeviceSize residentBytes = 0;
+
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        const Stream& stream = streams[i];
+        bool keep = stream.idleUpdates < STREAMING_IDLE_UPDATES && stream.targetLevel == stream.texture->firstLevel + 1;
+
+        wanted[i] = keep ? stream.texture->firstLevel : stream.targetLevel;
+        residentBytes += getBytes(stream, stream.texture->firstLevel);
+
+        if (stream.incoming)
+        {
+            wanted[i] = stream.incomingLevel;
+            residentBytes += getBytes(stream, stream.incomingLevel);
+        }
+
+        wantedBytes += getBytes(stream, wanted[i]);
+    }
+
+    // over the budget the least urgent textures drop their finest levels first, down to the tail if need be
+    if (wantedBytes > budget)
+    {
+        order.resize(streams.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+
+        std::sort(order.begin(), order.end(), [this](size_t a, size_t b)
+        {
+            return streams[a].priority < streams[b].priority;
+        });
+
+        for (size_t i = 0; i < order.size() && wantedBytes > budget; i++)
+        {
+            const Stream& stream = streams[order[i]];
+            uint32_t& level = wanted[order[i]];
+
+            if (stream.incoming)
+            {
+                continue;
+            }
+
+            while (wantedBytes > budget && level < stream.tailLevel)
+            {
+                wantedBytes -= getBytes(stream, level) - getBytes(stream, level + 1);
+                level++;
+            }
+        }
+    }
+
+    // evictions go straight to their level and come first, they are small and free memory. promotions go one level
+    // at a time, most urgent first, so everything on screen sharpens step by step rather than one texture at a time.
+    // the new image is built while the old one is still resident, so a promotion only starts when both fit
+    promotions.clear();
+    VkDeviceSize recordedBytes = 0;
+
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        Stream& stream = streams[i];
+
+        if (stream.incoming || stream.failed || wanted[i] == stream.texture->firstLevel)
+        {
+            continue;
+        }
+
+        if (wanted[i] < stream.texture->firstLevel)
+        {
+            promotions.push_back(i);
+        }
+        else if (recordedBytes == 0 || recordedBytes + getBytes(stream, wanted[i]) <= STREAMING_UPLOAD_BYTES_PER_UPDATE)
+        {
+            recordedBytes += getBytes(stream, wanted[i]);
+            residentBytes += getBytes(stream, wanted[i]);
+            startChange(stream, wanted[i]);
+        }
+    }
+
+    std::sort(promotions.begin(), promotions.end(), [this](size_t a, size_t b)
+    {
+        return streams[a].priority > streams[b].priority;
+    });
+
+    for (size_t i : promotions)
+    {
+        Stream& stream = streams[i];
+        uint32_t level = stream.texture->firstLevel - 1;
+
+        if (recordedBytes != 0 && recordedBytes + getBytes(stream, level) > STREAMING_UPLOAD_BYTES_PER_UPDATE)
+        {
+            break;
+        }
+
+        if (residentBytes + getBytes(stream, level) > budget)
+        {
+            continue;
+        }
+
+        recordedBytes += getBytes(stream, level);
+        residentBytes += getBytes(stream, level);
+        startChange(stream, level);
+    }
+
+    // whatever a failed change recorded before it threw still has to be submitted
+    if (recordedBytes != 0)
+    {
+        uint64_t ticket = pUploadContext->submit();
+
+        for (Stream& stream : streams)
+        {
+            if (stream.incoming && stream.ticket == 0)
+            {
+                stream.ticket = ticket;
+            }
+        }
+    }
+}
+
+// a change that fails, an image the device is out of memory for, leaves the texture as it is for good
+void TextureStreamer::startChange(Stream& stream, uint32_t firstLevel)
+{
+    try
+    {
+        stream.incoming = Texture::createKtx2Image(*stream.data, firstLevel, *pDevice, *pPhysicalDevice, *pAllocator, *pUploadContext, *pDeletionQueue);
+        stream.incomingLevel = firstLevel;
+        stream.ticket = 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "failed to stream texture level " << firstLevel << ": " << e.what() << std::endl;
+        stream.failed = true;
+    }
+}
+
+// every layer and face of the levels from firstLevel on
+VkDeviceSize TextureStreamer::getBytes(const Stream& stream, uint32_t firstLevel) const
+{
+    const Ktx2Texture& ktx = stream.data->ktx;
+    VkDeviceSize bytes = 0;
+
+    for (uint32_t level = firstLevel; level < ktx.levelCount; level++)
+    {
+        bytes += Ktx2::getImageSize(ktx.format, std::max(1u, ktx.width >> level), std::max(1u, ktx.height >> level)) * ktx.layerCount * ktx.faceCount;
+    }
+
+    return bytes;
+}
+
+void TextureStreamer::setResidencyCallback(std::function<void(Texture*)> callback)
+{
+    residencyCallback = std::move(callback);
+}
+
+VkDeviceSize TextureStreamer::getResidentBytes() const
+{
+    VkDeviceSize bytes = 0;
+
+    for (const Stream& stream : streams)
+    {
+        bytes += getBytes(stream, stream.texture->firstLevel);
+    }
+
+    return bytes;
+}
+
+void TextureStreamer::clear()
+{
+    for (Stream& stream : streams)
+    {
+        if (stream.incoming)
+        {
+            stream.incoming->destroyImage();
+        }
+    }
+
+    streams.clear();
+    streamIndices.clear();
+}
+
+#endif // TEXTURE_STREAMER_H
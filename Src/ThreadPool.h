@@ -0,0 +1,172 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads for cpu side loading work
+class ThreadPool
+{
+public:
+    ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::future<void> submit(std::function<void()> job);
+    void parallelFor(size_t count, const std::function<void(size_t)>& job);
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::packaged_task<void()>> jobs;
+
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    bool stopping = false;
+};
+
+// 0 picks one worker per hardware thread, leaving one for the thread that drives the renderer
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    jobAvailable.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> job)
+{
+    std::packaged_task<void()> task(std::move(job));
+    std::future<void> future = task.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(task));
+    }
+
+    jobAvailable.notify_one();
+    return future;
+}
+
+// runs job(i) for every i in [0, count) and returns once all of them finished. the calling thread takes part,
+// so this is safe to call from inside a job, helpers that start after the work ran out simply return
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& job)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    struct State
+    {
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> done{ 0 };
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    auto state = std::make_shared<State>();
+
+    // helpers can outlive this call, so they copy the job instead of referencing it
+    auto run = [state, count, job]()
+    {
+        size_t i;
+        while ((i = state->next.fetch_add(1)) < count)
+        {
+            try
+            {
+                job(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error)
+                {
+                    state->error = std::current_exception();
+                }
+            }
+
+            if (state->done.fetch_add(1) + 1 == count)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    size_t helperCount = count - 1 < workers.size() ? count - 1 : workers.size();
+
+    for (size_t i = 0; i < helperCount; i++)
+    {
+        submit(run);
+    }
+
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&]() { return state->done.load() == count; });
+
+    if (state->error)
+    {
+        std::rethrow_exception(state->error);
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;)
+    {
+        std::packaged_task<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+            if (stopping && jobs.empty())
+            {
+                return;
+            }
+
+            task = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        task();
+    }
+}
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,88 @@
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstring>
+#include <stdexcept>
+
+#include "MemoryAllocator.h"
+
+// one persistently mapped uniform buffer split into a segment per frame in flight.
+// every draw pushes its constants and binds the returned offset through a UNIFORM_BUFFER_DYNAMIC descriptor,
+// a segment is reused once the fence of the frame that last wrote it has been waited on
+class UniformRing
+{
+public:
+    UniformRing(VkDeviceSize frameSize, uint32_t frameCount, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator);
+    void destroyUniformRing();
+
+    void beginFrame(uint32_t frameIndex);
+    uint32_t push(const void* data, VkDeviceSize size);
+
+    template<typename T>
+    uint32_t push(const T& data)
+    {
+        return push(&data, sizeof(T));
+    }
+
+    VkBuffer buffer = NULL;
+
+private:
+    VmaAllocation allocation = NULL;
+    char* mappedData = nullptr;
+
+    VkDeviceSize alignment = 0;
+    VkDeviceSize frameSize = 0;
+
+    VkDeviceSize head = 0;
+    VkDeviceSize frameEnd = 0;
+
+    MemoryAllocator* pAllocator = nullptr;
+};
+
+UniformRing::UniformRing(VkDeviceSize frameSize, uint32_t frameCount, VkPhysicalDevice& physicalDevice, MemoryAllocator& allocator)
+{
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    alignment = properties.limits.minUniformBufferOffsetAlignment;
+
+    // keep every segment starting on an aligned offset
+    this->frameSize = (frameSize + alignment - 1) & ~(alignment - 1);
+
+    void* data;
+    allocator.createBuffer(this->frameSize * frameCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, MemoryUsage::Uniform, buffer, allocation, &data);
+
+    mappedData = static_cast<char*>(data);
+    pAllocator = &allocator;
+}
+
+void UniformRing::destroyUniformRing()
+{
+    pAllocator->destroyBuffer(buffer, allocation);
+}
+
+void UniformRing::beginFrame(uint32_t frameIndex)
+{
+    head = frameSize * frameIndex;
+    frameEnd = head + frameSize;
+}
+
+// copies data into the current frame's segment and returns the dynamic offset to bind it with
+uint32_t UniformRing::push(const void* data, VkDeviceSize size)
+{
+    VkDeviceSize offset = head;
+
+    if (offset + size > frameEnd)
+    {
+        throw std::runtime_error("uniform ring is full for this frame");
+    }
+
+    memcpy(mappedData + offset, data, static_cast<size_t>(size));
+    head = (offset + size + alignment - 1) & ~(alignment - 1);
+
+    return static_cast<uint32_t>(offset);
+}
+
+#endif // UNIFORM_RING_H
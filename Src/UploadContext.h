@@ -0,0 +1,582 @@
+#ifndef UPLOAD_CONTEXT_H
+#define UPLOAD_CONTEXT_H
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <vector>
+#include <stdexcept>
+
+#include "StagingRing.h"
+#include "Image.h"
+
+// one subresource of an image upload, a mip level of one array layer or cube face
+struct ImageUploadRegion
+{
+    const void* data;
+    VkDeviceSize size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevel;
+    uint32_t arrayLayer;
+};
+
+// records copies, layout transitions and mip generation into one command buffer and submits them together,
+// every submission is identified by a ticket that can be polled or waited on.
+// when the device has a separate transfer family the copies run there and finished resources are released to
+// the graphics family, which acquires them in a second command buffer that waits on the transfer submission
+class UploadContext
+{
+public:
+    UploadContext(VkDevice& device, VkQueue& graphicsQueue, uint32_t graphicsFamily, VkQueue& transferQueue, uint32_t transferFamily, StagingRing& stagingRing);
+    void destroyUploadContext();
+
+    VkCommandBuffer getCommandBuffer();
+    VkCommandBuffer getGraphicsCommandBuffer();
+
+    void uploadBuffer(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+    // block compressed formats pass the bytes of one block and the texels across it
+    void uploadImage(Image& image, const void* pixels, uint32_t width, uint32_t height, uint32_t bytesPerBlock, uint32_t mipLevel = 0, uint32_t blockDimension = 1, uint32_t arrayLayer = 0);
+    // a whole mip chain or several layers at once, as few copies as the staging chunks allow
+    void uploadImageRegions(Image& image, const std::vector<ImageUploadRegion>& regions, uint32_t bytesPerBlock, uint32_t blockDimension = 1);
+
+    void releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask);
+    void releaseImage(Image& image, uint32_t mipLevels);
+
+    uint64_t submit();
+    bool isComplete(uint64_t ticket);
+    void wait(uint64_t ticket);
+
+    // runs once everything recorded so far has finished, for resources of an upload that failed halfway
+    void destroyAfterUpload(std::function<void()>&& deleter);
+
+    bool usesTransferQueue();
+
+private:
+    struct Submission
+    {
+        uint64_t ticket;
+        VkFence fence;
+        VkSemaphore semaphore;
+        VkCommandBuffer transferCommandBuffer;
+        VkCommandBuffer graphicsCommandBuffer;
+    };
+
+    VkCommandBuffer beginCommandBuffer(VkCommandPool commandPool, std::vector<VkCommandBuffer>& freeCommandBuffers);
+    StagingAllocation allocateStaging(VkDeviceSize size, VkDeviceSize alignment);
+    void retireCompleted();
+
+    VkCommandPool transferCommandPool = NULL;
+    VkCommandPool graphicsCommandPool = NULL;
+
+    // being recorded, NULL when nothing is pending. both are the same when there is no transfer family
+    VkCommandBuffer transferCommandBuffer = NULL;
+    VkCommandBuffer graphicsCommandBuffer = NULL;
+
+    std::deque<Submission> inFlight;
+    std::vector<VkFence> freeFences;
+    std::vector<VkSemaphore> freeSemaphores;
+    std::vector<VkCommandBuffer> freeTransferCommandBuffers;
+    std::vector<VkCommandBuffer> freeGraphicsCommandBuffers;
+
+    // with the ticket that has to complete first
+    std::deque<std::pair<uint64_t, std::function<void()>>> pendingDeleters;
+
+    uint64_t nextTicket = 1;
+    uint64_t completedTicket = 0;
+
+    uint32_t graphicsFamily = 0;
+    uint32_t transferFamily = 0;
+
+    VkDevice* pDevice = nullptr;
+    VkQueue* pGraphicsQueue = nullptr;
+    VkQueue* pTransferQueue = nullptr;
+    StagingRing* pStagingRing = nullptr;
+};
+
+UploadContext::UploadContext(VkDevice& device, VkQueue& graphicsQueue, uint32_t graphicsFamily, VkQueue& transferQueue, uint32_t transferFamily, StagingRing& stagingRing)
+{
+    this->graphicsFamily = graphicsFamily;
+    this->transferFamily = transferFamily;
+
+    pDevice = &device;
+    pGraphicsQueue = &graphicsQueue;
+    pTransferQueue = &transferQueue;
+    pStagingRing = &stagingRing;
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = transferFamily;
+
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create upload command pool");
+    }
+
+    if (usesTransferQueue())
+    {
+        poolInfo.queueFamilyIndex = graphicsFamily;
+
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &graphicsCommandPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create upload command pool");
+        }
+    }
+}
+
+void UploadContext::destroyUploadContext()
+{
+    wait(submit());
+
+    for (VkFence fence : freeFences)
+    {
+        vkDestroyFence(*pDevice, fence, nullptr);
+    }
+    freeFences.clear();
+
+    for (VkSemaphore semaphore : freeSemaphores)
+    {
+        vkDestroySemaphore(*pDevice, semaphore, nullptr);
+    }
+    freeSemaphores.clear();
+
+    // destroying the pools frees every command buffer allocated from them
+    vkDestroyCommandPool(*pDevice, transferCommandPool, nullptr);
+
+    if (graphicsCommandPool != NULL)
+    {
+        vkDestroyCommandPool(*pDevice, graphicsCommandPool, nullptr);
+    }
+}
+
+bool UploadContext::usesTransferQueue()
+{
+    return transferFamily != graphicsFamily;
+}
+
+// copies and the first layout transition of uploaded images go here
+VkCommandBuffer UploadContext::getCommandBuffer()
+{
+    if (transferCommandBuffer == NULL)
+    {
+        retireCompleted();
+        transferCommandBuffer = beginCommandBuffer(transferCommandPool, freeTransferCommandBuffers);
+    }
+
+    return transferCommandBuffer;
+}
+
+// work that needs a graphics queue (blits for mip generation) after resources have been released to it
+VkCommandBuffer UploadContext::getGraphicsCommandBuffer()
+{
+    if (!usesTransferQueue())
+    {
+        return getCommandBuffer();
+    }
+
+    if (graphicsCommandBuffer == NULL)
+    {
+        retireCompleted();
+        graphicsCommandBuffer = beginCommandBuffer(graphicsCommandPool, freeGraphicsCommandBuffers);
+    }
+
+    return graphicsCommandBuffer;
+}
+
+VkCommandBuffer UploadContext::beginCommandBuffer(VkCommandPool commandPool, std::vector<VkCommandBuffer>& freeCommandBuffers)
+{
+    VkCommandBuffer commandBuffer;
+
+    if (!freeCommandBuffers.empty())
+    {
+        commandBuffer = freeCommandBuffers.back();
+        freeCommandBuffers.pop_back();
+        vkResetCommandBuffer(commandBuffer, 0);
+    }
+    else
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(*pDevice, &allocInfo, &commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate upload command buffer");
+        }
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    return commandBuffer;
+}
+
+void UploadContext::uploadBuffer(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset)
+{
+    const char* src = static_cast<const char*>(data);
+    VkDeviceSize chunkSize = pStagingRing->getMaxChunkSize();
+
+    for (VkDeviceSize offset = 0; offset < size; offset += chunkSize)
+    {
+        VkDeviceSize copySize = std::min(chunkSize, size - offset);
+
+        StagingAllocation staging = allocateStaging(copySize, 16);
+        memcpy(staging.data, src + offset, static_cast<size_t>(copySize));
+
+        Buffer::copyBuffer(getCommandBuffer(), staging.buffer, dstBuffer, copySize, staging.offset, dstOffset + offset);
+    }
+}
+
+void UploadContext::uploadImage(Image& image, const void* pixels, uint32_t width, uint32_t height, uint32_t bytesPerBlock, uint32_t mipLevel, uint32_t blockDimension, uint32_t arrayLayer)
+{
+    // images are split into bands of whole rows of blocks so each band fits in a staging chunk
+    uint32_t blocksWide = (width + blockDimension - 1) / blockDimension;
+    uint32_t blocksHigh = (height + blockDimension - 1) / blockDimension;
+
+    VkDeviceSize rowPitch = static_cast<VkDeviceSize>(blocksWide) * bytesPerBlock;
+    uint32_t rowsPerChunk = static_cast<uint32_t>(std::max<VkDeviceSize>(1, pStagingRing->getMaxChunkSize() / rowPitch));
+
+    const char* src = static_cast<const char*>(pixels);
+
+    for (uint32_t row = 0; row < blocksHigh; row += rowsPerChunk)
+    {
+        uint32_t rowCount = std::min(rowsPerChunk, blocksHigh - row);
+        VkDeviceSize chunkSize = rowPitch * rowCount;
+
+        StagingAllocation staging = allocateStaging(chunkSize, std::max<VkDeviceSize>(16, bytesPerBlock));
+        memcpy(staging.data, src + rowPitch * row, static_cast<size_t>(chunkSize));
+
+        // the last band of a level whose size is not a multiple of the block ends at the level's edge
+        uint32_t texelRow = row * blockDimension;
+        uint32_t texelRowCount = std::min(rowCount * blockDimension, height - texelRow);
+
+        image.copyBufferToImage(getCommandBuffer(), staging.buffer, staging.offset, width, texelRowCount, static_cast<int32_t>(texelRow), mipLevel, arrayLayer);
+    }
+}
+
+void UploadContext::uploadImageRegions(Image& image, const std::vector<ImageUploadRegion>& regions, uint32_t bytesPerBlock, uint32_t blockDimension)
+{
+    // every region starts on a multiple of the block size, and of 4 which transfer queues need
+    VkDeviceSize alignment = std::max<VkDeviceSize>(16, bytesPerBlock);
+    VkDeviceSize chunkSize = pStagingRing->getMaxChunkSize();
+
+    std::vector<VkBufferImageCopy> copies;
+
+    for (size_t first = 0; first < regions.size();)
+    {
+        // regions too big for one chunk go in bands of rows, like a single level would
+        if (regions[first].size > chunkSize)
+        {
+            const ImageUploadRegion& region = regions[first];
+            uploadImage(image, region.data, region.width, region.height, bytesPerBlock, region.mipLevel, blockDimension, region.arrayLayer);
+
+            first++;
+            continue;
+        }
+
+        // as many of the following regions as fit in one chunk share a staging allocation and a copy
+        size_t last = first;
+        VkDeviceSize batchSize = 0;
+
+        while (last < regions.size() && regions[last].size <= chunkSize)
+        {
+            VkDeviceSize offset = (batchSize + alignment - 1) / alignment * alignment;
+
+            if (offset + regions[last].size > chunkSize)
+            {
+                break;
+            }
+
+            batchSize = offset + regions[last].size;
+            last++;
+        }
+
+        StagingAllocation staging = allocateStaging(batchSize, alignment);
+        char* dst = static_cast<char*>(staging.data);
+
+        copies.clear();
+        VkDeviceSize offset = 0;
+
+        for (size_t i = first; i < last; i++)
+        {
+            const ImageUploadRegion& region = regions[i];
+            offset = (offset + alignment - 1) / alignment * alignment;
+
+            memcpy(dst + offset, region.data, static_cast<size_t>(region.size));
+
+            VkBufferImageCopy copy{};
+            copy.bufferOffset = staging.offset + offset;
+            copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copy.imageSubresource.mipLevel = region.mipLevel;
+            copy.imageSubresource.baseArrayLayer = region.arrayLayer;
+            copy.imageSubresource.layerCount = 1;
+            copy.imageExtent = { region.width, region.height, 1 };
+            copies.push_back(copy);
+
+            offset += region.size;
+        }
+
+        image.copyBufferToImage(getCommandBuffer(), staging.buffer, copies.data(), static_cast<uint32_t>(copies.size()));
+
+        first = last;
+    }
+}
+
+// makes the copies into a range of buffer visible to dstStageMask on the graphics queue, transferring ownership if needed
+void UploadContext::releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask)
+{
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    if (!usesTransferQueue())
+    {
+        barrier.dstAccessMask = dstAccessMask;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+        vkCmdPipelineBarrier(getCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+        return;
+    }
+
+    barrier.srcQueueFamilyIndex = transferFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+
+    // release half, dst access is ignored on the releasing queue
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(getCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    // acquire half, src access is ignored on the acquiring queue
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccessMask;
+    vkCmdPipelineBarrier(getGraphicsCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+// hands an image whose levels are all in TRANSFER_DST_OPTIMAL to the graphics queue, the layout is kept
+void UploadContext::releaseImage(Image& image, uint32_t mipLevels)
+{
+    if (!usesTransferQueue())
+    {
+        return; // same queue, the mip generation barriers already cover the copies
+    }
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = transferFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+    barrier.image = image.image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = image.arrayLayers;
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(getCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(getGraphicsCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+// submits everything recorded since the last submit, returns the ticket of the latest submission
+uint64_t UploadContext::submit()
+{
+    if (transferCommandBuffer == NULL && graphicsCommandBuffer == NULL)
+    {
+        return nextTicket - 1;
+    }
+
+    Submission submission{};
+    submission.ticket = nextTicket++;
+    submission.transferCommandBuffer = transferCommandBuffer;
+    submission.graphicsCommandBuffer = graphicsCommandBuffer;
+
+    if (!freeFences.empty())
+    {
+        submission.fence = freeFences.back();
+        freeFences.pop_back();
+    }
+    else
+    {
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        if (vkCreateFence(*pDevice, &fenceInfo, nullptr, &submission.fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create upload fence");
+        }
+    }
+
+    bool crossQueue = transferCommandBuffer != NULL && graphicsCommandBuffer != NULL;
+
+    if (crossQueue)
+    {
+        if (!freeSemaphores.empty())
+        {
+            submission.semaphore = freeSemaphores.back();
+            freeSemaphores.pop_back();
+        }
+        else
+        {
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+            if (vkCreateSemaphore(*pDevice, &semaphoreInfo, nullptr, &submission.semaphore) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create upload semaphore");
+            }
+        }
+    }
+
+    if (transferCommandBuffer != NULL)
+    {
+        vkEndCommandBuffer(transferCommandBuffer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &transferCommandBuffer;
+
+        if (crossQueue)
+        {
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &submission.semaphore;
+        }
+
+        if (vkQueueSubmit(*pTransferQueue, 1, &submitInfo, crossQueue ? VK_NULL_HANDLE : submission.fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit upload command buffer");
+        }
+    }
+
+    if (graphicsCommandBuffer != NULL)
+    {
+        vkEndCommandBuffer(graphicsCommandBuffer);
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &graphicsCommandBuffer;
+
+        if (crossQueue)
+        {
+            submitInfo.waitSemaphoreCount = 1;
+            submitInfo.pWaitSemaphores = &submission.semaphore;
+            submitInfo.pWaitDstStageMask = &waitStage;
+        }
+
+        if (vkQueueSubmit(*pGraphicsQueue, 1, &submitInfo, submission.fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit upload command buffer");
+        }
+    }
+
+    inFlight.push_back(submission);
+    pStagingRing->retire(submission.ticket);
+
+    transferCommandBuffer = NULL;
+    graphicsCommandBuffer = NULL;
+
+    return submission.ticket;
+}
+
+bool UploadContext::isComplete(uint64_t ticket)
+{
+    retireCompleted();
+    return ticket <= completedTicket;
+}
+
+void UploadContext::wait(uint64_t ticket)
+{
+    while (!isComplete(ticket))
+    {
+        vkWaitForFences(*pDevice, 1, &inFlight.front().fence, VK_TRUE, UINT64_MAX);
+    }
+}
+
+// the batch being recorded gets the next ticket, without one everything recorded is already submitted
+void UploadContext::destroyAfterUpload(std::function<void()>&& deleter)
+{
+    bool recording = transferCommandBuffer != NULL || graphicsCommandBuffer != NULL;
+    pendingDeleters.push_back({ recording ? nextTicket : nextTicket - 1, std::move(deleter) });
+}
+
+StagingAllocation UploadContext::allocateStaging(VkDeviceSize size, VkDeviceSize alignment)
+{
+    StagingAllocation staging;
+
+    retireCompleted();
+
+    while (!pStagingRing->allocate(size, alignment, staging))
+    {
+        if (pStagingRing->hasPendingAllocations())
+        {
+            submit(); // the batch being recorded holds the rest of the ring, flush it
+        }
+        else
+        {
+            wait(inFlight.front().ticket);
+        }
+    }
+
+    return staging;
+}
+
+void UploadContext::retireCompleted()
+{
+    while (!inFlight.empty() && vkGetFenceStatus(*pDevice, inFlight.front().fence) == VK_SUCCESS)
+    {
+        Submission& submission = inFlight.front();
+
+        vkResetFences(*pDevice, 1, &submission.fence);
+        freeFences.push_back(submission.fence);
+
+        if (submission.semaphore != NULL)
+        {
+            freeSemaphores.push_back(submission.semaphore);
+        }
+
+        if (submission.transferCommandBuffer != NULL)
+        {
+            freeTransferCommandBuffers.push_back(submission.transferCommandBuffer);
+        }
+
+        if (submission.graphicsCommandBuffer != NULL)
+        {
+            freeGraphicsCommandBuffers.push_back(submission.graphicsCommandBuffer);
+        }
+
+        completedTicket = submission.ticket;
+        inFlight.pop_front();
+    }
+
+    pStagingRing->reclaim(completedTicket);
+
+    while (!pendingDeleters.empty() && pendingDeleters.front().first <= completedTicket)
+    {
+        std::function<void()> deleter = std::move(pendingDeleters.front().second);
+        pendingDeleters.pop_front();
+        deleter();
+    }
+}
+
+#endif // UPLOAD_CONTEXT_H
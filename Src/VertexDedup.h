@@ -0,0 +1,241 @@
+#ifndef VERTEX_DEDUP_H
+#define VERTEX_DEDUP_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "Vertex.h"
+#include "Arena.h"
+#include "ThreadPool.h"
+
+// collapses identical vertices of an unindexed corner list into a vertex and index buffer.
+// corners are spread over partitions by hash and every partition is deduplicated on its own open addressing table,
+// vertices are then numbered in order of first use so the result is exactly what a sequential pass would give
+namespace VertexDedup
+{
+    const uint32_t DEDUP_PARTITION_BITS = 6;
+    const uint32_t DEDUP_PARTITION_COUNT = 1u << DEDUP_PARTITION_BITS;
+    const size_t DEDUP_RANGE_SIZE = 64 * 1024; // corners handled by one job in the linear passes
+
+    const uint32_t DEDUP_EMPTY = UINT32_MAX;
+
+    const size_t VERTEX_WORDS = sizeof(Vertex) / sizeof(uint32_t);
+
+    struct Slot
+    {
+        uint32_t tag; // low hash bits, saves comparing whole vertices on most misses
+        uint32_t corner;
+    };
+
+    // vertex bits with -0.0 folded into 0.0, both compare equal as floats
+    static void packVertex(const Vertex& vertex, uint32_t* words)
+    {
+        memcpy(words, &vertex, sizeof(Vertex));
+
+        for (size_t i = 0; i < VERTEX_WORDS; i++)
+        {
+            if (words[i] == 0x80000000u)
+            {
+                words[i] = 0;
+            }
+        }
+    }
+
+    static uint64_t hashVertex(const Vertex& vertex)
+    {
+        uint32_t words[VERTEX_WORDS];
+        packVertex(vertex, words);
+
+        uint64_t hash = 0x9E3779B97F4A7C15ull;
+        for (size_t i = 0; i < VERTEX_WORDS; i++)
+        {
+            hash = (hash ^ words[i]) * 0xFF51AFD7ED558CCDull;
+            hash ^= hash >> 29;
+        }
+
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB9FE1A85EC53ull;
+        hash ^= hash >> 33;
+
+        return hash;
+    }
+
+    static bool sameVertex(const Vertex& a, const Vertex& b)
+    {
+        uint32_t wordsA[VERTEX_WORDS];
+        uint32_t wordsB[VERTEX_WORDS];
+        packVertex(a, wordsA);
+        packVertex(b, wordsB);
+
+        return memcmp(wordsA, wordsB, sizeof(wordsA)) == 0;
+    }
+
+    static void deduplicate(const Vertex* corners, size_t cornerCount, ArenaVector<Vertex>& vertices, ArenaVector<uint32_t>& indices,
+        ThreadPool& threadPool, Arena& scratch)
+    {
+        size_t rangeCount = (cornerCount + DEDUP_RANGE_SIZE - 1) / DEDUP_RANGE_SIZE;
+
+        // everything is carved out of the scratch arena up front, the jobs themselves never allocate
+        uint64_t* hashes = scratch.allocate<uint64_t>(cornerCount);
+        uint32_t* order = scratch.allocate<uint32_t>(cornerCount);
+        uint32_t* first = scratch.allocate<uint32_t>(cornerCount);
+        uint32_t* remap = scratch.allocate<uint32_t>(cornerCount);
+
+        size_t* rangeCounts = scratch.allocate<size_t>(rangeCount * DEDUP_PARTITION_COUNT);
+        size_t* partitionStart = scratch.allocate<size_t>(DEDUP_PARTITION_COUNT + 1);
+        size_t* tableStart = scratch.allocate<size_t>(DEDUP_PARTITION_COUNT + 1);
+        size_t* newCounts = scratch.allocate<size_t>(rangeCount + 1);
+
+        memset(rangeCounts, 0, sizeof(size_t) * rangeCount * DEDUP_PARTITION_COUNT);
+
+        // hash every corner and count how many land in each partition per range
+        threadPool.parallelFor(rangeCount, [&](size_t range)
+        {
+            size_t begin = range * DEDUP_RANGE_SIZE;
+            size_t end = begin + DEDUP_RANGE_SIZE < cornerCount ? begin + DEDUP_RANGE_SIZE : cornerCount;
+            size_t* counts = rangeCounts + range * DEDUP_PARTITION_COUNT;
+
+            for (size_t i = begin; i < end; i++)
+            {
+                hashes[i] = hashVertex(corners[i]);
+                counts[hashes[i] >> (64 - DEDUP_PARTITION_BITS)]++;
+            }
+        });
+
+        // turn the counts into scatter offsets, ranges stay in order inside a partition so corners stay sorted
+        size_t offset = 0;
+        for (uint32_t partition = 0; partition < DEDUP_PARTITION_COUNT; partition++)
+        {
+            partitionStart[partition] = offset;
+
+            for (size_t range = 0; range < rangeCount; range++)
+            {
+                size_t count = rangeCounts[range * DEDUP_PARTITION_COUNT + partition];
+                rangeCounts[range * DEDUP_PARTITION_COUNT + partition] = offset;
+                offset += count;
+            }
+        }
+        partitionStart[DEDUP_PARTITION_COUNT] = offset;
+
+        // tables are kept at most half full
+        size_t tableSize = 0;
+        for (uint32_t partition = 0; partition < DEDUP_PARTITION_COUNT; partition++)
+        {
+            size_t capacity = 16;
+            while (capacity < (partitionStart[partition + 1] - partitionStart[partition]) * 2)
+            {
+                capacity *= 2;
+            }
+
+            tableStart[partition] = tableSize;
+            tableSize += capacity;
+        }
+        tableStart[DEDUP_PARTITION_COUNT] = tableSize;
+
+        Slot* tables = scratch.allocate<Slot>(tableSize);
+
+        threadPool.parallelFor(rangeCount, [&](size_t range)
+        {
+            size_t begin = range * DEDUP_RANGE_SIZE;
+            size_t end = begin + DEDUP_RANGE_SIZE < cornerCount ? begin + DEDUP_RANGE_SIZE : cornerCount;
+            size_t* offsets = rangeCounts + range * DEDUP_PARTITION_COUNT;
+
+            for (size_t i = begin; i < end; i++)
+            {
+                order[offsets[hashes[i] >> (64 - DEDUP_PARTITION_BITS)]++] = static_cast<uint32_t>(i);
+            }
+        });
+
+        // every partition finds the first corner of each distinct vertex it holds
+        threadPool.parallelFor(DEDUP_PARTITION_COUNT, [&](size_t partition)
+        {
+            Slot* table = tables + tableStart[partition];
+            size_t mask = tableStart[partition + 1] - tableStart[partition] - 1;
+
+            for (size_t i = 0; i <= mask; i++)
+            {
+                table[i] = { 0, DEDUP_EMPTY };
+            }
+
+            for (size_t i = partitionStart[partition]; i < partitionStart[partition + 1]; i++)
+            {
+                uint32_t corner = order[i];
+                uint32_t tag = static_cast<uint32_t>(hashes[corner]);
+
+                size_t slot = tag & mask;
+                for (;;)
+                {
+                    if (table[slot].corner == DEDUP_EMPTY)
+                    {
+                        table[slot] = { tag, corner };
+                        first[corner] = corner;
+                        break;
+                    }
+
+                    if (table[slot].tag == tag && sameVertex(corners[table[slot].corner], corners[corner]))
+                    {
+                        first[corner] = table[slot].corner;
+                        break;
+                    }
+
+                    slot = (slot + 1) & mask;
+                }
+            }
+        });
+
+        // number the distinct vertices in order of first use
+        threadPool.parallelFor(rangeCount, [&](size_t range)
+        {
+            size_t begin = range * DEDUP_RANGE_SIZE;
+            size_t end = begin + DEDUP_RANGE_SIZE < cornerCount ? begin + DEDUP_RANGE_SIZE : cornerCount;
+
+            size_t count = 0;
+            for (size_t i = begin; i < end; i++)
+            {
+                count += first[i] == i;
+            }
+
+            newCounts[range] = count;
+        });
+
+        size_t vertexCount = 0;
+        for (size_t range = 0; range < rangeCount; range++)
+        {
+            size_t count = newCounts[range];
+            newCounts[range] = vertexCount;
+            vertexCount += count;
+        }
+
+        vertices.resize(vertexCount);
+        indices.resize(cornerCount);
+
+        threadPool.parallelFor(rangeCount, [&](size_t range)
+        {
+            size_t begin = range * DEDUP_RANGE_SIZE;
+            size_t end = begin + DEDUP_RANGE_SIZE < cornerCount ? begin + DEDUP_RANGE_SIZE : cornerCount;
+
+            size_t next = newCounts[range];
+            for (size_t i = begin; i < end; i++)
+            {
+                if (first[i] == i)
+                {
+                    remap[i] = static_cast<uint32_t>(next);
+                    vertices[next++] = corners[i];
+                }
+            }
+        });
+
+        threadPool.parallelFor(rangeCount, [&](size_t range)
+        {
+            size_t begin = range * DEDUP_RANGE_SIZE;
+            size_t end = begin + DEDUP_RANGE_SIZE < cornerCount ? begin + DEDUP_RANGE_SIZE : cornerCount;
+
+            for (size_t i = begin; i < end; i++)
+            {
+                indices[i] = remap[first[i]];
+            }
+        });
+    }
+};
+
+#endif // VERTEX_DEDUP_H
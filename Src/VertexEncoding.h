@@ -0,0 +1,346 @@
+#ifndef VERTEX_ENCODING_H
+#define VERTEX_ENCODING_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+#include "CompactVertex.h"
+#include "ThreadPool.h"
+
+// how the vertex shader gets back to object space: position = xyz + w * stored, texCoord = zw + xy * stored
+struct VertexTransform
+{
+    glm::vec4 position = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    glm::vec4 texCoord = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+};
+
+// converts loaded vertices and indices into the layouts the geometry arena stores
+namespace VertexEncoding
+{
+    const size_t ENCODE_RANGE_SIZE = 64 * 1024;
+
+    // largest vertex count 16 bit indices can address
+    const size_t MAX_INDEX16_VERTICES = 65536;
+
+    static uint32_t getVertexStride(VertexFormat format)
+    {
+        return format == VertexFormat::Full ? sizeof(Vertex) : sizeof(CompactVertex);
+    }
+
+    static const char* getFormatName(VertexFormat format)
+    {
+        switch (format)
+        {
+        case VertexFormat::Quantized:
+            return "quantized";
+        case VertexFormat::Half:
+            return "half";
+        default:
+            return "full";
+        }
+    }
+
+    static VkVertexInputBindingDescription getBindingDescription(VertexFormat format)
+    {
+        return format == VertexFormat::Full ? Vertex::getBindingDescription() : CompactVertex::getBindingDescription();
+    }
+
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(VertexFormat format)
+    {
+        if (format == VertexFormat::Full)
+        {
+            auto attributeDescriptions = Vertex::getAttributeDescriptions();
+            return std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end());
+        }
+
+        auto attributeDescriptions = CompactVertex::getAttributeDescriptions(format);
+        return std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end());
+    }
+
+    static VkIndexType selectIndexType(size_t vertexCount)
+    {
+        return vertexCount <= MAX_INDEX16_VERTICES ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    }
+
+    static uint32_t getIndexSize(VkIndexType indexType)
+    {
+        return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    // round to nearest even, overflow becomes infinity and tiny values become half denormals
+    static uint16_t floatToHalf(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        uint32_t sign = (bits >> 16) & 0x8000;
+        uint32_t biasedExponent = (bits >> 23) & 0xFF;
+        uint32_t mantissa = bits & 0x7FFFFF;
+
+        if (biasedExponent == 0xFF)
+        {
+            return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+        }
+
+        int32_t exponent = static_cast<int32_t>(biasedExponent) - 127 + 15;
+
+        if (exponent >= 31)
+        {
+            return static_cast<uint16_t>(sign | 0x7C00);
+        }
+
+        if (exponent <= 0)
+        {
+            if (exponent < -10)
+            {
+                return static_cast<uint16_t>(sign);
+            }
+
+            mantissa |= 0x800000;
+
+            uint32_t shift = static_cast<uint32_t>(14 - exponent);
+            uint32_t half = mantissa >> shift;
+            uint32_t rest = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+
+            if (rest > halfway || (rest == halfway && (half & 1)))
+            {
+                half++;
+            }
+
+            return static_cast<uint16_t>(sign | half);
+        }
+
+        uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+        uint32_t rest = mantissa & 0x1FFF;
+
+        // a carry out of the mantissa correctly bumps the exponent
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        {
+            half++;
+        }
+
+        return static_cast<uint16_t>(half);
+    }
+
+    static int16_t toSnorm16(float value)
+    {
+        value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+        return static_cast<int16_t>(std::lround(value * 32767.0f));
+    }
+
+    static uint16_t toUnorm16(float value)
+    {
+        value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+        return static_cast<uint16_t>(std::lround(value * 65535.0f));
+    }
+
+    // octahedral mapping, the unit sphere folded onto a square. two 16 bit components keep the error well under
+    // what an 8 bit normal map would give
+    static void encodeOctahedral(const glm::vec3& normal, int16_t* encoded)
+    {
+        float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+        glm::vec2 projected = length > 0.0f ? glm::vec2(normal.x, normal.y) / length : glm::vec2(0.0f);
+
+        if (normal.z < 0.0f)
+        {
+            glm::vec2 folded = 1.0f - glm::abs(glm::vec2(projected.y, projected.x));
+            projected.x = projected.x >= 0.0f ? folded.x : -folded.x;
+            projected.y = projected.y >= 0.0f ? folded.y : -folded.y;
+        }
+
+        encoded[0] = toSnorm16(projected.x);
+        encoded[1] = toSnorm16(projected.y);
+    }
+
+    // positions are quantized inside the bounds with one scale for all axes, so the normal matrix is unaffected
+    static VertexTransform computeTransform(VertexFormat format, const Vertex* vertices, size_t vertexCount, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        VertexTransform transform;
+
+        if (format != VertexFormat::Quantized || vertexCount == 0)
+        {
+            return transform;
+        }
+
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+        float scale = std::max(extent.x, std::max(extent.y, extent.z));
+
+        transform.position = glm::vec4(center, scale > 0.0f ? scale : 1.0f);
+
+        glm::vec2 texCoordMin = vertices[0].texCoord;
+        glm::vec2 texCoordMax = vertices[0].texCoord;
+
+        for (size_t i = 1; i < vertexCount; i++)
+        {
+            texCoordMin = glm::min(texCoordMin, vertices[i].texCoord);
+            texCoordMax = glm::max(texCoordMax, vertices[i].texCoord);
+        }
+
+        glm::vec2 texCoordRange = texCoordMax - texCoordMin;
+        transform.texCoord = glm::vec4(texCoordRange.x > 0.0f ? texCoordRange.x : 1.0f, texCoordRange.y > 0.0f ? texCoordRange.y : 1.0f, texCoordMin.x, texCoordMin.y);
+
+        return transform;
+    }
+
+    static void encodeVertex(VertexFormat format, const Vertex& vertex, const VertexTransform& transform, CompactVertex& encoded)
+    {
+        if (format == VertexFormat::Quantized)
+        {
+            glm::vec3 position = (vertex.pos - glm::vec3(transform.position)) / transform.position.w;
+            glm::vec2 texCoord = (vertex.texCoord - glm::vec2(transform.texCoord.z, transform.texCoord.w)) / glm::vec2(transform.texCoord.x, transform.texCoord.y);
+
+            encoded.position[0] = static_cast<uint16_t>(toSnorm16(position.x));
+            encoded.position[1] = static_cast<uint16_t>(toSnorm16(position.y));
+            encoded.position[2] = static_cast<uint16_t>(toSnorm16(position.z));
+            encoded.position[3] = 0;
+
+            encoded.texCoord[0] = toUnorm16(texCoord.x);
+            encoded.texCoord[1] = toUnorm16(texCoord.y);
+        }
+        else
+        {
+            encoded.position[0] = floatToHalf(vertex.pos.x);
+            encoded.position[1] = floatToHalf(vertex.pos.y);
+            encoded.position[2] = floatToHalf(vertex.pos.z);
+            encoded.position[3] = 0;
+
+            encoded.texCoord[0] = floatToHalf(vertex.texCoord.x);
+            encoded.texCoord[1] = floatToHalf(vertex.texCoord.y);
+        }
+
+        encodeOctahedral(vertex.normal, encoded.normal);
+    }
+
+    // destination holds vertexCount CompactVertex, only called for the compact formats
+    static void encodeVertices(VertexFormat format, const Vertex* vertices, size_t vertexCount, const VertexTransform& transform,
+        CompactVertex* destination, ThreadPool& threadPool)
+    {
+        threadPool.parallelFor((vertexCount + ENCODE_RANGE_SIZE - 1) / ENCODE_RANGE_SIZE, [&](size_t range)
+        {
+            size_t begin = range * ENCODE_RANGE_SIZE;
+            size_t end = begin + ENCODE_RANGE_SIZE < vertexCount ? begin + ENCODE_RANGE_SIZE : vertexCount;
+
+            for (size_t i = begin; i < end; i++)
+            {
+                encodeVertex(format, vertices[i], transform, destination[i]);
+            }
+        });
+    }
+
+    static float halfToFloat(uint16_t half)
+    {
+        uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+        uint32_t exponent = (half >> 10) & 0x1F;
+        uint32_t mantissa = half & 0x3FF;
+        uint32_t bits;
+
+        if (exponent == 0x1F)
+        {
+            bits = sign | 0x7F800000 | (mantissa << 13);
+        }
+        else if (exponent != 0)
+        {
+            bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+        }
+        else if (mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // a half denormal is a normal float, shift the mantissa up until its leading bit is the implicit one
+            exponent = 127 - 14;
+
+            while ((mantissa & 0x400) == 0)
+            {
+                mantissa <<= 1;
+                exponent--;
+            }
+
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+        }
+
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    static glm::vec3 decodeOctahedral(const int16_t* encoded)
+    {
+        glm::vec2 projected(std::max(encoded[0] / 32767.0f, -1.0f), std::max(encoded[1] / 32767.0f, -1.0f));
+        glm::vec3 normal(projected.x, projected.y, 1.0f - std::fabs(projected.x) - std::fabs(projected.y));
+
+        if (normal.z < 0.0f)
+        {
+            glm::vec2 folded = 1.0f - glm::abs(glm::vec2(normal.y, normal.x));
+            normal.x = normal.x >= 0.0f ? folded.x : -folded.x;
+            normal.y = normal.y >= 0.0f ? folded.y : -folded.y;
+        }
+
+        return glm::normalize(normal);
+    }
+
+    // what the vertex shader would see, for a baked mesh whose format is not the one the renderer draws with
+    static void decodeVertex(VertexFormat format, const CompactVertex& encoded, const VertexTransform& transform, Vertex& vertex)
+    {
+        if (format == VertexFormat::Quantized)
+        {
+            glm::vec3 position(std::max(static_cast<int16_t>(encoded.position[0]) / 32767.0f, -1.0f),
+                std::max(static_cast<int16_t>(encoded.position[1]) / 32767.0f, -1.0f),
+                std::max(static_cast<int16_t>(encoded.position[2]) / 32767.0f, -1.0f));
+            glm::vec2 texCoord(encoded.texCoord[0] / 65535.0f, encoded.texCoord[1] / 65535.0f);
+
+            vertex.pos = glm::vec3(transform.position) + transform.position.w * position;
+            vertex.texCoord = glm::vec2(transform.texCoord.z, transform.texCoord.w) + glm::vec2(transform.texCoord.x, transform.texCoord.y) * texCoord;
+        }
+        else
+        {
+            vertex.pos = glm::vec3(halfToFloat(encoded.position[0]), halfToFloat(encoded.position[1]), halfToFloat(encoded.position[2]));
+            vertex.texCoord = glm::vec2(halfToFloat(encoded.texCoord[0]), halfToFloat(encoded.texCoord[1]));
+        }
+
+        vertex.normal = decodeOctahedral(encoded.normal);
+        vertex.color = glm::vec3(1.0f);
+    }
+
+    static void decodeVertices(VertexFormat format, const CompactVertex* encoded, size_t vertexCount, const VertexTransform& transform,
+        Vertex* destination, ThreadPool& threadPool)
+    {
+        threadPool.parallelFor((vertexCount + ENCODE_RANGE_SIZE - 1) / ENCODE_RANGE_SIZE, [&](size_t range)
+        {
+            size_t begin = range * ENCODE_RANGE_SIZE;
+            size_t end = begin + ENCODE_RANGE_SIZE < vertexCount ? begin + ENCODE_RANGE_SIZE : vertexCount;
+
+            for (size_t i = begin; i < end; i++)
+            {
+                decodeVertex(format, encoded[i], transform, destination[i]);
+            }
+        });
+    }
+
+    static void encodeIndices16(const uint32_t* indices, size_t indexCount, uint16_t* destination)
+    {
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            destination[i] = static_cast<uint16_t>(indices[i]);
+        }
+    }
+
+    static void decodeIndices16(const uint16_t* indices, size_t indexCount, uint32_t* destination)
+    {
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            destination[i] = indices[i];
+        }
+    }
+};
+
+#endif // VERTEX_ENCODING_H
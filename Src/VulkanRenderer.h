@@ -8,6 +8,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <functional>
 #include <stdexcept>
 #include <algorithm>
 #include <vector>
@@ -28,18 +29,61 @@
 #include "stb_image.h"
 
 #include "Buffer.h"
+#include "CommandBuffer.h"
+#include "MemoryAllocator.h"
+#include "StagingRing.h"
+#include "UploadContext.h"
+#include "GeometryArena.h"
+#include "UniformRing.h"
+#include "RenderTargetPool.h"
+#include "DeletionQueue.h"
+#include "Arena.h"
+#include "ThreadPool.h"
 #include "SwapChain.h"
 #include "QueueFamily.h"
 #include "Model.h"
 #include "Texture.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "AssetLoader.h"
 #include "ImageView.h"
 #include "Camera.h"
+#include "AssetPaths.h"
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+const VkDeviceSize STAGING_RING_SIZE = 32ull * 1024 * 1024; // all uploads go through this, larger ones are chunked
+
+// every model shares blocks of this size, sized so each buffer fits in one geometry pool block. the arena adds
+// another block when they are full, a larger one for a mesh that would not fit this size
+const uint32_t GEOMETRY_ARENA_VERTICES = 1024 * 1024;
+const uint32_t GEOMETRY_ARENA_INDICES = 4 * 1024 * 1024;
+
+// shader sources, the spir-v is found through AssetPaths::resolveShader
+// compact formats need shader_compact.vert compiled, without it the full layout is used
+const VertexFormat MODEL_VERTEX_FORMAT = VertexFormat::Quantized;
+const std::string FULL_VERTEX_SHADER_PATH = "Shaders/shader.vert";
+const std::string COMPACT_VERTEX_SHADER_PATH = "Shaders/shader_compact.vert";
+
+// packed material maps need shader_packed.frag compiled, without it roughness maps are bound on their own
+const std::string FRAGMENT_SHADER_PATH = "Shaders/shader.frag";
+const std::string PACKED_FRAGMENT_SHADER_PATH = "Shaders/shader_packed.frag";
+
+const double MEMORY_REPORT_INTERVAL = 5.0; // seconds between memory report dumps
+const std::string MEMORY_REPORT_PATH = "memory_report.json";
+
+const VkDeviceSize UNIFORM_RING_FRAME_SIZE = 1024 * 1024; // per-draw uniform space of one frame in flight
+const size_t FRAME_ALLOCATOR_BLOCK_SIZE = 256 * 1024; // cpu scratch of one frame in flight, draw lists and the like
+
+const float LOD_PIXEL_ERROR = 1.0f; // how many pixels a level's simplification error may cover on screen
+const float LOD_HYSTERESIS = 0.25f; // how far below that a coarser level has to be before switching to it
+
+// device memory the finer mip levels of baked textures may take, at most half of the largest device local heap
+const VkDeviceSize TEXTURE_STREAMING_BUDGET = 512ull * 1024 * 1024;
+
 std::unique_ptr<Camera> camera;
 bool firstMouse = true; // Keeps track of if mouse has been used yet
 float lastX = WIDTH / 2; // Keeps track of mouse since last frame
@@ -61,6 +105,9 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
+// load timings and streaming settings on the console, for profiling startup
+const bool enableVerboseOutput = false;
+
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
     auto func = (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
     if (func != nullptr) {
@@ -89,6 +136,9 @@ struct UniformBufferObject
     glm::vec3 viewPos;
     glm::vec3 lightColor;
 
+    // only read by shader_compact.vert, std140 starts a vec4 on a 16 byte boundary
+    alignas(16) glm::vec4 positionTransform;
+    alignas(16) glm::vec4 texCoordTransform;
 };
 
 
@@ -96,14 +146,24 @@ class VulkanRenderer
 {
 public:
 
-    void run() {
+    // paths given on the command line (model, base color, roughness) skip the prompts
+    void run(const std::vector<std::string>& paths = {}) {
 
-        std::cout << "Enter the path to the obj file (Leave blank for testing): " << std::endl;
-        std::getline(std::cin, modelPath);
-        std::cout << "Enter the path to the base color texture file (Leave blank for testing): " << std::endl;
-        std::getline(std::cin, baseColorPath);
-        std::cout << "Enter the path to the roughness texture file (Leave blank for testing): " << std::endl;
-        std::getline(std::cin, roughnessPath);
+        if (paths.size() != 3)
+        {
+            std::cout << "Enter the path to the obj file (Leave blank for testing): " << std::endl;
+            std::getline(std::cin, modelPath);
+            std::cout << "Enter the path to the base color texture file (Leave blank for testing): " << std::endl;
+            std::getline(std::cin, baseColorPath);
+            std::cout << "Enter the path to the roughness texture file (Leave blank for testing): " << std::endl;
+            std::getline(std::cin, roughnessPath);
+        }
+        else
+        {
+            modelPath = paths[0];
+            baseColorPath = paths[1];
+            roughnessPath = paths[2];
+        }
 
 
         if (modelPath == "" || baseColorPath == "" || roughnessPath == "") //  Testing Mode
@@ -113,6 +173,11 @@ public:
             roughnessPath = "Resources/Models/Croissant/croissant_01_L0_Roughness.png";
         }
 
+        // load what assetbake produced when it is there, the sources are only a fallback for development.
+        // the roughness map stays a source path, the maps packed with it are found next to it
+        modelPath = AssetPaths::resolve(modelPath);
+        baseColorPath = AssetPaths::resolve(baseColorPath);
+
         initWindow();
         initVulkan();
         mainLoop();
@@ -155,26 +220,48 @@ private:
 
     VkQueue presentQueue;
 
+    VkQueue transferQueue; // same as graphicsQueue when the device has no separate transfer family
+
     VkSurfaceKHR surface;
 
+    std::unique_ptr<MemoryAllocator> allocator;
+
+    bool memoryBudgetSupported = false; // instance side of VK_EXT_memory_budget is available
+    bool memoryBudgetEnabled = false;
+    double lastMemoryReport = 0.0;
+
+    std::unique_ptr<RenderTargetPool> renderTargetPool;
+
+    std::unique_ptr<DeletionQueue> deletionQueue;
+    std::unique_ptr<FrameAllocator> frameAllocator;
+    std::unique_ptr<ThreadPool> threadPool;
+
+    std::unique_ptr<StagingRing> stagingRing;
+
+    std::unique_ptr<UploadContext> uploadContext;
+
+    std::unique_ptr<GeometryArena> geometryArena;
+    VertexFormat vertexFormat = VertexFormat::Full;
+    bool packedMaterialMaps = false; // binding 2 holds occlusion, roughness and metalness instead of roughness alone
+
     std::unique_ptr<SwapChain> swapChain;
 
     VkRenderPass renderPass;
     VkDescriptorSetLayout descriptorSetLayout;
     VkPipelineLayout pipelineLayout;
 
-    VkDescriptorPool descriptorPool;
-    std::vector<VkDescriptorSet> descriptorSets;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE; // created once the model has loaded and its materials are known
+    std::vector<VkDescriptorSet> descriptorSets; // one per material and frame in flight, material * MAX_FRAMES_IN_FLIGHT + frame
+    std::vector<uint8_t> descriptorSetsDirty; // rewritten once the frame that last used them has finished
 
     VkPipeline graphicsPipeline;
+    std::vector<VkPipeline> pipelines; // every pipeline created, a draw's index in here is the high part of its sort key
 
     VkCommandPool commandPool;
 
     std::unique_ptr<Model> model;
 
-    std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
-    std::vector<void*> uniformBuffersMapped;
+    std::unique_ptr<UniformRing> uniformRing;
 
     std::vector<VkCommandBuffer> commandBuffers;
 
@@ -182,8 +269,17 @@ private:
     std::vector<VkSemaphore> renderFinishedSemaphores;
     std::vector<VkFence> inFlightFences;
 
-    std::unique_ptr<Texture> baseColorTexture;
-    std::unique_ptr<Texture> roughnessTexture;
+    std::unique_ptr<AssetLoader> assetLoader;
+    double loadStartTime = 0.0;
+    bool firstFramePresented = false;
+
+    std::unique_ptr<TextureStreamer> textureStreamer;
+    std::unique_ptr<TextureCache> textureCache;
+    std::vector<MaterialTextures> materialTextures; // indexed like model->materials
+
+    // bound until the real textures have arrived, and for good when they fail to load
+    std::unique_ptr<Texture> placeholderBaseColor;
+    std::unique_ptr<Texture> placeholderRoughness;
 
     bool framebufferResized = false;
 
@@ -230,26 +326,40 @@ private:
     {
         std::cout << "Begining Vulkan Initialization" << std::endl;
 
+        loadStartTime = glfwGetTime();
+
         createInstance();
         setupDebugMessenger();
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
+        createAllocator();
+        createRenderTargetPool();
+        createDeletionQueue();
+        createFrameAllocator();
+        createThreadPool();
+        createStagingRing();
+        createUploadContext();
+        selectVertexFormat();
+        selectMaterialMaps();
+        createGeometryArena();
         createSwapChain();
         createRenderPass();
         createDescriptorSetLayout();
         createGraphicsPipeline();
         createCommandPool();
         createFramebuffers();
-        createTextureImage();
-        createModel();
-        createUniformBuffers();
-        createDescriptorPool();
-        createDescriptorSets();
+        createAssetLoader();
+        createPlaceholderTextures();
+        flushUploads();
+        createUniformRing();
         createCommandBuffers();
         createSyncObjects();
         createCamera();
 
+        // frames are presented from here on, the model and its textures appear as they finish loading
+        loadModel();
+
         std::cout << "Finished Vulkan Initialization" << std::endl;
     }
 
@@ -301,10 +411,32 @@ private:
         while (!glfwWindowShouldClose(window))
         {
             glfwPollEvents();
+            assetLoader->update();
+            requestTextureLevels();
+            textureStreamer->update();
             drawFrame();
+
+            if (glfwGetTime() - lastMemoryReport >= MEMORY_REPORT_INTERVAL)
+            {
+                lastMemoryReport = glfwGetTime();
+                allocator->writeMemoryReport(MEMORY_REPORT_PATH);
+
+                // block allocations are the only heap traffic the frame allocator causes, this should read zero once warmed up
+                if (enableVerboseOutput)
+                {
+                    ArenaStats frameStats = frameAllocator->getStats();
+                    std::cout << "frame allocator: " << frameStats.allocations << " allocations, " << frameStats.blockAllocations << " heap blocks since last report" << std::endl;
+                }
+
+                frameAllocator->resetStats();
+            }
         }
 
+        // loads still running have to land before anything they use is destroyed
+        assetLoader->waitIdle();
         vkDeviceWaitIdle(device);
+
+        allocator->writeMemoryReport(MEMORY_REPORT_PATH);
     }
 
     void cleanup() 
@@ -313,25 +445,36 @@ private:
 
         cleanupSwapChain();
 
-        vkDestroyPipeline(device, graphicsPipeline, nullptr);
+        for (VkPipeline pipeline : pipelines)
+        {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        }
+        pipelines.clear();
+
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
         vkDestroyRenderPass(device, renderPass, nullptr);
 
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        uniformRing->destroyUniformRing();
+
+        if (descriptorPool != VK_NULL_HANDLE)
         {
-            vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-            vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+            vkDestroyDescriptorPool(device, descriptorPool, nullptr);
         }
 
-        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        textureCache->destroyTextureCache();
+        placeholderBaseColor->destroyTexture();
+        placeholderRoughness->destroyTexture();
 
-        baseColorTexture->destroyTexture();
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-        roughnessTexture->destroyTexture();
+        if (model)
+        {
+            model->destroyModel();
+        }
 
-        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        deletionQueue->flush(); // the device is idle, run everything that was deferred
 
-        model->destroyModel();
+        geometryArena->destroyGeometryArena();
 
         for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         {
@@ -342,6 +485,14 @@ private:
 
         vkDestroyCommandPool(device, commandPool, nullptr);
 
+        uploadContext->destroyUploadContext();
+
+        stagingRing->destroyStagingRing();
+
+        renderTargetPool->destroyRenderTargetPool();
+
+        allocator->destroyAllocator();
+
         vkDestroyDevice(device, nullptr);
 
         if (enableValidationLayers)
@@ -455,6 +606,25 @@ private:
         return requiredExtensions.empty();
     }
 
+    bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName)
+    {
+        unsigned int extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+        for (const auto& extension : availableExtensions)
+        {
+            if (strcmp(extension.extensionName, extensionName) == 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     void createLogicalDevice()
     {
         QueueFamily::QueueFamilyIndices indices = QueueFamily::findQueueFamilies(physicalDevice, surface);
@@ -462,6 +632,11 @@ private:
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<unsigned int> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
+        if (indices.transferFamily.has_value())
+        {
+            uniqueQueueFamilies.insert(indices.transferFamily.value());
+        }
+
         float queuePriority = 1.0f;
         for (unsigned int queueFamily : uniqueQueueFamilies)
         {
@@ -473,8 +648,12 @@ private:
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
         VkPhysicalDeviceFeatures deviceFeatures{};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC; // baked textures are BC compressed
 
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -482,8 +661,16 @@ private:
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
         createInfo.pEnabledFeatures = &deviceFeatures;
 
-        createInfo.enabledExtensionCount = static_cast<unsigned int>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        std::vector<const char*> extensions(deviceExtensions.begin(), deviceExtensions.end());
+
+        if (memoryBudgetSupported && isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+        {
+            extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            memoryBudgetEnabled = true;
+        }
+
+        createInfo.enabledExtensionCount = static_cast<unsigned int>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         if (enableValidationLayers) 
         {
@@ -503,6 +690,15 @@ private:
         vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
         vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
 
+        if (indices.transferFamily.has_value())
+        {
+            vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+        }
+        else
+        {
+            transferQueue = graphicsQueue;
+        }
+
     }
 
     void createSurface() {
@@ -512,9 +708,90 @@ private:
         }
     }
 
+    void createAllocator()
+    {
+        allocator = std::make_unique<MemoryAllocator>(instance, physicalDevice, device, memoryBudgetEnabled);
+    }
+
+    void createRenderTargetPool()
+    {
+        renderTargetPool = std::make_unique<RenderTargetPool>(device, *allocator);
+    }
+
+    void createDeletionQueue()
+    {
+        deletionQueue = std::make_unique<DeletionQueue>(MAX_FRAMES_IN_FLIGHT);
+    }
+
+    void createFrameAllocator()
+    {
+        frameAllocator = std::make_unique<FrameAllocator>(FRAME_ALLOCATOR_BLOCK_SIZE, MAX_FRAMES_IN_FLIGHT);
+    }
+
+    void createThreadPool()
+    {
+        threadPool = std::make_unique<ThreadPool>();
+    }
+
+    void createStagingRing()
+    {
+        stagingRing = std::make_unique<StagingRing>(STAGING_RING_SIZE, *allocator);
+    }
+
+    void createUploadContext()
+    {
+        QueueFamily::QueueFamilyIndices indices = QueueFamily::findQueueFamilies(physicalDevice, surface);
+
+        uint32_t transferFamily = indices.transferFamily.value_or(indices.graphicsFamily.value());
+
+        uploadContext = std::make_unique<UploadContext>(device, graphicsQueue, indices.graphicsFamily.value(), transferQueue, transferFamily, *stagingRing);
+    }
+
+    void createGeometryArena()
+    {
+        geometryArena = std::make_unique<GeometryArena>(vertexFormat, GEOMETRY_ARENA_VERTICES, GEOMETRY_ARENA_INDICES, *allocator);
+    }
+
+    // falls back to the full layout when the compact shader has not been compiled or the device cannot fetch the formats
+    void selectVertexFormat()
+    {
+        vertexFormat = MODEL_VERTEX_FORMAT;
+
+        if (vertexFormat == VertexFormat::Full)
+        {
+            return;
+        }
+
+        bool supported = std::ifstream(AssetPaths::resolveShader(COMPACT_VERTEX_SHADER_PATH)).good();
+
+        for (const VkVertexInputAttributeDescription& attribute : VertexEncoding::getAttributeDescriptions(vertexFormat))
+        {
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, attribute.format, &properties);
+
+            supported = supported && (properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT);
+        }
+
+        if (!supported)
+        {
+            std::cout << VertexEncoding::getFormatName(vertexFormat) << " vertex format is unavailable, using full vertices" << std::endl;
+            vertexFormat = VertexFormat::Full;
+        }
+    }
+
+    void selectMaterialMaps()
+    {
+        packedMaterialMaps = std::ifstream(AssetPaths::resolveShader(PACKED_FRAGMENT_SHADER_PATH)).good();
+
+        if (!packedMaterialMaps)
+        {
+            std::cout << "packed material maps are unavailable, using separate roughness maps" << std::endl;
+        }
+    }
+
     void createSwapChain()
     {
-        swapChain = std::make_unique<SwapChain>(physicalDevice, surface, device, window);
+        swapChain = std::make_unique<SwapChain>(physicalDevice, surface, device, *renderTargetPool, window);
     }
 
     std::vector<const char*> getRequiredExtensions()
@@ -530,6 +807,22 @@ private:
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         }
 
+        // needed by VK_EXT_memory_budget on a 1.0 instance
+        unsigned int extensionCount = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+
+        for (const auto& extension : availableExtensions)
+        {
+            if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+            {
+                extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+                memoryBudgetSupported = true;
+            }
+        }
+
         return extensions;
     }
 
@@ -585,8 +878,8 @@ private:
 
         // start of shader building 
 
-        auto vertShaderCode = readFile("Shaders/vert.spv");
-        auto fragShaderCode = readFile("Shaders/frag.spv");
+        auto vertShaderCode = readFile(AssetPaths::resolveShader(vertexFormat == VertexFormat::Full ? FULL_VERTEX_SHADER_PATH : COMPACT_VERTEX_SHADER_PATH));
+        auto fragShaderCode = readFile(AssetPaths::resolveShader(packedMaterialMaps ? PACKED_FRAGMENT_SHADER_PATH : FRAGMENT_SHADER_PATH));
 
         VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
         VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
@@ -610,8 +903,8 @@ private:
         // vertex data
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        auto bindingDescription = Vertex::getBindingDescription();
-        auto attributeDescriptions = Vertex::getAttributeDescriptions();
+        auto bindingDescription = VertexEncoding::getBindingDescription(vertexFormat);
+        auto attributeDescriptions = VertexEncoding::getAttributeDescriptions(vertexFormat);
         vertexInputInfo.vertexBindingDescriptionCount = 1;
         vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
         vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
@@ -744,6 +1037,8 @@ private:
             throw std::runtime_error("failed to create graphics pipeline");
         }
 
+        pipelines.push_back(graphicsPipeline);
+
         vkDestroyShaderModule(device, fragShaderModule, nullptr);
         vkDestroyShaderModule(device, vertShaderModule, nullptr);
 
@@ -791,7 +1086,7 @@ private:
         colorAttachment.samples = swapChain->msaaSamples;
 
         colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // resolved, the multisampled image is transient
 
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -887,10 +1182,14 @@ private:
 
         vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
+        deletionQueue->collect(currentFrame);
+        frameAllocator->beginFrame(currentFrame);
+        updateDescriptorSets(currentFrame);
+
         unsigned int imageIndex;
         VkResult result = vkAcquireNextImageKHR(device, swapChain->swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
 
-        updateUniformBuffer(currentFrame);
+        uint32_t uniformOffset = updateUniformBuffer(currentFrame);
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR)
         {
@@ -906,7 +1205,45 @@ private:
         vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
         vkResetCommandBuffer(commandBuffers[currentFrame], 0);
-        CommandBuffer::recordCommandBuffer(commandBuffers[currentFrame], imageIndex, renderPass, swapChain->swapChainFramebuffers, swapChain->swapChainExtent, graphicsPipeline, model->vertexBuffer, model->indexBuffer, pipelineLayout, descriptorSets, currentFrame, model->indices);
+
+        ArenaVector<DrawItem> drawList{ ArenaAllocator<DrawItem>(frameAllocator->get()) };
+
+        // one draw per submesh of the level picked for this frame, the model's submesh ranges are relative to its
+        // place in the arena. until the model has loaded the frame is only cleared
+        MeshLod lod{};
+
+        if (model)
+        {
+            lod = model->lods[selectModelLod()];
+        }
+
+        drawList.reserve(lod.submeshCount);
+
+        for (uint32_t i = 0; i < lod.submeshCount; i++)
+        {
+            const Submesh& submesh = model->submeshes[lod.firstSubmesh + i];
+
+            DrawItem draw{};
+            draw.pipeline = graphicsPipeline;
+            draw.descriptorSet = descriptorSets[submesh.materialIndex * MAX_FRAMES_IN_FLIGHT + currentFrame];
+            draw.uniformOffset = uniformOffset;
+            draw.vertexBuffer = geometryArena->getVertexBuffer(model->geometry);
+            draw.indexBuffer = geometryArena->getIndexBuffer(model->geometry);
+            draw.indexCount = submesh.indexCount;
+            draw.firstIndex = model->geometry.firstIndex + submesh.firstIndex;
+            draw.vertexOffset = model->geometry.vertexOffset;
+            draw.indexType = model->geometry.indexType;
+            draw.sortKey = CommandBuffer::getDrawSortKey(getPipelineIndex(draw.pipeline), submesh.materialIndex);
+
+            drawList.push_back(draw);
+        }
+
+        std::stable_sort(drawList.begin(), drawList.end(), [](const DrawItem& a, const DrawItem& b)
+        {
+            return a.sortKey < b.sortKey;
+        });
+
+        CommandBuffer::recordCommandBuffer(commandBuffers[currentFrame], imageIndex, renderPass, swapChain->swapChainFramebuffers, swapChain->swapChainExtent, pipelineLayout, drawList.data(), drawList.size());
 
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -953,6 +1290,16 @@ private:
             throw std::runtime_error("failed to present swap chain image");
         }
 
+        if (!firstFramePresented)
+        {
+            firstFramePresented = true;
+
+            if (enableVerboseOutput)
+            {
+                std::cout << "first frame presented after " << (glfwGetTime() - loadStartTime) * 1000.0 << " ms" << std::endl;
+            }
+        }
+
         currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT; // keep track of current frame for frames in flight
 
     }
@@ -990,7 +1337,7 @@ private:
     {
         VkDescriptorSetLayoutBinding uboLayoutBinding{};
         uboLayoutBinding.binding = 0;
-        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         uboLayoutBinding.descriptorCount = 1;
         uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
         uboLayoutBinding.pImmutableSamplers = nullptr; // optional 
@@ -1022,23 +1369,85 @@ private:
         }
     }
 
-    void createUniformBuffers()
+    void createUniformRing()
     {
-        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+        uniformRing = std::make_unique<UniformRing>(UNIFORM_RING_FRAME_SIZE, MAX_FRAMES_IN_FLIGHT, physicalDevice, *allocator);
+    }
 
-        uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-        uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-        uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    glm::mat4 getModelMatrix()
+    {
+        glm::mat4 modelMatrix = glm::rotate(glm::mat4(1.0f), glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        return glm::scale(modelMatrix, glm::vec3(0.4f, 0.4f, 0.4f)); // change model size here
+    }
 
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    // the distance to the nearest point of the model's bounding sphere, and how many pixels one object space unit
+    // covers one unit in front of the camera. anything projected from that point is as large as it gets on the model
+    void projectModelBounds(float& distance, float& pixelsPerUnit)
+    {
+        glm::mat4 modelMatrix = getModelMatrix();
+
+        float scale = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+        glm::vec3 center = glm::vec3(modelMatrix * glm::vec4((model->boundsMin + model->boundsMax) * 0.5f, 1.0f));
+        float radius = glm::length(model->boundsMax - model->boundsMin) * 0.5f * scale;
+
+        // clamped to the near plane, inside the bounds the finest level is drawn anyway
+        distance = std::max(glm::length(center - camera->Position) - radius, 0.1f);
+        pixelsPerUnit = swapChain->swapChainExtent.height / (2.0f * std::tan(glm::radians(camera->Zoom) * 0.5f)) * scale;
+    }
+
+    uint32_t getPipelineIndex(VkPipeline pipeline) const
+    {
+        auto it = std::find(pipelines.begin(), pipelines.end(), pipeline);
+        if (it == pipelines.end())
+        {
+            throw std::runtime_error("draw uses a pipeline that was not created by the renderer");
+        }
+
+        return static_cast<uint32_t>(it - pipelines.begin());
+    }
+
+    uint32_t selectModelLod()
+    {
+        float distance, pixelsPerUnit;
+        projectModelBounds(distance, pixelsPerUnit);
+
+        return model->selectLod(distance, pixelsPerUnit, LOD_PIXEL_ERROR, LOD_HYSTERESIS);
+    }
+
+    // the finest level each material texture can be sampled at is where one of its texels covers a pixel at the
+    // nearest point of the model. the pixels one level 0 texel covers there is also how urgent it is
+    void requestTextureLevels()
+    {
+        if (!model)
         {
-            Buffer::createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i], device, physicalDevice);
+            return;
+        }
+
+        float distance, pixelsPerUnit;
+        projectModelBounds(distance, pixelsPerUnit);
+
+        for (size_t i = 0; i < materialTextures.size(); i++)
+        {
+            float uvDensity = i < model->materialUvDensity.size() ? model->materialUvDensity[i] : 1.0f;
+
+            for (Texture* texture : { materialTextures[i].baseColor, materialTextures[i].roughness })
+            {
+                if (!texture)
+                {
+                    continue;
+                }
 
-            vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+                float texelsPerUnit = uvDensity * std::max(texture->width, texture->height);
+                float pixelsPerTexel = pixelsPerUnit / (distance * texelsPerUnit);
+
+                uint32_t level = pixelsPerTexel >= 1.0f ? 0 : static_cast<uint32_t>(std::floor(std::log2(1.0f / pixelsPerTexel)));
+                textureStreamer->request(texture, level, pixelsPerTexel);
+            }
         }
     }
 
-    void updateUniformBuffer(uint32_t currentImage)
+    // returns the dynamic offset of this frame's constants in the uniform ring
+    uint32_t updateUniformBuffer(uint32_t currentImage)
     {
         processInput(window);
 
@@ -1050,9 +1459,8 @@ private:
         float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
         UniformBufferObject ubo{};
-        ubo.model = glm::rotate(glm::mat4(1.0f), glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        ubo.model = getModelMatrix();
         //ubo.model = glm::rotate(ubo.model, time * glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.model = glm::scale(ubo.model, glm::vec3(0.4f, 0.4f, 0.4f)); // change model size here
 
         ubo.view = camera->GetViewMatrix();
 
@@ -1064,24 +1472,32 @@ private:
         ubo.viewPos = viewPos;
         ubo.lightPos = glm::vec3(2.0f, 2.0f, 1.0f);
 
-        memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+        VertexTransform vertexTransform = model ? model->vertexTransform : VertexTransform();
+        ubo.positionTransform = vertexTransform.position;
+        ubo.texCoordTransform = vertexTransform.texCoord;
+
+        uniformRing->beginFrame(currentImage);
+
+        return uniformRing->push(ubo);
     }
 
     void createDescriptorPool()
     {
+        uint32_t setCount = static_cast<uint32_t>(std::max<size_t>(materialTextures.size(), 1) * MAX_FRAMES_IN_FLIGHT);
+
         std::array<VkDescriptorPoolSize, 3>  poolSizes{};
-        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        poolSizes[0].descriptorCount = setCount;
         poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolSizes[1].descriptorCount = setCount;
         poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolSizes[2].descriptorCount = setCount;
 
         VkDescriptorPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
         poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolInfo.maxSets = setCount;
 
         if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
         {
@@ -1089,74 +1505,274 @@ private:
         }
     }
 
+    // every material gets its own sets with the same layout, the shaders do not know about materials at all
     void createDescriptorSets()
     {
-        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+        size_t setCount = materialTextures.size() * MAX_FRAMES_IN_FLIGHT;
+
+        if (setCount == 0)
+        {
+            return;
+        }
+
+        std::vector<VkDescriptorSetLayout> layouts(setCount, descriptorSetLayout);
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocInfo.descriptorPool = descriptorPool;
-        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(setCount);
         allocInfo.pSetLayouts = layouts.data();
 
-        descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+        descriptorSets.resize(setCount);
         if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to allocate descriptor sets");
         }
 
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        descriptorSetsDirty.assign(setCount, 0);
+
+        for (size_t i = 0; i < setCount; i++)
         {
-            VkDescriptorBufferInfo bufferInfo{};
-            bufferInfo.buffer = uniformBuffers[i];
-            bufferInfo.offset = 0;
-            bufferInfo.range = sizeof(UniformBufferObject);
-
-            VkDescriptorImageInfo baseColorInfo{};
-            baseColorInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            baseColorInfo.imageView = baseColorTexture->textureImage->getImageView();
-            baseColorInfo.sampler = baseColorTexture->textureSampler;
-
-            VkDescriptorImageInfo roughnessInfo{};
-            roughnessInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            roughnessInfo.imageView = roughnessTexture->textureImage->getImageView();
-            roughnessInfo.sampler = roughnessTexture->textureSampler;
-
-            std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
-
-            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[0].dstSet = descriptorSets[i];
-            descriptorWrites[0].dstBinding = 0;
-            descriptorWrites[0].dstArrayElement = 0;
-            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptorWrites[0].descriptorCount = 1;
-            descriptorWrites[0].pBufferInfo = &bufferInfo;
-            descriptorWrites[0].pImageInfo = nullptr; // optional
-            descriptorWrites[0].pTexelBufferView = nullptr; // optional
-
-            descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[1].dstSet = descriptorSets[i];
-            descriptorWrites[1].dstBinding = 1;
-            descriptorWrites[1].dstArrayElement = 0;
-            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptorWrites[1].descriptorCount = 1;
-            descriptorWrites[1].pImageInfo = &baseColorInfo;
-
-            descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[2].dstSet = descriptorSets[i];
-            descriptorWrites[2].dstBinding = 2;
-            descriptorWrites[2].dstArrayElement = 0;
-            descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptorWrites[2].descriptorCount = 1;
-            descriptorWrites[2].pImageInfo = &roughnessInfo;
-
-            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-        }
-    }
-
-    void createTextureImage()
+            writeDescriptorSet(i);
+        }
+    }
+
+    // points a material's set at its current textures, the set must not be in use by a frame in flight
+    void writeDescriptorSet(size_t setIndex)
     {
-        baseColorTexture = std::make_unique<Texture>(baseColorPath, device, physicalDevice, commandPool, graphicsQueue);
-        roughnessTexture = std::make_unique<Texture>(roughnessPath, device, physicalDevice, commandPool, graphicsQueue);
+        const MaterialTextures& textures = materialTextures[setIndex / MAX_FRAMES_IN_FLIGHT];
+
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = uniformRing->buffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range = sizeof(UniformBufferObject);
+
+        VkDescriptorImageInfo baseColorInfo{};
+        baseColorInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        baseColorInfo.imageView = textures.baseColor->textureImage->getImageView();
+        baseColorInfo.sampler = textures.baseColor->textureSampler;
+
+        VkDescriptorImageInfo roughnessInfo{};
+        roughnessInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        roughnessInfo.imageView = textures.roughness->textureImage->getImageView();
+        roughnessInfo.sampler = textures.roughness->textureSampler;
+
+        std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = descriptorSets[setIndex];
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].dstArrayElement = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pBufferInfo = &bufferInfo;
+        descriptorWrites[0].pImageInfo = nullptr; // optional
+        descriptorWrites[0].pTexelBufferView = nullptr; // optional
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = descriptorSets[setIndex];
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pImageInfo = &baseColorInfo;
+
+        descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[2].dstSet = descriptorSets[setIndex];
+        descriptorWrites[2].dstBinding = 2;
+        descriptorWrites[2].dstArrayElement = 0;
+        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[2].descriptorCount = 1;
+        descriptorWrites[2].pImageInfo = &roughnessInfo;
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    // sets of the given frame whose material got a new texture since that frame was last recorded
+    void updateDescriptorSets(uint32_t frameIndex)
+    {
+        for (size_t i = frameIndex; i < descriptorSetsDirty.size(); i += MAX_FRAMES_IN_FLIGHT)
+        {
+            if (descriptorSetsDirty[i])
+            {
+                writeDescriptorSet(i);
+                descriptorSetsDirty[i] = 0;
+            }
+        }
+    }
+
+    void createAssetLoader()
+    {
+        assetLoader = std::make_unique<AssetLoader>(*threadPool, *uploadContext);
+        assetLoader->setVerbose(enableVerboseOutput);
+        createTextureStreamer();
+        textureCache = std::make_unique<TextureCache>(device, physicalDevice, *allocator, *uploadContext, *deletionQueue, *assetLoader, textureStreamer.get());
+
+        assetLoader->setProgressCallback([this](const AssetLoadProgress& progress)
+        {
+            size_t finished = progress.completed + progress.failed;
+            std::string title = finished == progress.requested ? "Vulkan" : "Vulkan - loading " + std::to_string(finished) + "/" + std::to_string(progress.requested);
+            glfwSetWindowTitle(window, title.c_str());
+
+            if (enableVerboseOutput && finished == progress.requested)
+            {
+                std::cout << "assets loaded after " << (glfwGetTime() - loadStartTime) * 1000.0 << " ms, " << progress.failed << " failed" << std::endl;
+            }
+        });
+    }
+
+    void createTextureStreamer()
+    {
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        std::vector<VmaBudget> heapBudgets = allocator->getHeapBudgets();
+        VkDeviceSize largestHeap = 0;
+
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+        {
+            if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            {
+                largestHeap = std::max(largestHeap, heapBudgets[i].budget);
+            }
+        }
+
+        VkDeviceSize budget = std::min(TEXTURE_STREAMING_BUDGET, largestHeap / 2);
+        if (enableVerboseOutput)
+        {
+            std::cout << "texture streaming budget: " << budget / (1024 * 1024) << " MB" << std::endl;
+        }
+
+        textureStreamer = std::make_unique<TextureStreamer>(device, physicalDevice, *allocator, *uploadContext, *deletionQueue, budget);
+
+        // a swapped image has a new view, every material sampling it is rewritten before its next frame
+        textureStreamer->setResidencyCallback([this](Texture* texture)
+        {
+            for (size_t i = 0; i < materialTextures.size(); i++)
+            {
+                if (materialTextures[i].baseColor == texture || materialTextures[i].roughness == texture)
+                {
+                    markMaterialDirty(i);
+                }
+            }
+        });
+    }
+
+    void createPlaceholderTextures()
+    {
+        placeholderBaseColor = std::make_unique<Texture>(std::array<uint8_t, 4>{ 200, 200, 200, 255 }, device, physicalDevice, *allocator, *uploadContext, *deletionQueue);
+        if (packedMaterialMaps)
+        {
+            // no occlusion, the roughness the srgb grey below reads as, no metal
+            placeholderRoughness = std::make_unique<Texture>(std::array<uint8_t, 4>{ 255, 55, 0, 255 }, device, physicalDevice, *allocator, *uploadContext, *deletionQueue, VK_FORMAT_R8G8B8A8_UNORM);
+        }
+        else
+        {
+            placeholderRoughness = std::make_unique<Texture>(std::array<uint8_t, 4>{ 128, 128, 128, 255 }, device, physicalDevice, *allocator, *uploadContext, *deletionQueue);
+        }
+    }
+
+    // parsed and encoded on the thread pool, the arena range is allocated and staged once that is done
+    void loadModel()
+    {
+        auto data = std::make_shared<std::unique_ptr<ModelData>>();
+        auto loaded = std::make_shared<std::unique_ptr<Model>>();
+
+        std::string path = modelPath;
+        VertexFormat format = vertexFormat;
+
+        assetLoader->load(path, [this, data, path, format]()
+        {
+            *data = Model::load(path, format, *threadPool);
+        },
+        [this, data, loaded, path]()
+        {
+            if (enableVerboseOutput && (*data)->imported)
+            {
+                std::cout << path << ": " << MeshImport::describe((*data)->importStats) << std::endl;
+            }
+
+            *loaded = std::make_unique<Model>(**data, *geometryArena, *uploadContext, *deletionQueue);
+            data->reset();
+        },
+        [this, loaded](bool succeeded)
+        {
+            if (succeeded)
+            {
+                model = std::move(*loaded);
+                createMaterials();
+            }
+        });
+
+        // the textures given at startup are what most materials fall back to, so they decode alongside the
+        // model's parse instead of after it. createMaterials finds them in the cache
+        textureCache->request(baseColorPath, [](Texture*) {});
+        requestRoughness(roughnessPath, [](Texture*) {});
+    }
+
+    // the roughness map as is, or packed with the occlusion and metalness maps next to it
+    void requestRoughness(const std::string& sourcePath, std::function<void(Texture*)> onReady)
+    {
+        if (packedMaterialMaps)
+        {
+            textureCache->requestPacked(sourcePath, std::move(onReady));
+        }
+        else
+        {
+            textureCache->request(AssetPaths::resolve(sourcePath), std::move(onReady));
+        }
+    }
+
+    // every material starts out with the placeholders and has its sets written right away, so the model is drawn
+    // from the next frame on. its maps go through the cache, a texture shared between materials is loaded once.
+    // a material without a map, or whose map is missing, uses the textures given at startup instead
+    void createMaterials()
+    {
+        materialTextures.assign(model->materials.size(), MaterialTextures{ placeholderBaseColor.get(), placeholderRoughness.get() });
+
+        createDescriptorPool();
+        createDescriptorSets();
+
+        // source paths, the cache requests below resolve them to what assetbake built
+        auto selectPath = [](const std::string& materialPath, const std::string& fallbackPath)
+        {
+            if (materialPath.empty())
+            {
+                return fallbackPath;
+            }
+
+            return std::filesystem::exists(AssetPaths::resolve(materialPath)) ? materialPath : fallbackPath;
+        };
+
+        for (size_t i = 0; i < model->materials.size(); i++)
+        {
+            const MeshMaterial& material = model->materials[i];
+
+            textureCache->request(AssetPaths::resolve(selectPath(material.baseColorPath, baseColorPath)), [this, i](Texture* texture)
+            {
+                if (texture)
+                {
+                    materialTextures[i].baseColor = texture;
+                    markMaterialDirty(i);
+                }
+            });
+
+            requestRoughness(selectPath(material.roughnessPath, roughnessPath), [this, i](Texture* texture)
+            {
+                if (texture)
+                {
+                    materialTextures[i].roughness = texture;
+                    markMaterialDirty(i);
+                }
+            });
+        }
+    }
+
+    void markMaterialDirty(size_t materialIndex)
+    {
+        for (size_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+        {
+            descriptorSetsDirty[materialIndex * MAX_FRAMES_IN_FLIGHT + frame] = 1;
+        }
     }
 
     bool hasStencilComponent(VkFormat format)
@@ -1164,9 +1780,10 @@ private:
         return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT; 
     }
 
-    void createModel()
+    void flushUploads()
     {
-        model = std::make_unique<Model>(modelPath, device, physicalDevice, graphicsQueue, commandPool);
+        // everything recorded during initialization goes out in one submission
+        uploadContext->wait(uploadContext->submit());
     }
 
     void createCamera()
@@ -1,2 +1,2 @@
-#define VMA_VULKAN_IMPLEMENTATION
+#define VMA_IMPLEMENTATION
 #include "vk_mem_alloc.h"
\ No newline at end of file
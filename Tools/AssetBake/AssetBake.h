@@ -0,0 +1,601 @@
+#ifndef ASSET_BAKE_H
+#define ASSET_BAKE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include <glm/gtx/hash.hpp>
+
+#include "stb_image.h"
+
+#include "Arena.h"
+#include "ThreadPool.h"
+#include "AssetPaths.h"
+#include "MeshImport.h"
+#include "MeshCache.h"
+#include "Ktx2.h"
+#include "MaterialPacking.h"
+#include "BlockCompression.h"
+
+// what a texture holds, which decides the format it is baked to
+enum class TextureSemantic
+{
+    Color,
+    Mask,  // one channel of data: roughness, occlusion, metalness, height
+    Normal,
+    Packed // several masks in the colour channels, like the occlusion, roughness and metalness maps
+};
+
+// how the outputs are built, from the command line
+struct BakeSettings
+{
+    LodSettings lods;
+    bool bc1BaseColor = false; // BC1 instead of BC7 for colour maps, half the size at a visible loss of quality
+    VertexFormat vertexFormat = VertexFormat::Quantized; // should match the renderer's, a mesh in another one is converted when loaded
+};
+
+// one source file and what it turns into
+struct BakeJob
+{
+    std::filesystem::path sourcePath;
+    std::filesystem::path bakedPath;
+    std::string relativePath;
+
+    // packed material maps are built from the roughness map and whatever sits next to it, meshes from the obj,
+    // its .mtl files and the textures those name. the size and time then cover all of those sources
+    bool packedMaterial = false;
+
+    uint64_t sourceSize = 0;
+    int64_t sourceModified = 0;
+};
+
+// converts a tree of source assets into the formats the renderer loads without any parsing or decoding:
+// obj meshes become .mesh files, png and jpg textures become .ktx2 files with their whole mip chain and
+// glsl shaders become spir-v. a manifest in the output directory remembers what every output was built from,
+// so only sources that changed since the last run are baked again
+namespace AssetBake
+{
+    const uint32_t BAKER_VERSION = 7; // bump whenever any output format changes, everything is rebuilt then
+    const char* const MANIFEST_NAME = ".assetbake";
+    const size_t BAKE_SCRATCH_BLOCK_SIZE = 16 * 1024 * 1024;
+
+    struct ManifestEntry
+    {
+        uint32_t version;
+        uint64_t sourceSize;
+        int64_t sourceModified;
+        std::string settings;
+    };
+
+    // one line per output: version, source size, source timestamp, the settings that shape the output and the source
+    // path relative to the source root
+    static std::unordered_map<std::string, ManifestEntry> readManifest(const std::filesystem::path& path)
+    {
+        std::unordered_map<std::string, ManifestEntry> manifest;
+        std::ifstream file(path);
+        std::string line;
+
+        while (std::getline(file, line))
+        {
+            std::istringstream stream(line);
+            ManifestEntry entry;
+            std::string relativePath;
+
+            if (stream >> entry.version >> entry.sourceSize >> entry.sourceModified >> entry.settings && std::getline(stream >> std::ws, relativePath))
+            {
+                manifest[relativePath] = entry;
+            }
+        }
+
+        return manifest;
+    }
+
+    static void writeManifest(const std::filesystem::path& path, const std::vector<BakeJob>& jobs, const std::vector<char>& built, const std::vector<std::string>& settings)
+    {
+        std::ofstream file(path, std::ios::trunc);
+
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            if (built[i])
+            {
+                file << BAKER_VERSION << ' ' << jobs[i].sourceSize << ' ' << jobs[i].sourceModified << ' ' << settings[i] << ' ' << jobs[i].relativePath << '\n';
+            }
+        }
+    }
+
+    // returns what the import did to the mesh, for the baker's output
+    static std::string bakeMesh(const BakeJob& job, ThreadPool& threadPool, const BakeSettings& settings)
+    {
+        std::string sourcePath = job.sourcePath.string();
+
+        Arena scratch(BAKE_SCRATCH_BLOCK_SIZE);
+
+        ArenaVector<Vertex> vertices{ ArenaAllocator<Vertex>(scratch) };
+        ArenaVector<uint32_t> indices{ ArenaAllocator<uint32_t>(scratch) };
+        EncodedMesh mesh;
+
+        MeshImportStats stats = MeshImport::importObj(sourcePath, threadPool, scratch, vertices, indices, mesh.submeshes, mesh.materials, mesh.lods, mesh.dependencies, settings.lods);
+        MeshImport::encode(settings.vertexFormat, vertices.data(), vertices.size(), indices.data(), indices.size(), mesh, scratch, threadPool);
+
+        if (!MeshCache::writeFile(job.bakedPath.string(), sourcePath, mesh))
+        {
+            throw std::runtime_error("failed to write " + job.bakedPath.string());
+        }
+
+        return MeshImport::describe(stats);
+    }
+
+    static uint8_t linearToSrgb(float value)
+    {
+        value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+        return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    // halves an RGBA8 level with a box filter. colour is averaged in linear space, which the blits the runtime used
+    // to generate mips with do as well on srgb images, alpha is averaged as is. data that is not colour passes a
+    // null toLinear and has every channel averaged as is
+    static std::vector<uint8_t> downsample(const std::vector<uint8_t>& level, uint32_t width, uint32_t height, const float* toLinear)
+    {
+        uint32_t nextWidth = std::max(1u, width / 2);
+        uint32_t nextHeight = std::max(1u, height / 2);
+
+        std::vector<uint8_t> next(static_cast<size_t>(nextWidth) * nextHeight * 4);
+
+        for (uint32_t y = 0; y < nextHeight; y++)
+        {
+            uint32_t y0 = std::min(y * 2, height - 1);
+            uint32_t y1 = std::min(y * 2 + 1, height - 1);
+
+            for (uint32_t x = 0; x < nextWidth; x++)
+            {
+                uint32_t x0 = std::min(x * 2, width - 1);
+                uint32_t x1 = std::min(x * 2 + 1, width - 1);
+
+                const uint8_t* texels[4] =
+                {
+                    &level[(static_cast<size_t>(y0) * width + x0) * 4],
+                    &level[(static_cast<size_t>(y0) * width + x1) * 4],
+                    &level[(static_cast<size_t>(y1) * width + x0) * 4],
+                    &level[(static_cast<size_t>(y1) * width + x1) * 4],
+                };
+
+                uint8_t* out = &next[(static_cast<size_t>(y) * nextWidth + x) * 4];
+
+                for (int channel = 0; channel < 3; channel++)
+                {
+                    if (!toLinear)
+                    {
+                        uint32_t sum = texels[0][channel] + texels[1][channel] + texels[2][channel] + texels[3][channel];
+                        out[channel] = static_cast<uint8_t>((sum + 2) / 4);
+                        continue;
+                    }
+
+                    float sum = 0.0f;
+                    for (const uint8_t* texel : texels)
+                    {
+                        sum += toLinear[texel[channel]];
+                    }
+
+                    out[channel] = linearToSrgb(sum * 0.25f);
+                }
+
+                uint32_t alpha = texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3];
+                out[3] = static_cast<uint8_t>((alpha + 2) / 4);
+            }
+        }
+
+        return next;
+    }
+
+    // what a texture holds, from the last part of its name the way the source tree names maps: croissant_01_L0_Roughness.png
+    static TextureSemantic getTextureSemantic(const std::filesystem::path& path)
+    {
+        std::string stem = MaterialPacking::toLower(path.stem().string());
+        std::string suffix = stem.substr(stem.find_last_of('_') + 1);
+
+        if (suffix == "normal" || suffix == "normals" || suffix == "nrm")
+        {
+            return TextureSemantic::Normal;
+        }
+
+        if (suffix == MaterialPacking::toLower(MaterialPacking::PACKED_SUFFIX) || suffix == "arm")
+        {
+            return TextureSemantic::Packed;
+        }
+
+        const char* const maskSuffixes[] = { "roughness", "rough", "ao", "occlusion", "metallic", "metalness", "height", "mask", "specular", "gloss" };
+
+        for (const char* maskSuffix : maskSuffixes)
+        {
+            if (suffix == maskSuffix)
+            {
+                return TextureSemantic::Mask;
+            }
+        }
+
+        return TextureSemantic::Color;
+    }
+
+    // builds the mip chain below levels[0], compresses every level and writes the ktx2. colour passes its srgb table
+    // so it is filtered in linear space, data passes null and is averaged as is
+    static void writeTexture(const BakeJob& job, std::vector<std::vector<uint8_t>>& levels, uint32_t width, uint32_t height, const float* toLinear, VkFormat format, BlockFormat blockFormat, ThreadPool& threadPool)
+    {
+        uint32_t levelWidth = width;
+        uint32_t levelHeight = height;
+
+        while (levelWidth > 1 || levelHeight > 1)
+        {
+            levels.push_back(downsample(levels.back(), levelWidth, levelHeight, toLinear));
+
+            levelWidth = std::max(1u, levelWidth / 2);
+            levelHeight = std::max(1u, levelHeight / 2);
+        }
+
+        levelWidth = width;
+        levelHeight = height;
+
+        for (std::vector<uint8_t>& level : levels)
+        {
+            level = BlockCompression::compress(blockFormat, level.data(), levelWidth, levelHeight, Ktx2::isSrgb(format), threadPool);
+
+            levelWidth = std::max(1u, levelWidth / 2);
+            levelHeight = std::max(1u, levelHeight / 2);
+        }
+
+        if (!Ktx2::write(job.bakedPath.string(), format, width, height, levels))
+        {
+            throw std::runtime_error("failed to write " + job.bakedPath.string());
+        }
+    }
+
+    // textures are baked with their full mip chain in a block compressed format picked by what they hold: BC7, or
+    // BC1 when asked for, for colour, BC4 for single channel masks, BC5 for the x and y of normal maps and BC7
+    // without srgb for packed masks
+    static void bakeTexture(const BakeJob& job, ThreadPool& threadPool, const BakeSettings& settings)
+    {
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load(job.sourcePath.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+
+        if (!pixels)
+        {
+            throw std::runtime_error("failed to load texture image " + job.sourcePath.string());
+        }
+
+        std::vector<std::vector<uint8_t>> levels;
+        levels.emplace_back(pixels, pixels + static_cast<size_t>(width) * height * 4);
+        stbi_image_free(pixels);
+
+        float toLinear[256];
+        for (int i = 0; i < 256; i++)
+        {
+            toLinear[i] = MaterialPacking::srgbToLinear(i / 255.0f);
+        }
+
+        TextureSemantic semantic = getTextureSemantic(job.sourcePath);
+
+        // masks used to be sampled through srgb images like everything else, they are stored linearized so the
+        // shading does not change now that they are read as plain unorm values
+        if (semantic == TextureSemantic::Mask)
+        {
+            for (size_t i = 0; i < levels[0].size(); i += 4)
+            {
+                uint8_t value = static_cast<uint8_t>(toLinear[levels[0][i]] * 255.0f + 0.5f);
+                levels[0][i + 0] = value;
+                levels[0][i + 1] = value;
+                levels[0][i + 2] = value;
+            }
+        }
+
+        VkFormat format = VK_FORMAT_BC7_SRGB_BLOCK;
+        BlockFormat blockFormat = BlockFormat::BC7;
+
+        if (semantic == TextureSemantic::Color && settings.bc1BaseColor)
+        {
+            format = VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+            blockFormat = BlockFormat::BC1;
+        }
+        else if (semantic == TextureSemantic::Mask)
+        {
+            format = VK_FORMAT_BC4_UNORM_BLOCK;
+            blockFormat = BlockFormat::BC4;
+        }
+        else if (semantic == TextureSemantic::Normal)
+        {
+            format = VK_FORMAT_BC5_UNORM_BLOCK;
+            blockFormat = BlockFormat::BC5;
+        }
+        else if (semantic == TextureSemantic::Packed)
+        {
+            format = VK_FORMAT_BC7_UNORM_BLOCK;
+        }
+
+        writeTexture(job, levels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), semantic == TextureSemantic::Color ? toLinear : nullptr, format, blockFormat, threadPool);
+    }
+
+    // occlusion, roughness and metalness in one BC7 texture, the renderer samples all three with one fetch
+    static void bakePackedMaterial(const BakeJob& job, ThreadPool& threadPool)
+    {
+        uint32_t width, height;
+
+        std::vector<std::vector<uint8_t>> levels;
+        levels.push_back(MaterialPacking::pack(MaterialPacking::findSources(job.sourcePath.string()), width, height));
+
+        writeTexture(job, levels, width, height, nullptr, VK_FORMAT_BC7_UNORM_BLOCK, BlockFormat::BC7, threadPool);
+    }
+
+    // glslc from the Vulkan SDK when VULKAN_SDK is set, otherwise whatever glslc is on the path
+    static void bakeShader(const BakeJob& job)
+    {
+        std::string compiler = "glslc";
+
+        if (const char* sdk = std::getenv("VULKAN_SDK"))
+        {
+            compiler = (std::filesystem::path(sdk) / "Bin" / "glslc").string();
+        }
+
+        std::string command = "\"" + compiler + "\" \"" + job.sourcePath.string() + "\" -o \"" + job.bakedPath.string() + "\"";
+
+#ifdef _WIN32
+        // cmd strips the outer pair of quotes, without them a quoted compiler path breaks the whole command
+        command = "\"" + command + "\"";
+#endif
+
+        if (std::system(command.c_str()) != 0)
+        {
+            throw std::runtime_error("failed to compile shader " + job.sourcePath.string());
+        }
+    }
+
+    // returns a line about the result worth printing, empty for most assets
+    static std::string bake(const BakeJob& job, ThreadPool& threadPool, const BakeSettings& settings)
+    {
+        std::filesystem::create_directories(job.bakedPath.parent_path());
+
+        std::string extension = job.bakedPath.extension().string();
+
+        if (job.packedMaterial)
+        {
+            bakePackedMaterial(job, threadPool);
+        }
+        else if (extension == ".mesh")
+        {
+            return bakeMesh(job, threadPool, settings);
+        }
+        else if (extension == ".ktx2")
+        {
+            bakeTexture(job, threadPool, settings);
+        }
+        else
+        {
+            bakeShader(job);
+        }
+
+        return std::string();
+    }
+
+    // a roughness map also bakes the packed texture of its material, out of date whenever any of its maps is
+    static BakeJob createPackedMaterialJob(const std::filesystem::path& sourceRoot, const std::filesystem::path& bakedRoot, const BakeJob& roughnessJob)
+    {
+        std::filesystem::path packedPath = MaterialPacking::getPackedPath(roughnessJob.sourcePath.string());
+
+        BakeJob job = roughnessJob;
+        job.packedMaterial = true;
+        job.bakedPath = AssetPaths::getBakedPath(sourceRoot, bakedRoot, packedPath);
+        job.relativePath = packedPath.lexically_relative(sourceRoot).generic_string();
+
+        MaterialMapSources sources = MaterialPacking::findSources(roughnessJob.sourcePath.string());
+
+        for (const std::string& source : { sources.occlusion, sources.metalness })
+        {
+            if (!source.empty())
+            {
+                job.sourceSize += std::filesystem::file_size(source);
+                job.sourceModified = std::max(job.sourceModified, MeshCache::getModifiedTime(source));
+            }
+        }
+
+        return job;
+    }
+
+    // the files a mesh was built from besides the obj are only known once it has been baked, they are read back from
+    // the previous output. without one the mesh is baked anyway
+    static void addMeshDependencies(BakeJob& job)
+    {
+        MeshCacheView view;
+        if (!MeshCache::openFile(job.bakedPath.string(), view))
+        {
+            return;
+        }
+
+        EncodedMesh mesh;
+        MeshCache::readMesh(view, mesh);
+
+        std::vector<std::string> inputs = mesh.dependencies;
+
+        for (const MeshMaterial& material : mesh.materials)
+        {
+            for (const std::string& texture : { material.baseColorPath, material.roughnessPath })
+            {
+                if (!texture.empty() && std::find(inputs.begin(), inputs.end(), texture) == inputs.end())
+                {
+                    inputs.push_back(texture);
+                }
+            }
+        }
+
+        // one that does not exist counts for nothing, creating it still changes the size
+        for (const std::string& input : inputs)
+        {
+            std::error_code error;
+            if (std::filesystem::is_regular_file(input, error))
+            {
+                job.sourceSize += std::filesystem::file_size(input);
+                job.sourceModified = std::max(job.sourceModified, MeshCache::getModifiedTime(input));
+            }
+        }
+    }
+
+    static std::vector<BakeJob> collectJobs(const std::filesystem::path& sourceRoot, const std::filesystem::path& bakedRoot)
+    {
+        std::vector<BakeJob> jobs;
+
+        for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(sourceRoot))
+        {
+            if (!entry.is_regular_file() || AssetPaths::getBakedExtension(entry.path().extension().string()).empty())
+            {
+                continue;
+            }
+
+            BakeJob job;
+            job.sourcePath = entry.path();
+            job.bakedPath = AssetPaths::getBakedPath(sourceRoot, bakedRoot, entry.path());
+            job.relativePath = entry.path().lexically_relative(sourceRoot).generic_string();
+            job.sourceSize = entry.file_size();
+            job.sourceModified = MeshCache::getModifiedTime(entry.path().string());
+
+            if (job.bakedPath.extension() == ".mesh")
+            {
+                addMeshDependencies(job);
+            }
+
+            jobs.push_back(job);
+
+            if (MaterialPacking::isRoughnessMap(entry.path()))
+            {
+                jobs.push_back(createPackedMaterialJob(sourceRoot, bakedRoot, job));
+            }
+        }
+
+        return jobs;
+    }
+
+    // the command line settings an output depends on as one word for the manifest, so changing them rebakes exactly
+    // the outputs they change: the lods and vertex format for meshes, --bc1 for colour textures
+    static std::string getSettingsKey(const BakeJob& job, const BakeSettings& settings)
+    {
+        std::ostringstream key;
+        std::string extension = job.bakedPath.extension().string();
+
+        if (extension == ".mesh")
+        {
+            key << "lods=" << settings.lods.levelCount << ',' << settings.lods.reduction << ',' << settings.lods.maxError
+                << ";vertices=" << VertexEncoding::getFormatName(settings.vertexFormat);
+        }
+        else if (extension == ".ktx2" && !job.packedMaterial && getTextureSemantic(job.sourcePath) == TextureSemantic::Color)
+        {
+            key << "bc1=" << (settings.bc1BaseColor ? 1 : 0);
+        }
+        else
+        {
+            key << '-';
+        }
+
+        return key.str();
+    }
+
+    static int run(const std::filesystem::path& sourceRoot, const std::filesystem::path& bakedRoot, bool force, uint32_t threadCount, const BakeSettings& settings)
+    {
+        if (!std::filesystem::is_directory(sourceRoot))
+        {
+            std::cerr << "source directory " << sourceRoot.string() << " does not exist" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::filesystem::create_directories(bakedRoot);
+
+        std::filesystem::path manifestPath = bakedRoot / MANIFEST_NAME;
+        std::unordered_map<std::string, ManifestEntry> manifest;
+
+        if (!force)
+        {
+            manifest = readManifest(manifestPath);
+        }
+
+        std::vector<BakeJob> jobs = collectJobs(sourceRoot, bakedRoot);
+        std::vector<char> built(jobs.size(), 0);
+        std::vector<std::string> settingsKeys(jobs.size());
+        std::vector<size_t> pending;
+
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            auto it = manifest.find(jobs[i].relativePath);
+            settingsKeys[i] = getSettingsKey(jobs[i], settings);
+
+            bool upToDate = it != manifest.end()
+                && it->second.version == BAKER_VERSION
+                && it->second.settings == settingsKeys[i]
+                && it->second.sourceSize == jobs[i].sourceSize
+                && it->second.sourceModified == jobs[i].sourceModified
+                && std::filesystem::exists(jobs[i].bakedPath);
+
+            if (upToDate)
+            {
+                built[i] = 1;
+            }
+            else
+            {
+                pending.push_back(i);
+            }
+        }
+
+        ThreadPool threadPool(threadCount);
+        std::mutex outputMutex;
+        std::atomic<size_t> failed{ 0 };
+
+        // one asset per job, meshes spread their own parsing over the same pool
+        threadPool.parallelFor(pending.size(), [&](size_t i)
+        {
+            BakeJob& job = jobs[pending[i]];
+
+            try
+            {
+                std::string summary = bake(job, threadPool, settings);
+                built[pending[i]] = 1;
+
+                // the manifest gets the inputs the new mesh was built from, they may differ from the previous one's
+                if (job.bakedPath.extension() == ".mesh")
+                {
+                    job.sourceSize = std::filesystem::file_size(job.sourcePath);
+                    job.sourceModified = MeshCache::getModifiedTime(job.sourcePath.string());
+                    addMeshDependencies(job);
+                }
+
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cout << "baked " << job.relativePath << " -> " << job.bakedPath.generic_string() << std::endl;
+
+                if (!summary.empty())
+                {
+                    std::cout << "    " << summary << std::endl;
+                }
+            }
+            catch (const std::exception& e)
+            {
+                failed++;
+
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cerr << "failed " << job.relativePath << ": " << e.what() << std::endl;
+            }
+        });
+
+        writeManifest(manifestPath, jobs, built, settingsKeys);
+
+        std::cout << pending.size() - failed.load() << " baked, " << jobs.size() - pending.size() << " up to date, " << failed.load() << " failed" << std::endl;
+
+        return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+};
+
+#endif // ASSET_BAKE_H
@@ -0,0 +1,616 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "ThreadPool.h"
+
+enum class BlockFormat
+{
+    BC1, // rgb, 8 bytes per block
+    BC4, // one channel, 8 bytes per block
+    BC5, // two channels, 16 bytes per block
+    BC7  // rgba, 16 bytes per block, only mode 6 is written
+};
+
+// cpu encoders for the block compressed formats the baker writes. every 4x4 block is fitted on its own: endpoints
+// from the principal axis of the block's texels, refined once by least squares, then every texel takes the
+// closest palette entry. picking the palette entries is the hot loop and does four texels at a time with sse2.
+// levels are split into rows of blocks spread over the thread pool
+namespace BlockCompression
+{
+    const uint32_t BLOCK_DIMENSION = 4;
+    const uint32_t BLOCK_TEXELS = BLOCK_DIMENSION * BLOCK_DIMENSION;
+    const uint32_t COMPRESS_BLOCK_ROWS_PER_JOB = 4;
+
+    // squared errors of srgb colour are weighted by how much each channel contributes to luminance, data such as
+    // packed material maps counts every channel the same
+    const float COLOR_WEIGHTS[4] = { 0.299f, 0.587f, 0.114f, 1.0f };
+    const float DATA_WEIGHTS[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    const float RED_WEIGHTS[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+
+    const uint32_t BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // one block's texels by channel, 0 to 255
+    struct Block
+    {
+        alignas(16) float channels[4][BLOCK_TEXELS];
+    };
+
+    static uint32_t getBlockBytes(BlockFormat format)
+    {
+        return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+    }
+
+    static size_t getCompressedSize(BlockFormat format, uint32_t width, uint32_t height)
+    {
+        size_t blocksWide = (width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+        size_t blocksHigh = (height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+
+        return blocksWide * blocksHigh * getBlockBytes(format);
+    }
+
+    // blocks hanging over the edge of a small level repeat its last row and column
+    static void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block& block)
+    {
+        for (uint32_t y = 0; y < BLOCK_DIMENSION; y++)
+        {
+            uint32_t sourceY = std::min(blockY * BLOCK_DIMENSION + y, height - 1);
+
+            for (uint32_t x = 0; x < BLOCK_DIMENSION; x++)
+            {
+                uint32_t sourceX = std::min(blockX * BLOCK_DIMENSION + x, width - 1);
+                const uint8_t* texel = rgba + (static_cast<size_t>(sourceY) * width + sourceX) * 4;
+
+                for (uint32_t channel = 0; channel < 4; channel++)
+                {
+                    block.channels[channel][y * BLOCK_DIMENSION + x] = texel[channel];
+                }
+            }
+        }
+    }
+
+    // closest palette entry for every texel, returns the block's weighted squared error
+    static float selectIndices(const Block& block, const float (*palette)[4], uint32_t paletteSize, const float* weights, uint8_t* indices)
+    {
+        float error = 0.0f;
+
+#ifdef BLOCK_COMPRESSION_SSE2
+        for (uint32_t group = 0; group < BLOCK_TEXELS; group += 4)
+        {
+            __m128 texels[4];
+            for (uint32_t channel = 0; channel < 4; channel++)
+            {
+                texels[channel] = _mm_load_ps(&block.channels[channel][group]);
+            }
+
+            __m128 best = _mm_set1_ps(FLT_MAX);
+            __m128i bestIndex = _mm_setzero_si128();
+
+            for (uint32_t entry = 0; entry < paletteSize; entry++)
+            {
+                __m128 distance = _mm_setzero_ps();
+
+                for (uint32_t channel = 0; channel < 4; channel++)
+                {
+                    __m128 difference = _mm_sub_ps(texels[channel], _mm_set1_ps(palette[entry][channel]));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(_mm_mul_ps(difference, difference), _mm_set1_ps(weights[channel])));
+                }
+
+                __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+                best = _mm_min_ps(distance, best);
+                bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(static_cast<int>(entry))), _mm_andnot_si128(closer, bestIndex));
+            }
+
+            alignas(16) float bestDistance[4];
+            alignas(16) int32_t bestEntry[4];
+            _mm_store_ps(bestDistance, best);
+            _mm_store_si128(reinterpret_cast<__m128i*>(bestEntry), bestIndex);
+
+            for (uint32_t i = 0; i < 4; i++)
+            {
+                indices[group + i] = static_cast<uint8_t>(bestEntry[i]);
+                error += bestDistance[i];
+            }
+        }
+#else
+        for (uint32_t texel = 0; texel < BLOCK_TEXELS; texel++)
+        {
+            float best = FLT_MAX;
+
+            for (uint32_t entry = 0; entry < paletteSize; entry++)
+            {
+                float distance = 0.0f;
+
+                for (uint32_t channel = 0; channel < 4; channel++)
+                {
+                    float difference = block.channels[channel][texel] - palette[entry][channel];
+                    distance += difference * difference * weights[channel];
+                }
+
+                if (distance < best)
+                {
+                    best = distance;
+                    indices[texel] = static_cast<uint8_t>(entry);
+                }
+            }
+
+            error += best;
+        }
+#endif
+
+        return error;
+    }
+
+    // the block's extent along its principal axis, found by power iteration on the weighted covariance
+    static void findEndpoints(const Block& block, const float* weights, uint32_t channelCount, float* low, float* high)
+    {
+        float mean[4] = {};
+
+        for (uint32_t channel = 0; channel < channelCount; channel++)
+        {
+            for (uint32_t texel = 0; texel < BLOCK_TEXELS; texel++)
+            {
+                mean[channel] += block.channels[channel][texel];
+            }
+
+            mean[channel] /= BLOCK_TEXELS;
+        }
+
+        float covariance[4][4] = {};
+
+        for (uint32_t texel = 0; texel < BLOCK_TEXELS; texel++)
+        {
+            for (uint32_t i = 0; i < channelCount; i++)
+            {
+                for (uint32_t j = 0; j < channelCount; j++)
+                {
+                    covariance[i][j] += (block.channels[i][texel] - mean[i]) * (block.channels[j][texel] - mean[j]) * std::sqrt(weights[i] * weights[j]);
+                }
+            }
+        }
+
+        float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+        for (uint32_t iteration = 0; iteration < 8; iteration++)
+        {
+            float next[4] = {};
+            float length = 0.0f;
+
+            for (uint32_t i = 0; i < channelCount; i++)
+            {
+                for (uint32_t j = 0; j < channelCount; j++)
+                {
+                    next[i] += covariance[i][j] * axis[j];
+                }
+
+                length = std::max(length, std::fabs(next[i]));
+            }
+
+            if (length == 0.0f)
+            {
+                break;
+            }
+
+            for (uint32_t i = 0; i < channelCount; i++)
+            {
+                axis[i] = next[i] / length;
+            }
+        }
+
+        // back from the weighted space the covariance was built in
+        float axisLength = 0.0f;
+
+        for (uint32_t i = 0; i < channelCount; i++)
+        {
+            axis[i] = weights[i] > 0.0f ? axis[i] / std::sqrt(weights[i]) : 0.0f;
+            axisLength += axis[i] * axis[i];
+        }
+
+        float minimum = 0.0f;
+        float maximum = 0.0f;
+
+        if (axisLength > 0.0f)
+        {
+            minimum = FLT_MAX;
+            maximum = -FLT_MAX;
+
+            for (uint32_t texel = 0; texel < BLOCK_TEXELS; texel++)
+            {
+                float projection = 0.0f;
+
+                for (uint32_t channel = 0; channel < channelCount; channel++)
+                {
+                    projection += (block.channels[channel][texel] - mean[channel]) * axis[channel];
+                }
+
+                minimum = std::min(minimum, projection);
+                maximum = std::max(maximum, projection);
+            }
+
+            minimum /= axisLength;
+            maximum /= axisLength;
+        }
+
+        for (uint32_t channel = 0; channel < 4; channel++)
+        {
+            low[channel] = channel < channelCount ? std::min(std::max(mean[channel] + minimum * axis[channel], 0.0f), 255.0f) : 255.0f;
+            high[channel] = channel < channelCount ? std::min(std::max(mean[channel] + maximum * axis[channel], 0.0f), 255.0f) : 255.0f;
+        }
+    }
+
+    // least squares endpoints for the palette positions the texels picked, t runs from 0 at low to 1 at high
+    static bool refitEndpoints(const Block& block, const uint8_t* indices, const float* positions, uint32_t channelCount, float* low, float* high)
+    {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[4] = {}, bx[4] = {};
+
+        for (uint32_t texel = 0; texel < BLOCK_TEXELS; texel++)
+        {
+            float b = positions[indices[texel]];
+            float a = 1.0f - b;
+
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+
+            for (uint32_t channel = 0; channel < channelCount; channel++)
+            {
+                ax[channel] += a * block.channels[channel][texel];
+                bx[channel] += b * block.channels[channel][texel];
+            }
+        }
+
+        float determinant = aa * bb - ab * ab;
+
+        if (std::fabs(determinant) < 1e-6f)
+        {
+            return false;
+        }
+
+        for (uint32_t channel = 0; channel < channelCount; channel++)
+        {
+            low[channel] = std::min(std::max((ax[channel] * bb - bx[channel] * ab) / determinant, 0.0f), 255.0f);
+            high[channel] = std::min(std::max((bx[channel] * aa - ax[channel] * ab) / determinant, 0.0f), 255.0f);
+        }
+
+        return true;
+    }
+
+    static uint16_t packRgb565(const float* color)
+    {
+        uint32_t r = static_cast<uint32_t>(std::lround(color[0] * 31.0f / 255.0f));
+        uint32_t g = static_cast<uint32_t>(std::lround(color[1] * 63.0f / 255.0f));
+        uint32_t b = static_cast<uint32_t>(std::lround(color[2] * 31.0f / 255.0f));
+
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    static void unpackRgb565(uint16_t packed, float* color)
+    {
+        uint32_t r = (packed >> 11) & 31;
+        uint32_t g = (packed >> 5) & 63;
+        uint32_t b = packed & 31;
+
+        color[0] = static_cast<float>((r << 3) | (r >> 2));
+        color[1] = static_cast<float>((g << 2) | (g >> 4));
+        color[2] = static_cast<float>((b << 3) | (b >> 2));
+        color[3] = 255.0f;
+    }
+
+    // four colour mode only, which needs the first endpoint to be the larger one
+    static float encodeBc1Endpoints(const Block& block, const float* weights, const float* low, const float* high, uint8_t* output)
+    {
+        uint16_t color0 = packRgb565(high);
+        uint16_t color1 = packRgb565(low);
+
+        if (color0 < color1)
+        {
+            std::swap(color0, color1);
+        }
+
+        float palette[4][4];
+        unpackRgb565(color0, palette[0]);
+        unpackRgb565(color1, palette[1]);
+
+        for (uint32_t channel = 0; channel < 4; channel++)
+        {
+            palette[2][channel] = (2.0f * palette[0][channel] + palette[1][channel]) / 3.0f;
+            palette[3][channel] = (palette[0][channel] + 2.0f * palette[1][channel]) / 3.0f;
+        }
+
+        uint8_t indices[BLOCK_TEXELS];
+        float error = 0.0f;
+
+        if (color0 == color1)
+        {
+            // a flat block, three colour mode with every texel on the first endpoint
+            memset(indices, 0, sizeof(indices));
+        }
+        else
+        {
+            error = selectIndices(block, palette, 4, weights, indices);
+        }
+
+        uint32_t packedIndices = 0;
+        for (uint32_t texel = 0; texel < BLOCK_TEXELS; texel++)
+        {
+            packedIndices |= static_cast<uint32_t>(indices[texel]) << (texel * 2);
+        }
+
+        memcpy(output, &color0, 2);
+        memcpy(output + 2, &color1, 2);
+        memcpy(output + 4, &packedIndices, 4);
+
+        return error;
+    }
+
+    static void encodeBc1(const Block& block, const float* weights, uint8_t* output)
+    {
+        float low[4], high[4];
+        findEndpoints(block, weights, 3, low, high);
+
+        float error = encodeBc1Endpoints(block, weights, low, high, output);
+
+        // palette order is 0, 1, 2/3 and 1/3 of the way from color0 to color1, which is high to low here
+        const float positions[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        uint16_t color0, color1;
+        memcpy(&color0, output, 2);
+        memcpy(&color1, output + 2, 2);
+
+        if (color0 == color1)
+        {
+            return;
+        }
+
+        uint8_t indices[BLOCK_TEXELS];
+        uint32_t packedIndices;
+        memcpy(&packedIndices, output + 4, 4);
+
+        for (uint32_t texel = 0; texel < BLOCK_TEXELS; texel++)
+        {
+            indices[texel] = (packedIndices >> (texel * 2)) & 3;
+        }
+
+        uint8_t refined[8];
+        if (refitEndpoints(block, indices, positions, 3, low, high) && encodeBc1Endpoints(block, weights, low, high, refined) < error)
+        {
+            memcpy(output, refined, sizeof(refined));
+        }
+    }
+
+    // eight value mode, endpoints are the channel's extremes
+    static void encodeBc4(const Block& block, uint32_t channel, uint8_t* output)
+    {
+        float minimum = 255.0f;
+        float maximum = 0.0f;
+
+        for (uint32_t texel = 0; texel < BLOCK_TEXELS; texel++)
+        {
+            minimum = std::min(minimum, block.channels[channel][texel]);
+            maximum = std::max(maximum, block.channels[channel][texel]);
+        }
+
+        uint8_t red0 = static_cast<uint8_t>(std::lround(maximum));
+        uint8_t red1 = static_cast<uint8_t>(std::lround(minimum));
+
+        uint8_t indices[BLOCK_TEXELS] = {};
+
+        if (red0 != red1)
+        {
+            float palette[8][4] = {};
+            palette[0][0] = red0;
+            palette[1][0] = red1;
+
+            for (uint32_t i = 1; i < 7; i++)
+            {
+                palette[i + 1][0] = ((7 - i) * red0 + i * red1) / 7.0f;
+            }
+
+            // selectIndices works on the red channel only, so the requested channel is moved there
+            Block single;
+            memcpy(single.channels[0], block.channels[channel], sizeof(single.channels[0]));
+            memset(single.channels[1], 0, sizeof(single.channels[1]) * 3);
+
+            selectIndices(single, palette, 8, RED_WEIGHTS, indices);
+        }
+
+        uint64_t packed = static_cast<uint64_t>(red0) | (static_cast<uint64_t>(red1) << 8);
+        for (uint32_t texel = 0; texel < BLOCK_TEXELS; texel++)
+        {
+            packed |= static_cast<uint64_t>(indices[texel]) << (16 + texel * 3);
+        }
+
+        memcpy(output, &packed, 8);
+    }
+
+    // writes count bits of value at bit offset into a 128 bit block
+    static void writeBits(uint8_t* output, uint32_t& offset, uint32_t value, uint32_t count)
+    {
+        for (uint32_t bit = 0; bit < count; bit++, offset++)
+        {
+            output[offset / 8] |= static_cast<uint8_t>(((value >> bit) & 1) << (offset % 8));
+        }
+    }
+
+    // mode 6: one subset, rgba endpoints of 7 bits plus a p bit each and 4 bit indices
+    static float encodeBc7Endpoints(const Block& block, const float* weights, const float* low, const float* high, uint8_t* output)
+    {
+        float best = FLT_MAX;
+
+        // the p bits are the shared low bit of every channel of an endpoint, all four combinations are tried
+        for (uint32_t pbits = 0; pbits < 4; pbits++)
+        {
+            uint32_t endpoints[2][4];
+            float palette[16][4];
+
+            for (uint32_t channel = 0; channel < 4; channel++)
+            {
+                uint32_t p0 = pbits & 1;
+                uint32_t p1 = pbits >> 1;
+
+                endpoints[0][channel] = static_cast<uint32_t>(std::min(std::max(std::lround((low[channel] - p0) / 2.0f), 0l), 127l));
+                endpoints[1][channel] = static_cast<uint32_t>(std::min(std::max(std::lround((high[channel] - p1) / 2.0f), 0l), 127l));
+            }
+
+            for (uint32_t entry = 0; entry < 16; entry++)
+            {
+                for (uint32_t channel = 0; channel < 4; channel++)
+                {
+                    uint32_t e0 = (endpoints[0][channel] << 1) | (pbits & 1);
+                    uint32_t e1 = (endpoints[1][channel] << 1) | (pbits >> 1);
+
+                    palette[entry][channel] = static_cast<float>(((64 - BC7_WEIGHTS4[entry]) * e0 + BC7_WEIGHTS4[entry] * e1 + 32) >> 6);
+                }
+            }
+
+            uint8_t indices[BLOCK_TEXELS];
+            float error = selectIndices(block, palette, 16, weights, indices);
+
+            if (error >= best)
+            {
+                continue;
+            }
+
+            best = error;
+
+            uint32_t p0 = pbits & 1;
+            uint32_t p1 = pbits >> 1;
+
+            // the first texel's index has its top bit implied zero, swapping the endpoints flips every index
+            if (indices[0] & 8)
+            {
+                for (uint32_t channel = 0; channel < 4; channel++)
+                {
+                    std::swap(endpoints[0][channel], endpoints[1][channel]);
+                }
+
+                std::swap(p0, p1);
+
+                for (uint32_t texel = 0; texel < BLOCK_TEXELS; texel++)
+                {
+                    indices[texel] = static_cast<uint8_t>(15 - indices[texel]);
+                }
+            }
+
+            memset(output, 0, 16);
+            uint32_t offset = 0;
+
+            writeBits(output, offset, 1u << 6, 7);
+
+            for (uint32_t channel = 0; channel < 4; channel++)
+            {
+                writeBits(output, offset, endpoints[0][channel], 7);
+                writeBits(output, offset, endpoints[1][channel], 7);
+            }
+
+            writeBits(output, offset, p0, 1);
+            writeBits(output, offset, p1, 1);
+
+            for (uint32_t texel = 0; texel < BLOCK_TEXELS; texel++)
+            {
+                writeBits(output, offset, indices[texel], texel == 0 ? 3 : 4);
+            }
+        }
+
+        return best;
+    }
+
+    static void encodeBc7(const Block& block, const float* weights, uint8_t* output)
+    {
+        float low[4], high[4];
+        findEndpoints(block, weights, 4, low, high);
+
+        float error = encodeBc7Endpoints(block, weights, low, high, output);
+
+        float positions[16];
+        for (uint32_t entry = 0; entry < 16; entry++)
+        {
+            positions[entry] = BC7_WEIGHTS4[entry] / 64.0f;
+        }
+
+        // the indices in the block may have been flipped, refitting against them gives the endpoints in stored order
+        uint8_t indices[BLOCK_TEXELS];
+        uint32_t offset = 65;
+
+        for (uint32_t texel = 0; texel < BLOCK_TEXELS; texel++)
+        {
+            uint32_t count = texel == 0 ? 3 : 4;
+            uint32_t value = 0;
+
+            for (uint32_t bit = 0; bit < count; bit++, offset++)
+            {
+                value |= ((output[offset / 8] >> (offset % 8)) & 1u) << bit;
+            }
+
+            indices[texel] = static_cast<uint8_t>(value);
+        }
+
+        uint8_t refined[16];
+        if (refitEndpoints(block, indices, positions, 4, low, high) && encodeBc7Endpoints(block, weights, low, high, refined) < error)
+        {
+            memcpy(output, refined, sizeof(refined));
+        }
+    }
+
+    // compresses one RGBA8 level. BC4 takes the red channel and BC5 red and green. perceptual is for srgb colour,
+    // everything else fits its channels with equal weight
+    static std::vector<uint8_t> compress(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, bool perceptual, ThreadPool& threadPool)
+    {
+        const float* weights = perceptual ? COLOR_WEIGHTS : DATA_WEIGHTS;
+
+        uint32_t blocksWide = (width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+        uint32_t blocksHigh = (height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+        uint32_t blockBytes = getBlockBytes(format);
+
+        std::vector<uint8_t> compressed(static_cast<size_t>(blocksWide) * blocksHigh * blockBytes);
+
+        threadPool.parallelFor((blocksHigh + COMPRESS_BLOCK_ROWS_PER_JOB - 1) / COMPRESS_BLOCK_ROWS_PER_JOB, [&](size_t job)
+        {
+            uint32_t firstRow = static_cast<uint32_t>(job) * COMPRESS_BLOCK_ROWS_PER_JOB;
+            uint32_t lastRow = std::min(firstRow + COMPRESS_BLOCK_ROWS_PER_JOB, blocksHigh);
+
+            Block block;
+
+            for (uint32_t blockY = firstRow; blockY < lastRow; blockY++)
+            {
+                for (uint32_t blockX = 0; blockX < blocksWide; blockX++)
+                {
+                    uint8_t* output = &compressed[(static_cast<size_t>(blockY) * blocksWide + blockX) * blockBytes];
+                    loadBlock(rgba, width, height, blockX, blockY, block);
+
+                    switch (format)
+                    {
+                    case BlockFormat::BC1:
+                        encodeBc1(block, weights, output);
+                        break;
+                    case BlockFormat::BC4:
+                        encodeBc4(block, 0, output);
+                        break;
+                    case BlockFormat::BC5:
+                        encodeBc4(block, 0, output);
+                        encodeBc4(block, 1, output + 8);
+                        break;
+                    case BlockFormat::BC7:
+                        encodeBc7(block, weights, output);
+                        break;
+                    }
+                }
+            }
+        });
+
+        return compressed;
+    }
+};
+
+#endif // BLOCK_COMPRESSION_H
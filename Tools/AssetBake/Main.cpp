@@ -0,0 +1,65 @@
+#include "AssetBake.h"
+#include <algorithm>
+#include <string>
+
+
+// assetbake [--force] [--jobs N] [--lods N] [--bc1] [--full-vertices | --half-vertices] <source dir> <output dir>
+// meshes are baked with quantized vertices unless one of the vertex options says otherwise
+// the manifest remembers the settings every output was baked with, changing --lods, --bc1 or the vertex options rebakes the outputs they affect
+int main(int argc, char* argv[])
+{
+    bool force = false;
+    uint32_t threadCount = 0;
+    BakeSettings settings;
+    std::vector<std::string> directories;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+
+        if (argument == "--force")
+        {
+            force = true;
+        }
+        else if (argument == "--jobs" && i + 1 < argc)
+        {
+            threadCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (argument == "--lods" && i + 1 < argc)
+        {
+            settings.lods.levelCount = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        }
+        else if (argument == "--bc1")
+        {
+            settings.bc1BaseColor = true;
+        }
+        else if (argument == "--full-vertices")
+        {
+            settings.vertexFormat = VertexFormat::Full;
+        }
+        else if (argument == "--half-vertices")
+        {
+            settings.vertexFormat = VertexFormat::Half;
+        }
+        else
+        {
+            directories.push_back(argument);
+        }
+    }
+
+    if (directories.size() != 2)
+    {
+        std::cerr << "usage: assetbake [--force] [--jobs N] [--lods N] [--bc1] [--full-vertices | --half-vertices] <source dir> <output dir>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        return AssetBake::run(directories[0], directories[1], force, threadCount, settings);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}